@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+typedef struct point_t {
+    int x;
+    int y;
+} Point;
+
+static void strings_demo(const char *path) {
+    DynamicArray names = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(names); });
+
+    Common_dynamic_array_append(names, (void*) (char*) "John");
+    Common_dynamic_array_append(names, (void*) (char*) "Matt");
+    Common_dynamic_array_append(names, (void*) (char*) "Mario");
+
+    LCOMMON_ASSERT(Common_dynamic_array_save(names, path), "should be able to save the snapshot");
+
+    // loading makes an owned copy of every string.
+    Optional opt_loaded = Common_dynamic_array_load(path);
+    LCOMMON_ASSERT(Common_optional_is_some(&opt_loaded), "should be able to load the snapshot");
+
+    DynamicArray loaded = Common_optional_unpack(&opt_loaded);
+    defer({ Common_dynamic_array_free(loaded); });
+
+    Common_foreach(loaded, char, name, {
+        printf("-> loaded %s\n", name);
+    });
+
+    // mapping reads the strings in place, without copying them.
+    Optional opt_snapshot = Common_snapshot_map(path);
+    LCOMMON_ASSERT(Common_optional_is_some(&opt_snapshot), "should be able to map the snapshot");
+
+    Snapshot snapshot = Common_optional_unpack(&opt_snapshot);
+    defer({ Common_snapshot_unmap(snapshot); });
+
+    for (size_t i = 0; i < Common_snapshot_len(snapshot); ++i) {
+        printf(
+            "-> mapped %s (%ld bytes)\n",
+            Common_snapshot_string_at(snapshot, i),
+            Common_snapshot_string_len_at(snapshot, i)
+        );
+    }
+}
+
+static void records_demo(const char *path) {
+    Point points[] = {{1, 2}, {3, 4}, {5, 6}};
+
+    DynamicArray array = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(array); });
+
+    for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); ++i) {
+        Common_dynamic_array_append(array, (void*) &points[i]);
+    }
+
+    LCOMMON_ASSERT(Common_dynamic_array_save_records(array, sizeof(Point), path), "should be able to save records");
+
+    Optional opt_snapshot = Common_snapshot_map(path);
+    LCOMMON_ASSERT(Common_optional_is_some(&opt_snapshot), "should be able to map the snapshot");
+
+    Snapshot snapshot = Common_optional_unpack(&opt_snapshot);
+    defer({ Common_snapshot_unmap(snapshot); });
+
+    for (size_t i = 0; i < Common_snapshot_len(snapshot); ++i) {
+        const Point *point = Common_snapshot_record_at(snapshot, i);
+        printf("-> point (%d, %d)\n", point->x, point->y);
+    }
+}
+
+static void optional_array_demo(const char *path) {
+    OptionalArray array = Common_optional_array_init();
+    defer({ Common_optional_array_destroy(array); });
+
+    Common_optional_array_append(array, Common_optional_alloc_with((void*) (char*) "first item"));
+    Common_optional_array_append(array, Common_optional_alloc_none());
+    Common_optional_array_append(array, Common_optional_alloc_with((void*) (char*) "second item"));
+
+    LCOMMON_ASSERT(Common_optional_array_save(array, path), "should be able to save the snapshot");
+
+    Optional opt_loaded = Common_optional_array_load(path);
+    LCOMMON_ASSERT(Common_optional_is_some(&opt_loaded), "should be able to load the snapshot");
+
+    OptionalArray loaded = Common_optional_unpack(&opt_loaded);
+    defer({ Common_optional_array_free(loaded); });
+
+    Common_foreach(loaded, Optional, opt_element, {
+        printf("-> %ld: %s\n", i + 1, (char*) Common_optional_unpack_default(opt_element, "none"));
+    });
+}
+
+int main() {
+    const char *path = "/tmp/libcommon_snapshot_example.bin";
+
+    strings_demo(path);
+    records_demo(path);
+    optional_array_demo(path);
+
+    remove(path);
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+static void builder_demo(void) {
+    StringBuilder builder = Common_string_builder_init();
+    defer({ Common_string_builder_destroy(builder); });
+
+    Common_format(builder, "%s has %d items worth %.2f (0x%x)", "cart", 3, 19.99, 255u);
+    printf("formatted: %s\n", builder->data);
+
+    // widths, flags and precisions work like they do in printf.
+    Common_string_builder_clear(builder);
+    Common_format(builder, "[%5d] [%-6s] [%08.3f] [%#x]", 42, "left", 3.14159, 255u);
+    printf("aligned: %s\n", builder->data);
+
+    // the same builder can be reused without giving its buffer back.
+    Common_string_builder_clear(builder);
+    Common_string_builder_append(builder, "pi ~ ");
+    Common_string_builder_append_double(builder, 3.141592653589793);
+    printf("appended: %s\n", builder->data);
+}
+
+static void join_demo(void) {
+    long long ids[] = {42, -7, 1000000};
+    double prices[] = {0.1, 2.5, 1e21};
+
+    char *joined_ids = Common_strmerge_from_ints(", ", ids, sizeof(ids) / sizeof(ids[0]));
+    defer({ LCOMMON_FREE(joined_ids); });
+
+    char *joined_prices = Common_strmerge_from_doubles(", ", prices, sizeof(prices) / sizeof(prices[0]));
+    defer({ LCOMMON_FREE(joined_prices); });
+
+    printf("ids: %s\n", joined_ids);
+    printf("prices: %s\n", joined_prices);
+}
+
+int main() {
+    builder_demo();
+    join_demo();
+
+    return 0;
+}
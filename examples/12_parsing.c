@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/libcommon.h"
+
+static void single_values_demo(void) {
+    const char *inputs[] = {"42", "-17 apples", "99999999999999999999", "nope"};
+
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        ParsedInt parsed = Common_parse_int(inputs[i], strlen(inputs[i]));
+
+        if (parsed.is_none) {
+            printf("-> '%s' is not a valid integer\n", inputs[i]);
+            continue;
+        }
+
+        printf("-> '%s' starts with %lld (%ld bytes)\n", inputs[i], parsed.value, parsed.consumed);
+    }
+
+    ParsedDouble price = Common_parse_double("19.99", strlen("19.99"));
+    if (!price.is_none) {
+        printf("-> price is %f\n", price.value);
+    }
+}
+
+static void csv_demo(void) {
+    const char *csv = "10,20,30,40\n1.5,2.5,-3.75\n";
+
+    long long ints[8];
+    size_t consumed;
+    size_t count = Common_parse_ints(csv, strlen(csv), ',', ints, 8, &consumed);
+
+    printf("-> first row has %ld integers, the last one is %lld\n", count, ints[count - 1]);
+
+    // skipping the newline which stopped the first row.
+    const char *second_row = csv + consumed + 1;
+    double doubles[8];
+    count = Common_parse_doubles(second_row, strlen(second_row), ',', doubles, 8, NULL);
+
+    printf("-> second row has %ld doubles, the last one is %f\n", count, doubles[count - 1]);
+}
+
+int main() {
+    single_values_demo();
+    csv_demo();
+
+    return 0;
+}
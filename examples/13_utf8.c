@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/libcommon.h"
+
+int main() {
+    const char *greeting = "¡Hola, 世界! 👋";
+
+    Utf8Measure measure = Common_utf8_measure(greeting);
+    printf(
+        "-> '%s' is %s utf-8, %ld bytes and %ld code points\n",
+        greeting,
+        measure.is_valid ? "valid" : "invalid",
+        measure.bytes,
+        measure.codepoints
+    );
+
+    size_t offset;
+    if (Common_utf8_offset_of(greeting, measure.bytes, 7, &offset)) {
+        printf("-> the 8th code point starts at byte %ld: %s\n", offset, greeting + offset);
+    }
+
+    const char broken[] = {'a', (char) 0xE4, (char) 0xB8, 'b'};
+    printf("-> truncated sequence is %s\n", Common_utf8_validate(broken, sizeof(broken)) ? "valid" : "invalid");
+
+    return 0;
+}
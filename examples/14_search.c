@@ -0,0 +1,33 @@
+#include <stdio.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+int main() {
+    const char *line = "2024-01-01 ERROR disk full; 2024-01-02 ERROR disk still full";
+
+    Optional opt_first = Common_strfind(line, "ERROR");
+    if (Common_optional_is_some(&opt_first)) {
+        printf("-> first error: %s\n", (char*) Common_optional_unpack(&opt_first));
+    }
+
+    Optional opt_last = Common_strrfind(line, "ERROR");
+    if (Common_optional_is_some(&opt_last)) {
+        printf("-> last error: %s\n", (char*) Common_optional_unpack(&opt_last));
+    }
+
+    printf("-> %ld errors, mentions disk: %d\n", Common_strcount_occurrences(line, "ERROR"), Common_strcontains(line, "disk"));
+
+    char *replaced = Common_strreplace(line, "ERROR", "WARN");
+    defer({ LCOMMON_FREE(replaced); });
+    printf("-> replaced: %s\n", replaced);
+
+    DynamicArray entries = Common_strsplit(line, "; ");
+    defer({ Common_dynamic_array_free(entries); });
+
+    Common_foreach(entries, char, entry, {
+        printf("-> entry #%ld: %s\n", i + 1, entry);
+    });
+
+    return 0;
+}
@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/libcommon.h"
+
+int main() {
+    const char *key = "user:1234";
+    unsigned long long seed = 42;
+
+    size_t len;
+    unsigned long long hash = Common_hash_str_len(key, seed, &len);
+    printf("-> hash of '%s' (%ld bytes) is %016llx\n", key, len, hash);
+
+    // feeding the same bytes in pieces gives the same hash.
+    HashStream stream;
+    Common_hash_stream_init(&stream, seed);
+    Common_hash_stream_update(&stream, "user:", 5);
+    Common_hash_stream_update(&stream, "1234", 4);
+
+    LCOMMON_ASSERT(Common_hash_stream_digest(&stream) == hash, "streaming hash should match the one-shot hash");
+    printf("-> streamed hash is %016llx\n", Common_hash_stream_digest(&stream));
+
+    printf("-> hash of the integer 1234 is %016llx\n", Common_hash_u64(1234, seed));
+
+    return 0;
+}
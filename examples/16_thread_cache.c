@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../include/libcommon.h"
+
+#define WORKERS 4
+#define ITEMS 1000
+
+// build libcommon with `make THREAD_CACHE=1` to serve these small allocations
+// from per-thread caches, the code stays the same either way.
+static void *producer(void *arg) {
+    DynamicArray array = arg;
+
+    for (int i = 0; i < ITEMS; ++i) {
+        char *item = Common_smalloc(32);
+        snprintf(item, 32, "item-%d", i);
+        Common_dynamic_array_append(array, item);
+    }
+
+    return NULL;
+}
+
+int main() {
+    pthread_t threads[WORKERS];
+    DynamicArray arrays[WORKERS];
+
+    for (int i = 0; i < WORKERS; ++i) {
+        arrays[i] = Common_dynamic_array_init();
+        pthread_create(&threads[i], NULL, producer, arrays[i]);
+    }
+
+    for (int i = 0; i < WORKERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // memory allocated by the workers can be released from any other thread,
+    // always through LCOMMON_FREE() / Common_sfree() and never with plain free().
+    size_t total = 0;
+    for (int i = 0; i < WORKERS; ++i) {
+        total += arrays[i]->len;
+        Common_dynamic_array_free(arrays[i]);
+    }
+
+    printf("-> allocated and released %ld items across %d threads\n", total, WORKERS);
+
+    // hand whatever this thread still caches back to the shared pool.
+    Common_thread_cache_flush();
+
+    return 0;
+}
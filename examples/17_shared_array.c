@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../include/libcommon.h"
+
+#define READERS 3
+#define ITEMS 100000
+
+static SharedArray numbers;
+static volatile int finished = 0;
+
+static void *reader(void *arg) {
+    (void) arg;
+
+    SharedArrayReader self = Common_shared_array_reader_init(numbers);
+    size_t last_len = 0;
+
+    while (!__atomic_load_n(&finished, __ATOMIC_ACQUIRE)) {
+        // no locks, the writer keeps appending while we look at this snapshot.
+        SharedArrayView view = Common_shared_array_read_lock(self);
+
+        for (size_t i = last_len; i < view.len; ++i) {
+            LCOMMON_ASSERT((uintptr_t) view.elements[i] == i, "every published element should be visible");
+        }
+
+        last_len = view.len;
+        Common_shared_array_read_unlock(self);
+    }
+
+    Common_shared_array_reader_destroy(self);
+
+    return NULL;
+}
+
+int main() {
+    pthread_t threads[READERS];
+    numbers = Common_shared_array_init();
+
+    for (int i = 0; i < READERS; ++i) {
+        pthread_create(&threads[i], NULL, reader, NULL);
+    }
+
+    for (uintptr_t i = 0; i < ITEMS; ++i) {
+        Common_shared_array_append(numbers, (void*) i);
+    }
+
+    __atomic_store_n(&finished, 1, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < READERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    SharedArrayReader self = Common_shared_array_reader_init(numbers);
+    SharedArrayView view = Common_shared_array_read_lock(self);
+    printf("-> %ld elements published, last one is %ld\n", view.len, (uintptr_t) view.elements[view.len - 1]);
+    Common_shared_array_read_unlock(self);
+
+    printf("-> %ld old buffers still waiting for readers\n", Common_shared_array_reclaim(numbers));
+
+    Common_shared_array_destroy(numbers);
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include <stdio.h>
+
+#include "../include/libcommon.h"
+
+// every temporary below comes from the thread's scratch region and is released in
+// one go when the function returns, without a single free (and without defer).
+static void greet(const char *name, int times) {
+    Common_scratch_scope();
+
+    DynamicArray words = Common_dynamic_array_init();
+    for (int i = 0; i < times; ++i) {
+        Common_dynamic_array_append(words, Common_scratch_strmerge(", ", "hello", name));
+    }
+
+    char *line = Common_scratch_strmerge_from_array(" / ", words);
+    printf("-> %s\n", line);
+
+    Common_dynamic_array_destroy(words);
+}
+
+int main() {
+    greet("John", 2);
+    greet("Doe", 3);
+
+    // marks can also be handled by hand.
+    ScratchMark mark = Common_scratch_push();
+    char *copy = Common_scratch_strdup("temporary copy");
+    printf("-> %s\n", copy);
+    Common_scratch_pop(mark);
+
+    Common_scratch_release();
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+
+#include "../include/libcommon.h"
+
+typedef struct task_t {
+    const char *name;
+    int priority;
+} Task;
+
+static int by_priority(const void *a, const void *b) {
+    return ((const Task*) a)->priority - ((const Task*) b)->priority;
+}
+
+int main() {
+    Task tasks[] = {{"write docs", 3}, {"fix bug", 1}, {"release", 4}, {"review", 2}};
+
+    // comparator heap, the handle lets us reprioritize a task later on.
+    Heap queue = Common_heap_init(by_priority);
+    HeapHandle release = 0;
+    for (size_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); ++i) {
+        HeapHandle handle = Common_heap_push(queue, &tasks[i]);
+        if (i == 2) {
+            release = handle;
+        }
+    }
+
+    tasks[2].priority = 0;
+    Common_heap_update(queue, release);
+
+    Optional next;
+    while (!(next = Common_heap_pop(queue)).is_none) {
+        Task *task = Common_optional_unpack(&next);
+        printf("-> %s (priority %d)\n", task->name, task->priority);
+    }
+
+    Common_heap_destroy(queue);
+
+    // top-k with inline integer keys: keeps the 3 biggest scores seen.
+    long long scores[] = {42, 7, 99, 13, 56, 71, 3};
+    Heap top = Common_heap_init_int();
+    for (size_t i = 0; i < sizeof(scores) / sizeof(scores[0]); ++i) {
+        Common_heap_offer_int(top, 3, scores[i], NULL);
+    }
+
+    printf("-> top 3 scores start at %lld\n", Common_heap_top_int(top));
+    Common_heap_destroy(top);
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include <stdio.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+int main() {
+    // e.g. a query result where missing columns come back as NULL.
+    void *row[] = {"John", NULL, "Doe", NULL, "42"};
+
+    // one allocation for the array, its element pointers and every optional.
+    OptionalArray columns = Common_optional_array_from_buffer(row, sizeof(row) / sizeof(row[0]));
+    defer({ Common_optional_array_destroy(columns); });
+
+    Common_foreach(columns, Optional, column, {
+        printf("-> column %ld: %s\n", i, (char*) Common_optional_unpack_default(column, "<none>"));
+    });
+
+    // it stays a regular optional array, appending still works.
+    Common_optional_array_append(columns, Common_optional_alloc_with("appended"));
+
+    char *joined = Common_strmerge_from_optional_array(", ", columns);
+    defer({ LCOMMON_FREE(joined); });
+
+    printf("-> joined: %s\n", joined);
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+#include <stdio.h>
+
+#include "../include/libcommon.h"
+
+// build with `make TRACING=1` to record events, otherwise this runs untraced. The dump can
+// be opened with chrome://tracing or https://ui.perfetto.dev
+static void build_words(DynamicArray words) {
+    LCOMMON_TRACE_SPAN("build_words");
+
+    for (int i = 0; i < 100; ++i) {
+        Common_dynamic_array_append(words, "word");
+    }
+}
+
+int main() {
+    Common_trace_start();
+
+    DynamicArray words = Common_dynamic_array_init();
+    build_words(words);
+
+    LCOMMON_TRACE_INSTANT("words_ready", words->len);
+
+    char *sentence = Common_strmerge_from_array(" ", words);
+    printf("-> merged %ld words into %ld bytes\n", words->len, Common_strcount(sentence));
+
+    LCOMMON_FREE(sentence);
+    Common_dynamic_array_destroy(words);
+
+    Common_trace_stop();
+
+    if (Common_trace_dump("trace.json")) {
+        printf("-> trace written to trace.json\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include <stdio.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+int main() {
+    // lives entirely on the stack until it holds more than LCOMMON_SMALL_ARRAY_INLINE_CAP elements.
+    Common_small_array_on_stack(tags);
+    defer({ Common_small_array_release(tags); });
+
+    Common_small_array_append(tags, "c");
+    Common_small_array_append(tags, "libs");
+    Common_small_array_append(tags, "arrays");
+
+    printf("-> %u tags, still inline: %s\n", tags->len, tags->elements == tags->inline_elements ? "yes" : "no");
+
+    Common_foreach(tags, char, tag, {
+        printf("-> tag %ld: %s\n", i, tag);
+    });
+
+    // heap allocated small arrays are still a single allocation.
+    SmallArray numbers = Common_small_array_init();
+    defer({ Common_small_array_destroy(numbers); });
+
+    static int values[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    for (int i = 0; i < 10; ++i) {
+        Common_small_array_append(numbers, &values[i]);
+    }
+
+    printf("-> %u numbers, still inline: %s\n", numbers->len, numbers->elements == numbers->inline_elements ? "yes" : "no");
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+static LCOMMON_BOOL count_bytes(void *context, const char *data, size_t len) {
+    (void) data;
+    *(size_t*) context += len;
+    return LCOMMON_TRUE;
+}
+
+int main() {
+    DynamicArray fruits = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(fruits); });
+
+    Common_dynamic_array_append(fruits, "apple");
+    Common_dynamic_array_append(fruits, "banana");
+    Common_dynamic_array_append(fruits, "cherry");
+
+    // goes straight from the elements to stdout through writev(), nothing is merged in memory.
+    printf("-> ");
+    fflush(stdout);
+    Common_write_array(STDOUT_FILENO, ", ", fruits);
+    printf("\n");
+
+    // sinks can also wrap a FILE* or a callback.
+    OutputSink out = Common_output_sink_file(stdout);
+    Common_output_sink_write_str(out, "-> ");
+    Common_output_sink_write_array(out, " | ", fruits);
+    Common_output_sink_write_str(out, "\n");
+    Common_output_sink_destroy(out);
+
+    size_t total = 0;
+    OutputSink counter = Common_output_sink_callback(count_bytes, &total);
+    Common_output_sink_write_array(counter, ", ", fruits);
+    Common_output_sink_destroy(counter);
+
+    printf("-> the joined string would take %ld bytes\n", total);
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <string.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+int main() {
+    IoContext io = Common_io_init(0, 0);
+    defer({ Common_io_destroy(io); });
+
+    printf("-> using io_uring: %s\n", Common_io_uses_io_uring(io) ? "yes" : "no");
+
+    DynamicArray paths = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(paths); });
+
+    Common_dynamic_array_append(paths, "/tmp/libcommon_io_a.txt");
+    Common_dynamic_array_append(paths, "/tmp/libcommon_io_b.txt");
+    Common_dynamic_array_append(paths, "/tmp/libcommon_io_c.txt");
+
+    IoBuffer contents[3] = {
+        {"first file\n", 11},
+        {"second file\n", 12},
+        {"third file\n", 11},
+    };
+
+    DynamicArray buffers = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(buffers); });
+
+    for (int i = 0; i < 3; ++i) {
+        Common_dynamic_array_append(buffers, &contents[i]);
+    }
+
+    // the three files are opened, written and closed by a handful of submissions.
+    size_t written = Common_io_write_files(io, paths, buffers, NULL);
+    printf("-> wrote %ld files\n", written);
+
+    Common_dynamic_array_append(paths, "/this/file/does/not/exist");
+
+    OptionalArray results = Common_io_read_files(io, paths);
+    defer({ Common_io_results_release(io, results); });
+
+    Common_foreach(results, Optional, result, {
+        if (Common_optional_is_some(result)) {
+            IoBuffer *buffer = Common_optional_unpack(result);
+            printf("-> %s: %ld bytes, %s", (char*) paths->elements[i], buffer->len, buffer->data);
+        } else {
+            printf("-> %s: couldn't be read\n", (char*) paths->elements[i]);
+        }
+    });
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <string.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+#define WORDS 1000000
+
+int main() {
+    static const char *words[] = {"alpha", "beta", "gamma", "delta"};
+
+    DynamicArray array = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(array); });
+
+    for (int i = 0; i < WORDS; ++i) {
+        Common_dynamic_array_append(array, (void*) words[i % 4]);
+    }
+
+    // lengths are measured and elements copied from 4 threads, into a single allocation.
+    char *joined = Common_strmerge_from_array_parallel(",", array, 4);
+    defer({ LCOMMON_FREE(joined); });
+
+    char *expected = Common_strmerge_from_array(",", array);
+    defer({ LCOMMON_FREE(expected); });
+
+    printf("-> joined %d words into %ld bytes, same as single threaded: %s\n",
+        WORDS, strlen(joined), strcmp(joined, expected) == 0 ? "yes" : "no");
+    printf("-> starts with: %.30s...\n", joined);
+
+    return 0;
+}
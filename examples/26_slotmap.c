@@ -0,0 +1,34 @@
+#include <stdio.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+int main() {
+    SlotMap entities = Common_slotmap_init();
+    defer({ Common_slotmap_destroy(entities); });
+
+    SlotMapHandle player = Common_slotmap_insert(entities, "player");
+    SlotMapHandle enemy = Common_slotmap_insert(entities, "enemy");
+    SlotMapHandle chest = Common_slotmap_insert(entities, "chest");
+
+    // removing keeps the storage dense, the chest moves into the enemy's place.
+    Common_slotmap_remove(entities, enemy);
+
+    Common_foreach(entities, char, name, {
+        printf("-> entity %ld: %s (handle %llx)\n", i, name, Common_slotmap_handle_at(entities, i));
+    });
+
+    // the enemy's slot is reused but its old handle is stale.
+    SlotMapHandle door = Common_slotmap_insert(entities, "door");
+
+    Optional stale = Common_slotmap_get(entities, enemy);
+    Optional fresh = Common_slotmap_get(entities, door);
+
+    printf("-> enemy: %s\n", (char*) Common_optional_unpack_default(&stale, "<removed>"));
+    printf("-> door: %s\n", (char*) Common_optional_unpack_default(&fresh, "<removed>"));
+    printf("-> player still alive: %s, chest still alive: %s\n",
+        Common_slotmap_contains(entities, player) ? "yes" : "no",
+        Common_slotmap_contains(entities, chest) ? "yes" : "no");
+
+    return 0;
+}
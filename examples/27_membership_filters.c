@@ -0,0 +1,54 @@
+#include <stdio.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+int main() {
+    DynamicArray known = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(known); });
+
+    Common_dynamic_array_append(known, "alice");
+    Common_dynamic_array_append(known, "bob");
+    Common_dynamic_array_append(known, "carol");
+
+    BloomFilter bloom = Common_bloom_filter_init(1000, 0.01);
+    defer({ Common_bloom_filter_destroy(bloom); });
+
+    Common_bloom_filter_add_array(bloom, known);
+
+    DynamicArray queries = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(queries); });
+
+    Common_dynamic_array_append(queries, "bob");
+    Common_dynamic_array_append(queries, "mallory");
+    Common_dynamic_array_append(queries, "carol");
+
+    LCOMMON_BOOL results[3];
+    size_t maybe = Common_bloom_filter_may_contain_array(bloom, queries, results);
+
+    Common_foreach(queries, char, name, {
+        printf("-> %s: %s\n", name, results[i] ? "maybe present" : "definitely not present");
+    });
+    printf("-> %ld of %ld may be present, filter takes %ld bytes\n", maybe, queries->len, Common_bloom_filter_size(bloom));
+
+    // filters can be stored and loaded back as plain bytes.
+    size_t len;
+    void *bytes = Common_bloom_filter_serialize(bloom, &len);
+    defer({ LCOMMON_FREE(bytes); });
+
+    Optional loaded = Common_bloom_filter_deserialize(bytes, len);
+    BloomFilter copy = Common_optional_unpack(&loaded);
+    defer({ Common_bloom_filter_destroy(copy); });
+
+    printf("-> reloaded from %ld bytes, has alice: %s\n", len, Common_bloom_filter_may_contain(copy, "alice") ? "maybe" : "no");
+
+    // a set that never changes fits in even less memory with a xor filter.
+    XorFilter xor = Common_xor_filter_build(known);
+    defer({ Common_xor_filter_destroy(xor); });
+
+    printf("-> xor filter has carol: %s, has mallory: %s\n",
+        Common_xor_filter_may_contain(xor, "carol") ? "maybe" : "no",
+        Common_xor_filter_may_contain(xor, "mallory") ? "maybe" : "no");
+
+    return 0;
+}
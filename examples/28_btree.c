@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+int main() {
+    // events bucketed by timestamp, kept in order whatever the insertion order is.
+    BTree events = Common_btree_init_int();
+    defer({ Common_btree_destroy(events); });
+
+    Common_btree_insert_int(events, 1700000300, "deploy");
+    Common_btree_insert_int(events, 1700000100, "build");
+    Common_btree_insert_int(events, 1700000200, "test");
+    Common_btree_insert_int(events, 1700000400, "rollback");
+
+    Common_btree_remove_int(events, 1700000400);
+
+    BTreeIterator range = Common_btree_range_int(events, 1700000150, 1700000350);
+    while (Common_btree_next(&range)) {
+        printf("-> %lld: %s\n", range.key, (char*) range.value);
+    }
+
+    // string trees can be built in one pass from keys which are already sorted.
+    DynamicArray names = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(names); });
+
+    Common_dynamic_array_append(names, "ada");
+    Common_dynamic_array_append(names, "alan");
+    Common_dynamic_array_append(names, "barbara");
+    Common_dynamic_array_append(names, "grace");
+
+    BTree people = Common_btree_from_sorted_str(names, NULL);
+    defer({ Common_btree_destroy(people); });
+
+    Optional found = Common_btree_get_str(people, "grace");
+    printf("-> grace: %s\n", Common_optional_is_some(&found) ? "found" : "missing");
+
+    BTreeIterator a_names = Common_btree_range_str(people, "a", "b");
+    while (Common_btree_next(&a_names)) {
+        printf("-> starts with a: %s\n", a_names.key_str);
+    }
+
+    // string keys only have to live as long as their entry, a removed key can be freed
+    // right away even if it was separating two nodes.
+    BTree sessions = Common_btree_init_str();
+    defer({ Common_btree_free(sessions); });
+
+    for (int i = 0; i < 1000; ++i) {
+        char key[32];
+        snprintf(key, sizeof(key), "session_%04d", i);
+
+        char *owned = strdup(key);
+        Common_btree_insert_str(sessions, owned, owned);
+    }
+
+    for (int i = 0; i < 1000; i += 2) {
+        char key[32];
+        snprintf(key, sizeof(key), "session_%04d", i);
+
+        Optional removed = Common_btree_remove_str(sessions, key);
+        free(Common_optional_unpack(&removed));
+    }
+
+    // inserting a key again swaps in the new key string, so the old one can go as well.
+    for (int i = 1; i < 1000; i += 4) {
+        char key[32];
+        snprintf(key, sizeof(key), "session_%04d", i);
+
+        char *owned = strdup(key);
+        Optional replaced = Common_btree_insert_str(sessions, owned, owned);
+        free(Common_optional_unpack(&replaced));
+    }
+
+    size_t missing = 0;
+    for (int i = 1; i < 1000; i += 2) {
+        char key[32];
+        snprintf(key, sizeof(key), "session_%04d", i);
+
+        Optional found = Common_btree_get_str(sessions, key);
+        missing += Common_optional_is_none(&found);
+    }
+
+    printf("-> sessions left: %ld, missing: %ld\n", Common_btree_len(sessions), missing);
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+#define PRODUCERS 2
+#define ITEMS 1000
+
+static long values[PRODUCERS][ITEMS];
+
+static void *producer(void *arg) {
+    MpmcQueue queue = arg;
+    static int next_id = 0;
+    int id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < ITEMS; ++i) {
+        values[id][i] = i;
+        // sleeps while the queue is full instead of spinning.
+        Common_mpmc_queue_push_wait(queue, &values[id][i]);
+    }
+
+    return NULL;
+}
+
+int main() {
+    MpmcQueue queue = Common_mpmc_queue_init(64);
+    defer({ Common_mpmc_queue_destroy(queue); });
+
+    pthread_t threads[PRODUCERS];
+    for (int i = 0; i < PRODUCERS; ++i) {
+        pthread_create(&threads[i], NULL, producer, queue);
+    }
+
+    long total = 0;
+    for (int received = 0; received < PRODUCERS * ITEMS;) {
+        // takes whatever is there (up to 16 items) at once, or sleeps until something arrives.
+        void *batch[16];
+        size_t n = Common_mpmc_queue_pop_batch(queue, batch, 16);
+        if (n == 0) {
+            batch[0] = Common_mpmc_queue_pop_wait(queue);
+            n = 1;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            total += *(long*) batch[i];
+        }
+
+        received += (int) n;
+    }
+
+    for (int i = 0; i < PRODUCERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("-> received %d items from %d producers, total %ld\n", PRODUCERS * ITEMS, PRODUCERS, total);
+
+    // the single producer single consumer queue has the same interface.
+    SpscQueue pipe = Common_spsc_queue_init(4);
+    defer({ Common_spsc_queue_destroy(pipe); });
+
+    Common_spsc_queue_push(pipe, "hello");
+    Common_spsc_queue_push(pipe, "world");
+
+    Optional first = Common_spsc_queue_pop(pipe);
+    Optional second = Common_spsc_queue_pop(pipe);
+    Optional third = Common_spsc_queue_pop(pipe);
+
+    printf("-> %s %s (then empty: %s)\n", (char*) Common_optional_unpack(&first), (char*) Common_optional_unpack(&second),
+        Common_optional_is_none(&third) ? "yes" : "no");
+
+    return 0;
+}
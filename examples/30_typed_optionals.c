@@ -0,0 +1,49 @@
+#include <stdio.h>
+
+#include "../include/libcommon.h"
+
+typedef struct point_t {
+    int x;
+    int y;
+} Point;
+
+// any type named by a single identifier can get its own typed optional.
+Common_optional_define(Point)
+
+// returns the index of `value` by value, no allocation involved.
+static Common_optional_of(size_t) find_index(const int *values, size_t len, int value) {
+    for (size_t i = 0; i < len; ++i) {
+        if (values[i] == value) {
+            return Common_optional_size_t_with(i);
+        }
+    }
+
+    return Common_optional_size_t_none();
+}
+
+static Common_optional_of(Point) parse_point(const char *s) {
+    Point point;
+    if (sscanf(s, "%d,%d", &point.x, &point.y) != 2) {
+        return Common_optional_Point_none();
+    }
+
+    return Common_optional_Point_with(point);
+}
+
+int main() {
+    int values[] = {4, 8, 15, 16, 23, 42};
+
+    Common_optional_of(size_t) found = find_index(values, 6, 15);
+    Common_optional_of(size_t) missing = find_index(values, 6, 7);
+
+    printf("-> 15 is at index %ld\n", Common_optional_size_t_unpack(found));
+    printf("-> 7 is there: %s\n", Common_optional_size_t_is_some(missing) ? "yes" : "no");
+
+    Point origin = {0, 0};
+    Point point = Common_optional_Point_unpack_default(parse_point("3,4"), origin);
+    Point fallback = Common_optional_Point_unpack_default(parse_point("nope"), origin);
+
+    printf("-> parsed (%d, %d), fallback (%d, %d)\n", point.x, point.y, fallback.x, fallback.y);
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+int main() {
+    StrPool pool = Common_strpool_init();
+    defer({ Common_strpool_destroy(pool); });
+
+    // every string is copied end to end into the pool's blocks, no allocation per string.
+    Common_strpool_add(pool, "net.http.client");
+    Common_strpool_add(pool, "net.http.server");
+    Common_strpool_add(pool, "net.dns.resolver");
+    Common_strpool_add(pool, "net.http.client");
+    Common_strpool_add(pool, "io.files");
+
+    printf("-> %ld strings, second one: %s\n", Common_strpool_len(pool), Common_strpool_get(pool, 1));
+
+    // pointers into the pool work with every function taking a DynamicArray<char*>.
+    DynamicArray view = Common_strpool_to_array(pool);
+    defer({ Common_dynamic_array_destroy(view); });
+
+    char *joined = Common_strmerge_from_array(" ", view);
+    defer({ LCOMMON_FREE(joined); });
+    printf("-> %s\n", joined);
+
+    // the frozen form is sorted, deduplicated and stores only what differs from the previous string.
+    FrozenStrPool frozen = Common_strpool_freeze(pool);
+    defer({ Common_frozen_strpool_destroy(frozen); });
+
+    StringBuilder current = Common_string_builder_init();
+    defer({ Common_string_builder_destroy(current); });
+
+    for (size_t i = 0; i < Common_frozen_strpool_len(frozen); ++i) {
+        Common_frozen_strpool_get(frozen, i, current);
+        printf("-> sorted %ld: %s\n", i, current->data);
+    }
+
+    Common_optional_of(size_t) dns = Common_frozen_strpool_find(frozen, "net.dns.resolver");
+    Common_optional_of(size_t) ftp = Common_frozen_strpool_find(frozen, "net.ftp");
+
+    printf("-> net.dns.resolver is at %ld, net.ftp is there: %s\n", Common_optional_size_t_unpack(dns),
+        Common_optional_size_t_is_some(ftp) ? "yes" : "no");
+
+    return 0;
+}
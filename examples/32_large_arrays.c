@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
+#include "../include/libcommon.h"
+
+#define ELEMENTS (16 * 1024 * 1024)
+
+int main() {
+    // past 64MiB of slots the array moves to its own mapping and keeps growing in place.
+    DynamicArray grown = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(grown); });
+
+    for (uintptr_t i = 0; i < ELEMENTS; ++i) {
+        Common_dynamic_array_append(grown, (void*) i);
+    }
+
+    printf("-> grown: %ld elements, %ld bytes mapped\n", grown->len, grown->mapped);
+
+    // reserving the address space up front means the elements never move.
+    DynamicArray reserved = Common_dynamic_array_init();
+    defer({ Common_dynamic_array_destroy(reserved); });
+
+    Common_dynamic_array_reserve_virtual(reserved, ELEMENTS);
+    void **elements = reserved->elements;
+
+    for (uintptr_t i = 0; i < ELEMENTS; ++i) {
+        Common_dynamic_array_append(reserved, (void*) i);
+    }
+
+    printf("-> reserved: %ld elements, moved: %s\n", reserved->len, reserved->elements != elements ? "yes" : "no");
+    printf("-> last element: %ld\n", (uintptr_t) reserved->elements[reserved->len - 1]);
+
+    return 0;
+}
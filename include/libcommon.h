@@ -2,6 +2,8 @@
 #define LIBCOMMON_H_
 
 #include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #ifndef WITH_LIBCOMMON_DEFINITIONS
@@ -36,12 +38,22 @@ _LIBCOMMON_EXPORT void *Common_smalloc(size_t len);
 // realloc but already checks for null pointer and throws an error.
 _LIBCOMMON_EXPORT void *Common_srealloc(void *ptr, size_t len);
 
+// free counterpart of `Common_smalloc()` and `Common_srealloc()`, any other pointer is
+// handed to free() as is. When libcommon is built with LIBCOMMON_ENABLE_THREAD_CACHE
+// (`make THREAD_CACHE=1`) small allocations come from per-thread caches, so memory
+// obtained from libcommon must be released with this (or LCOMMON_FREE()), never free().
+_LIBCOMMON_EXPORT void Common_sfree(void *ptr);
+
+// gives every block cached by the calling thread back to the shared depot, this happens
+// automatically when a thread exits. Does nothing without LIBCOMMON_ENABLE_THREAD_CACHE.
+_LIBCOMMON_EXPORT void Common_thread_cache_flush(void);
+
 // same as `Common_smalloc` but already does sizeof() for you.
 #define Common_dsmalloc(type) Common_smalloc(sizeof(type));
 
 // helper for freeing data and then set it as null.
 #define LCOMMON_FREE(x) \
-    free((x)); \
+    Common_sfree((x)); \
     (x) = NULL;
 
 // dynamic arrays
@@ -49,20 +61,71 @@ typedef struct dynamic_array_t {
     size_t cap;
     size_t len;
     void **elements;
+    // size in bytes of the anonymous mapping holding `elements` once the array grew
+    // past the mapping threshold or reserved its address space, 0 otherwise.
+    size_t mapped;
+    // first element slots, allocated together with the array. `elements` points here
+    // until the array outgrows them.
+    void *storage[];
 } *DynamicArray;
 
-// initialises a new dynamic array structure.
+// initialises a new dynamic array structure, the array and its first slots are a
+// single allocation.
 _LIBCOMMON_EXPORT DynamicArray Common_dynamic_array_init(void);
 
 // append to a dynamic array x element.
 _LIBCOMMON_EXPORT void Common_dynamic_array_append(DynamicArray array, void *element);
 
+// reserves address space for `max_len` elements up front, the slots are only backed by
+// memory once they are written so the array can reach `max_len` without ever moving or
+// copying. arrays growing past 64MiB of slots switch to a mapping on their own, this is
+// for callers that know the final size and want stable `elements` pointers.
+_LIBCOMMON_EXPORT void Common_dynamic_array_reserve_virtual(DynamicArray array, size_t max_len);
+
 // frees a dynamic array but not the elements.
 _LIBCOMMON_EXPORT void Common_dynamic_array_destroy(DynamicArray array);
 
 // frees a dynamic array and its elements.
 _LIBCOMMON_EXPORT void Common_dynamic_array_free(DynamicArray array);
 
+// small arrays
+
+// amount of element slots a small array keeps inside its own struct.
+#define LCOMMON_SMALL_ARRAY_INLINE_CAP 6
+
+// a compact growable array for arrays that usually stay tiny: the first
+// LCOMMON_SMALL_ARRAY_INLINE_CAP elements live inside the struct (which is exactly 64 bytes on
+// 64-bit targets) and only bigger arrays spill to the heap. It can live on the stack, see
+// `Common_small_array_on_stack()`, and works with `Common_foreach()`.
+typedef struct small_array_t {
+    unsigned int len;
+    unsigned int cap;
+    void **elements;
+    void *inline_elements[LCOMMON_SMALL_ARRAY_INLINE_CAP];
+} *SmallArray;
+
+// declares `name` as a SmallArray whose struct lives on the stack (no allocation at all), release
+// it with `Common_small_array_release()` in case it spilled to the heap.
+#define Common_small_array_on_stack(name) \
+    struct small_array_t name##_storage = { 0, LCOMMON_SMALL_ARRAY_INLINE_CAP, name##_storage.inline_elements, { 0 } }; \
+    SmallArray name = &name##_storage
+
+// creates a new small array (a single allocation).
+_LIBCOMMON_EXPORT SmallArray Common_small_array_init(void);
+
+// appends an element, spilling to the heap once the inline slots are full.
+_LIBCOMMON_EXPORT void Common_small_array_append(SmallArray array, void *element);
+
+// frees the heap buffer of a small array if it has spilled but not the struct nor the elements,
+// meant for arrays declared with `Common_small_array_on_stack()`. The array is left empty.
+_LIBCOMMON_EXPORT void Common_small_array_release(SmallArray array);
+
+// frees a small array created with `Common_small_array_init()` but not the elements.
+_LIBCOMMON_EXPORT void Common_small_array_destroy(SmallArray array);
+
+// frees a small array created with `Common_small_array_init()` and its elements.
+_LIBCOMMON_EXPORT void Common_small_array_free(SmallArray array);
+
 // optionals (util for avoiding usage of NULL)
 typedef struct optional_t {
     void *data;
@@ -132,17 +195,76 @@ _LIBCOMMON_EXPORT void Common_optional_destroy(Optional *optional);
 // NOTE: Use this when you call Common_optional_alloc_with or Common_optional_alloc_none
 _LIBCOMMON_EXPORT void Common_optional_free(Optional *optional);
 
+// typed optionals
+//
+// unlike Optional these store the value itself next to the presence flag, so optional
+// numbers or small structs need no allocation and are passed around in registers. `T` must
+// be a single identifier (use a typedef for e.g. `unsigned long` or pointers).
+
+// the typed optional of `T`, declared once with `Common_optional_define(T)`.
+#define Common_optional_of(T) struct __common_optional_##T
+
+// declares `Common_optional_of(T)` and its functions: `Common_optional_T_with(value)`,
+// `Common_optional_T_none()`, `Common_optional_T_is_some(optional)`,
+// `Common_optional_T_is_none(optional)`, `Common_optional_T_unpack(optional)` (which fails
+// on none) and `Common_optional_T_unpack_default(optional, default_value)`.
+#define Common_optional_define(T) \
+    Common_optional_of(T) { \
+        T data; \
+        int is_none; \
+    }; \
+    static inline Common_optional_of(T) Common_optional_##T##_with(T data) { \
+        Common_optional_of(T) optional = { data, LCOMMON_FALSE }; \
+        return optional; \
+    } \
+    static inline Common_optional_of(T) Common_optional_##T##_none(void) { \
+        Common_optional_of(T) optional = { .is_none = LCOMMON_TRUE }; \
+        return optional; \
+    } \
+    static inline LCOMMON_BOOL Common_optional_##T##_is_some(Common_optional_of(T) optional) { \
+        return !optional.is_none; \
+    } \
+    static inline LCOMMON_BOOL Common_optional_##T##_is_none(Common_optional_of(T) optional) { \
+        return optional.is_none; \
+    } \
+    static inline T Common_optional_##T##_unpack(Common_optional_of(T) optional) { \
+        LCOMMON_ASSERT(!optional.is_none, "given optional should've data"); \
+        return optional.data; \
+    } \
+    static inline T Common_optional_##T##_unpack_default(Common_optional_of(T) optional, T default_value) { \
+        return optional.is_none ? default_value : optional.data; \
+    }
+
+Common_optional_define(int)
+Common_optional_define(long)
+Common_optional_define(size_t)
+Common_optional_define(double)
+Common_optional_define(float)
+Common_optional_define(char)
+
 // Optional specific dynamic arrays implementation
 
 typedef struct optional_array_t {
     size_t len;
     size_t cap;
     Optional **elements;
+    // optionals living in the same allocation as the array (see the bulk constructors),
+    // they are released together with it instead of one by one.
+    Optional *nodes;
+    size_t nodes_len;
 } *OptionalArray;
 
 // creates a new optional array (allocated).
 _LIBCOMMON_EXPORT OptionalArray Common_optional_array_init(void);
 
+// creates an optional array out of `n` pointers, NULL pointers become None optionals (see
+// `Common_optional_from()`). The array, its elements and every optional are laid out in a
+// single allocation which `Common_optional_array_destroy()` releases with a single free.
+_LIBCOMMON_EXPORT OptionalArray Common_optional_array_from_buffer(void **buffer, size_t n);
+
+// same as `Common_optional_array_from_buffer()` using the elements of a dynamic array.
+_LIBCOMMON_EXPORT OptionalArray Common_optional_array_from_array(const DynamicArray array);
+
 // sets data into the N optional in the given optional array.
 _LIBCOMMON_EXPORT void Common_optional_array_set_data_at(
     OptionalArray array,
@@ -205,6 +327,1071 @@ _LIBCOMMON_EXPORT char *Common_strmerge_from_optional_array(
     const OptionalArray optional_array
 );
 
+// creates a new allocated string joining `n` integers with the given separator, without
+// converting every integer into a temporary string first.
+_LIBCOMMON_EXPORT char *Common_strmerge_from_ints(
+    const char *separator,
+    const long long *values,
+    size_t n
+);
+
+// same as `Common_strmerge_from_ints()` but for doubles, see `Common_format_double()`.
+_LIBCOMMON_EXPORT char *Common_strmerge_from_doubles(
+    const char *separator,
+    const double *values,
+    size_t n
+);
+
+// same as `Common_strmerge_from_array()` but measures and copies the elements from
+// `threads` threads at once (0 uses one per online CPU), meant for arrays with millions of
+// elements. Small arrays are simply joined by the calling thread.
+_LIBCOMMON_EXPORT char *Common_strmerge_from_array_parallel(
+    const char *separator,
+    const DynamicArray dynamic_array,
+    size_t threads
+);
+
+// same as `Common_strmerge_from_optional_array()` but split over `threads` threads, see
+// `Common_strmerge_from_array_parallel()`.
+_LIBCOMMON_EXPORT char *Common_strmerge_from_optional_array_parallel(
+    const char *separator,
+    const OptionalArray optional_array,
+    size_t threads
+);
+
+// string builders and formatting
+
+// a growable buffer which is always kept NUL terminated, so `builder->data` can be
+// used as a regular string at any moment.
+typedef struct string_builder_t {
+    size_t cap;
+    size_t len;
+    char *data;
+} *StringBuilder;
+
+// the biggest amount of bytes any of the `Common_format_*()` converters can write.
+#define LCOMMON_FORMAT_BUFFER_SIZE 32
+
+// initialises a new empty string builder.
+_LIBCOMMON_EXPORT StringBuilder Common_string_builder_init(void);
+
+// frees a string builder and its buffer.
+_LIBCOMMON_EXPORT void Common_string_builder_destroy(StringBuilder builder);
+
+// frees the string builder but returns its buffer shrunk to the right size, the
+// caller is responsible for freeing it with LCOMMON_FREE().
+_LIBCOMMON_EXPORT char *Common_string_builder_take(StringBuilder builder);
+
+// empties the string builder but keeps its buffer around for reuse.
+_LIBCOMMON_EXPORT void Common_string_builder_clear(StringBuilder builder);
+
+// makes sure at least `extra` more bytes can be appended without reallocating.
+_LIBCOMMON_EXPORT void Common_string_builder_reserve(StringBuilder builder, size_t extra);
+
+// appends a NUL terminated string.
+_LIBCOMMON_EXPORT void Common_string_builder_append(StringBuilder builder, const char *s);
+
+// appends the first `n` bytes of `s`.
+_LIBCOMMON_EXPORT void Common_string_builder_append_n(StringBuilder builder, const char *s, size_t n);
+
+// appends a single character.
+_LIBCOMMON_EXPORT void Common_string_builder_append_char(StringBuilder builder, char c);
+
+// appends a signed integer in decimal.
+_LIBCOMMON_EXPORT void Common_string_builder_append_int(StringBuilder builder, long long value);
+
+// appends an unsigned integer in decimal.
+_LIBCOMMON_EXPORT void Common_string_builder_append_uint(StringBuilder builder, unsigned long long value);
+
+// appends an unsigned integer in lowercase hexadecimal, without any prefix.
+_LIBCOMMON_EXPORT void Common_string_builder_append_hex(StringBuilder builder, unsigned long long value);
+
+// appends a double using a short representation that parses back to the same value,
+// see `Common_format_double()`.
+_LIBCOMMON_EXPORT void Common_string_builder_append_double(StringBuilder builder, double value);
+
+// appends every string of a DynamicArray<char*> joined with the given separator.
+_LIBCOMMON_EXPORT void Common_string_builder_append_array(
+    StringBuilder builder,
+    const char *separator,
+    const DynamicArray array
+);
+
+// appends every non None string of an OptionalArray<char*> joined with the given separator.
+_LIBCOMMON_EXPORT void Common_string_builder_append_optional_array(
+    StringBuilder builder,
+    const char *separator,
+    const OptionalArray array
+);
+
+// appends `n` integers joined with the given separator.
+_LIBCOMMON_EXPORT void Common_string_builder_join_ints(
+    StringBuilder builder,
+    const char *separator,
+    const long long *values,
+    size_t n
+);
+
+// appends `n` doubles joined with the given separator.
+_LIBCOMMON_EXPORT void Common_string_builder_join_doubles(
+    StringBuilder builder,
+    const char *separator,
+    const double *values,
+    size_t n
+);
+
+// printf-like formatting straight into a string builder, every printf(3) conversion,
+// flag, width and precision is accepted and prints what printf would. Strings, characters
+// and integers are formatted without going through the C library, floating point
+// conversions are handed to snprintf() (use `Common_string_builder_append_double()` for the
+// short round-trip form). The decimal point is always '.', whatever the current locale
+// says, and the ' flag is ignored. An unknown conversion or a lone '%' at the end of
+// `format` is copied through as written.
+_LIBCOMMON_EXPORT void Common_format(StringBuilder builder, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// same as `Common_format()` but takes a va_list.
+_LIBCOMMON_EXPORT void Common_vformat(StringBuilder builder, const char *format, va_list args);
+
+// writes `value` in decimal into `out` (without a NUL), returns the amount of bytes written.
+// `out` must have room for LCOMMON_FORMAT_BUFFER_SIZE bytes.
+_LIBCOMMON_EXPORT size_t Common_format_int(char *out, long long value);
+
+// same as `Common_format_int()` but for unsigned integers.
+_LIBCOMMON_EXPORT size_t Common_format_uint(char *out, unsigned long long value);
+
+// same as `Common_format_uint()` but writes lowercase hexadecimal.
+_LIBCOMMON_EXPORT size_t Common_format_hex(char *out, unsigned long long value);
+
+// writes a decimal representation of `value` which reads back as the exact same double,
+// using scientific notation for very big or very small magnitudes. It's the shortest one
+// for almost every double, a few get one more digit than needed (1e23 is written as
+// 9.999999999999999e+22).
+_LIBCOMMON_EXPORT size_t Common_format_double(char *out, double value);
+
+// numeric parsing
+//
+// parsers read a number from the start of a buffer of `len` bytes (which doesn't need to
+// be NUL terminated), they never skip whitespace and never look at the current locale.
+// Results behave like an Optional: `is_none` is set when no number could be read or when
+// it doesn't fit the result type, otherwise `consumed` tells how many bytes were used.
+
+typedef struct parsed_int_t {
+    long long value;
+    size_t consumed;
+    int is_none;
+} ParsedInt;
+
+typedef struct parsed_uint_t {
+    unsigned long long value;
+    size_t consumed;
+    int is_none;
+} ParsedUint;
+
+typedef struct parsed_double_t {
+    double value;
+    size_t consumed;
+    int is_none;
+} ParsedDouble;
+
+// parses an optionally signed decimal integer.
+_LIBCOMMON_EXPORT ParsedInt Common_parse_int(const char *s, size_t len);
+
+// parses an unsigned decimal integer (a leading '+' is accepted).
+_LIBCOMMON_EXPORT ParsedUint Common_parse_uint(const char *s, size_t len);
+
+// parses a decimal floating point number with an optional exponent, "inf", "infinity"
+// and "nan" are accepted in any case. Numbers too big for a double are none.
+_LIBCOMMON_EXPORT ParsedDouble Common_parse_double(const char *s, size_t len);
+
+// parses a buffer of integers delimited by `separator` (e.g. a CSV row) into `out`, up to
+// `out_cap` of them. Parsing stops at the end of the buffer, when `out` is full or at the
+// first field which isn't a number. Returns how many numbers were written and stores in
+// `consumed` (if not NULL) the offset right after the last parsed number.
+_LIBCOMMON_EXPORT size_t Common_parse_ints(
+    const char *s,
+    size_t len,
+    char separator,
+    long long *out,
+    size_t out_cap,
+    size_t *consumed
+);
+
+// same as `Common_parse_ints()` but for doubles.
+_LIBCOMMON_EXPORT size_t Common_parse_doubles(
+    const char *s,
+    size_t len,
+    char separator,
+    double *out,
+    size_t out_cap,
+    size_t *consumed
+);
+
+// substring search
+//
+// short needles are matched by comparing their first and last bytes against 16 or 32
+// haystack positions at once (SSE2/AVX2), long ones use the two-way algorithm (reading the
+// haystack backwards for reverse searches) so the search stays linear no matter the input.
+
+// finds the first `needle_len` bytes long needle inside a haystack of `haystack_len`
+// bytes, returns NULL if it isn't there.
+_LIBCOMMON_EXPORT const char *Common_memfind(
+    const char *haystack,
+    size_t haystack_len,
+    const char *needle,
+    size_t needle_len
+);
+
+// same as `Common_memfind()` but returns the last occurrence.
+_LIBCOMMON_EXPORT const char *Common_memrfind(
+    const char *haystack,
+    size_t haystack_len,
+    const char *needle,
+    size_t needle_len
+);
+
+// finds the first occurrence of `needle` in `haystack`, returns an Optional<char*> which
+// points inside the haystack.
+_LIBCOMMON_EXPORT Optional Common_strfind(const char *haystack, const char *needle);
+
+// same as `Common_strfind()` but for the last occurrence.
+_LIBCOMMON_EXPORT Optional Common_strrfind(const char *haystack, const char *needle);
+
+// checks if `needle` is somewhere in `haystack`.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_strcontains(const char *haystack, const char *needle);
+
+// counts the non overlapping occurrences of a non empty `needle` in `haystack`.
+_LIBCOMMON_EXPORT size_t Common_strcount_occurrences(const char *haystack, const char *needle);
+
+// creates a new allocated string where every occurrence of `from` (which can't be empty)
+// is replaced with `to`. The result is sized up front and allocated once, the caller is
+// responsible for freeing it with LCOMMON_FREE().
+_LIBCOMMON_EXPORT char *Common_strreplace(const char *s, const char *from, const char *to);
+
+// splits `s` at every occurrence of a non empty `separator`, returns a DynamicArray<char*>
+// of allocated pieces (empty pieces included) which must be released with
+// `Common_dynamic_array_free()`.
+_LIBCOMMON_EXPORT DynamicArray Common_strsplit(const char *s, const char *separator);
+
+// hashing
+//
+// fast non-cryptographic 64-bit hashing based on wyhash, don't use it where an attacker
+// could pick the keys unless the seed is kept secret.
+
+// incremental hashing state, see `Common_hash_stream_init()`.
+typedef struct hash_stream_t {
+    unsigned long long seed;
+    unsigned long long see1;
+    unsigned long long see2;
+    unsigned long long total_len;
+    size_t buffered;
+    // the 16 bytes before `buffer + 16` keep the tail of what was already consumed.
+    unsigned char buffer[64];
+} HashStream;
+
+// hashes `len` bytes with the given seed.
+_LIBCOMMON_EXPORT unsigned long long Common_hash_bytes(const void *data, size_t len, unsigned long long seed);
+
+// hashes a NUL terminated string, same as `Common_hash_bytes(s, strlen(s), seed)`.
+_LIBCOMMON_EXPORT unsigned long long Common_hash_str(const char *s, unsigned long long seed);
+
+// hashes a NUL terminated string while computing its length in the same pass, the
+// length is stored in `len` when it's not NULL.
+_LIBCOMMON_EXPORT unsigned long long Common_hash_str_len(const char *s, unsigned long long seed, size_t *len);
+
+// hashes a fixed width integer, much cheaper than hashing its bytes.
+_LIBCOMMON_EXPORT unsigned long long Common_hash_u64(unsigned long long value, unsigned long long seed);
+
+// starts an incremental hash, feeding the same bytes in any amount of chunks gives the
+// exact same result as `Common_hash_bytes()`.
+_LIBCOMMON_EXPORT void Common_hash_stream_init(HashStream *stream, unsigned long long seed);
+
+// feeds `len` more bytes into the stream.
+_LIBCOMMON_EXPORT void Common_hash_stream_update(HashStream *stream, const void *data, size_t len);
+
+// returns the hash of everything fed so far, the stream can keep being updated after.
+_LIBCOMMON_EXPORT unsigned long long Common_hash_stream_digest(const HashStream *stream);
+
+// utf-8 helpers
+//
+// every function works on `len` bytes and has an AVX2 implementation which is picked at
+// runtime when the cpu supports it (building with -DLIBCOMMON_DISABLE_SIMD forces the
+// portable scalar one).
+
+// result of measuring a NUL terminated string, see `Common_utf8_measure()`.
+typedef struct utf8_measure_t {
+    size_t bytes;
+    size_t codepoints;
+    int is_valid;
+} Utf8Measure;
+
+// checks if the buffer is well formed utf-8 (no overlong encodings, surrogates, code
+// points above U+10FFFF nor truncated sequences).
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_utf8_validate(const char *s, size_t len);
+
+// counts the code points of a valid utf-8 buffer, unlike `Common_strcount()` which counts
+// bytes. Invalid input doesn't crash but the result is meaningless.
+_LIBCOMMON_EXPORT size_t Common_utf8_count(const char *s, size_t len);
+
+// stores in `offset` the byte offset where the N code point (starting at 0) begins, N
+// may be the amount of code points, pointing to the end of the buffer. Returns
+// LCOMMON_FALSE when the buffer has fewer code points.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_utf8_offset_of(
+    const char *s,
+    size_t len,
+    size_t n,
+    size_t *offset
+);
+
+// validates a NUL terminated string while computing its length in bytes and in code
+// points, everything in a single pass over memory.
+_LIBCOMMON_EXPORT Utf8Measure Common_utf8_measure(const char *s);
+
+// binary snapshots
+//
+// a snapshot file is a fixed header, a table of `len + 1` 64-bit offsets into a blob, an
+// optional None bitmap (one bit per element, set when the element is None) and finally the
+// blob itself, where every string is stored NUL terminated. Records are stored back to back
+// without an offsets table. Everything is written in native byte order and the blob is 64
+// bytes aligned so the whole file can be mmap()ed and used in place.
+
+typedef enum snapshot_kind_t {
+    LCOMMON_SNAPSHOT_STRINGS = 1,
+    LCOMMON_SNAPSHOT_RECORDS = 2,
+    LCOMMON_SNAPSHOT_OPTIONAL_STRINGS = 3
+} SnapshotKind;
+
+// read-only view over a mapped snapshot file, see `Common_snapshot_map()`.
+typedef struct snapshot_t *Snapshot;
+
+// writes a DynamicArray<char*> into `path`, returns LCOMMON_FALSE if the file couldn't
+// be written.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_dynamic_array_save(const DynamicArray array, const char *path);
+
+// writes a DynamicArray whose elements point to records of `record_size` bytes into `path`.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_dynamic_array_save_records(
+    const DynamicArray array,
+    size_t record_size,
+    const char *path
+);
+
+// reads a strings snapshot back into an Optional<DynamicArray<char*>>, every string gets
+// its own allocation so the result must be released with `Common_dynamic_array_free()`.
+// The optional is none when the file is missing or isn't a strings snapshot.
+_LIBCOMMON_EXPORT Optional Common_dynamic_array_load(const char *path);
+
+// same as `Common_dynamic_array_load()` but for a records snapshot, `record_size` must
+// match the one the snapshot was saved with.
+_LIBCOMMON_EXPORT Optional Common_dynamic_array_load_records(const char *path, size_t record_size);
+
+// writes an OptionalArray<char*> into `path`, None elements are kept in the bitmap.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_optional_array_save(const OptionalArray array, const char *path);
+
+// reads an optional strings snapshot back into an Optional<OptionalArray<char*>>, the
+// result must be released with `Common_optional_array_free()`.
+_LIBCOMMON_EXPORT Optional Common_optional_array_load(const char *path);
+
+// maps a snapshot file of any kind read-only into memory, returns an Optional<Snapshot>.
+// Nothing is parsed nor copied, elements are read straight from the mapping.
+_LIBCOMMON_EXPORT Optional Common_snapshot_map(const char *path);
+
+// unmaps a snapshot, every pointer obtained from it becomes invalid.
+_LIBCOMMON_EXPORT void Common_snapshot_unmap(Snapshot snapshot);
+
+// returns what kind of data the snapshot holds.
+_LIBCOMMON_EXPORT SnapshotKind Common_snapshot_kind(const Snapshot snapshot);
+
+// returns the amount of elements in the snapshot.
+_LIBCOMMON_EXPORT size_t Common_snapshot_len(const Snapshot snapshot);
+
+// returns the record size of a records snapshot (0 for strings snapshots).
+_LIBCOMMON_EXPORT size_t Common_snapshot_record_size(const Snapshot snapshot);
+
+// checks if the N element of an optional strings snapshot is None.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_snapshot_is_none_at(const Snapshot snapshot, size_t n);
+
+// returns a pointer to the N string inside the mapping, or NULL if the element is None
+// or its offsets are corrupt.
+_LIBCOMMON_EXPORT const char *Common_snapshot_string_at(const Snapshot snapshot, size_t n);
+
+// returns the length of the N string without having to scan it (0 for None elements).
+_LIBCOMMON_EXPORT size_t Common_snapshot_string_len_at(const Snapshot snapshot, size_t n);
+
+// returns a pointer to the N record inside the mapping.
+_LIBCOMMON_EXPORT const void *Common_snapshot_record_at(const Snapshot snapshot, size_t n);
+
+// creates a DynamicArray whose elements point inside the mapping (None elements are
+// skipped), release it with `Common_dynamic_array_destroy()` before unmapping.
+_LIBCOMMON_EXPORT DynamicArray Common_snapshot_to_array(const Snapshot snapshot);
+
+// shared arrays
+
+// an append-only array for one writer thread and any amount of reader threads. Growing
+// publishes a new elements buffer instead of reallocating in place, readers take lock-free
+// snapshots of `(elements, len)` and replaced buffers are freed once no reader can still
+// be looking at them (epoch based reclamation).
+typedef struct shared_array_t *SharedArray;
+
+// per-thread registration needed to read a SharedArray, see `Common_shared_array_reader_init()`.
+typedef struct shared_array_reader_t *SharedArrayReader;
+
+// consistent view of a SharedArray, valid until `Common_shared_array_read_unlock()`. It has
+// `len` and `elements` so it can be used with `Common_foreach()` by passing its address.
+typedef struct shared_array_view_t {
+    size_t len;
+    void **elements;
+} SharedArrayView;
+
+// creates a new shared array (allocated).
+_LIBCOMMON_EXPORT SharedArray Common_shared_array_init(void);
+
+// appends an element, only the writer thread may call this.
+_LIBCOMMON_EXPORT void Common_shared_array_append(SharedArray array, void *element);
+
+// frees the buffers no reader can see anymore (appending already does this when growing)
+// and returns how many replaced buffers are still waiting for readers to move on. Only
+// the writer thread may call this.
+_LIBCOMMON_EXPORT size_t Common_shared_array_reclaim(SharedArray array);
+
+// frees a shared array but not the elements, there must be no reader in a read section.
+_LIBCOMMON_EXPORT void Common_shared_array_destroy(SharedArray array);
+
+// frees a shared array and its elements, there must be no reader in a read section.
+_LIBCOMMON_EXPORT void Common_shared_array_free(SharedArray array);
+
+// registers the calling thread as a reader of the array, a reader must only be used by
+// one thread at a time and is released with `Common_shared_array_reader_destroy()`.
+_LIBCOMMON_EXPORT SharedArrayReader Common_shared_array_reader_init(SharedArray array);
+
+// unregisters a reader, it must not be inside a read section.
+_LIBCOMMON_EXPORT void Common_shared_array_reader_destroy(SharedArrayReader reader);
+
+// enters a read section and returns a snapshot of the array, the writer can keep appending
+// but the returned elements stay valid until the section ends. Sections don't nest.
+_LIBCOMMON_EXPORT SharedArrayView Common_shared_array_read_lock(SharedArrayReader reader);
+
+// leaves the read section, the view obtained from it must not be used anymore.
+_LIBCOMMON_EXPORT void Common_shared_array_read_unlock(SharedArrayReader reader);
+
+// scratch allocator
+
+// every thread owns a scratch region, a stack of chunks where allocations are a pointer
+// bump and releasing everything allocated since a mark is a single pointer reset. Memory
+// from it must never be passed to LCOMMON_FREE(), it goes away when its scope is popped.
+typedef struct scratch_mark_t {
+    void *chunk;
+    size_t used;
+} ScratchMark;
+
+// remembers the current position of the calling thread's scratch region.
+_LIBCOMMON_EXPORT ScratchMark Common_scratch_push(void);
+
+// releases every scratch allocation made after `mark` was pushed, marks must be popped in
+// the reverse order they were pushed.
+_LIBCOMMON_EXPORT void Common_scratch_pop(ScratchMark mark);
+
+// allocates `len` bytes (16 bytes aligned) from the calling thread's scratch region.
+_LIBCOMMON_EXPORT void *Common_scratch_alloc(size_t len);
+
+// frees every chunk of the calling thread's scratch region, which also happens on its own
+// when a thread exits. There must be no scratch scope alive.
+_LIBCOMMON_EXPORT void Common_scratch_release(void);
+
+// copies a string into scratch memory.
+_LIBCOMMON_EXPORT char *Common_scratch_strdup(const char *s);
+
+// same as `Common_strmerge()` but the result lives in scratch memory.
+_LIBCOMMON_EXPORT char *__private__Common_scratch_strmerge(const char *separator, const char *first, ...);
+#define Common_scratch_strmerge(...) __private__Common_scratch_strmerge(__VA_ARGS__, LCOMMON_TERMINATOR)
+
+// same as `Common_strmerge_from_array()` but the result lives in scratch memory.
+_LIBCOMMON_EXPORT char *Common_scratch_strmerge_from_array(
+    const char *separator,
+    const DynamicArray dynamic_array
+);
+
+// opens a scratch scope which lasts until the end of the enclosing block, every scratch
+// allocation made inside it is released at once when the block is left (return, break,
+// goto...). Only relies on `__attribute__((cleanup))`, so unlike defer it works on clang.
+_LIBCOMMON_EXPORT void __private__Common_scratch_scope_exit(ScratchMark *mark);
+#define __private__Common_scratch_concat_(a, b) a##b
+#define __private__Common_scratch_concat(a, b) __private__Common_scratch_concat_(a, b)
+#define Common_scratch_scope() \
+    __attribute__((cleanup(__private__Common_scratch_scope_exit), unused)) \
+    ScratchMark __private__Common_scratch_concat(__lcommon_scratch_mark_, __LINE__) = Common_scratch_push()
+
+// heaps (priority queues)
+
+// a min-heap laid out as a 4-ary tree, every entry stores its key right next to the payload
+// pointer so sifting never has to dereference payloads (except in comparator mode).
+typedef struct heap_t *Heap;
+
+// identifies an entry for `Common_heap_update_*()` and `Common_heap_remove()`, it stays
+// valid until that entry leaves the heap, after which it may be reused by another push.
+typedef size_t HeapHandle;
+
+// orders two payloads like strcmp(): negative when `a` must be popped before `b`.
+typedef int (*HeapCompare)(const void *a, const void *b);
+
+// creates an empty heap which orders payloads with `compare`.
+_LIBCOMMON_EXPORT Heap Common_heap_init(HeapCompare compare);
+
+// creates an empty heap ordered by integer keys (smallest first).
+_LIBCOMMON_EXPORT Heap Common_heap_init_int(void);
+
+// creates an empty heap ordered by double keys (smallest first), NaN keys are not supported.
+_LIBCOMMON_EXPORT Heap Common_heap_init_double(void);
+
+// builds a comparator heap out of every element of the array in O(n), the handle of the
+// element at index N is N. The array itself is left untouched.
+_LIBCOMMON_EXPORT Heap Common_heap_from_array(HeapCompare compare, const DynamicArray array);
+
+// same as `Common_heap_from_array()` but the element at index N gets `keys[N]` as its key.
+_LIBCOMMON_EXPORT Heap Common_heap_from_array_int(const DynamicArray array, const long long *keys);
+
+// same as `Common_heap_from_array_int()` but for double keys.
+_LIBCOMMON_EXPORT Heap Common_heap_from_array_double(const DynamicArray array, const double *keys);
+
+// frees a heap but not the payloads.
+_LIBCOMMON_EXPORT void Common_heap_destroy(Heap heap);
+
+// frees a heap and every payload still inside.
+_LIBCOMMON_EXPORT void Common_heap_free(Heap heap);
+
+// returns the amount of entries in the heap.
+_LIBCOMMON_EXPORT size_t Common_heap_len(const Heap heap);
+
+// pushes a payload into a comparator heap.
+_LIBCOMMON_EXPORT HeapHandle Common_heap_push(Heap heap, void *payload);
+
+// pushes a payload with an integer key.
+_LIBCOMMON_EXPORT HeapHandle Common_heap_push_int(Heap heap, long long key, void *payload);
+
+// pushes a payload with a double key.
+_LIBCOMMON_EXPORT HeapHandle Common_heap_push_double(Heap heap, double key, void *payload);
+
+// returns an Optional<void*> with the first payload without removing it.
+_LIBCOMMON_EXPORT Optional Common_heap_peek(const Heap heap);
+
+// removes the first payload and returns it as an Optional<void*>, none if the heap is empty.
+_LIBCOMMON_EXPORT Optional Common_heap_pop(Heap heap);
+
+// returns the key of the first entry of a non empty integer heap.
+_LIBCOMMON_EXPORT long long Common_heap_top_int(const Heap heap);
+
+// returns the key of the first entry of a non empty double heap.
+_LIBCOMMON_EXPORT double Common_heap_top_double(const Heap heap);
+
+// restores the order of a comparator heap after the payload behind `handle` changed.
+_LIBCOMMON_EXPORT void Common_heap_update(Heap heap, HeapHandle handle);
+
+// changes the key of an entry, both decreasing and increasing it is supported.
+_LIBCOMMON_EXPORT void Common_heap_update_int(Heap heap, HeapHandle handle, long long key);
+
+// same as `Common_heap_update_int()` but for double keys.
+_LIBCOMMON_EXPORT void Common_heap_update_double(Heap heap, HeapHandle handle, double key);
+
+// removes the entry behind `handle` from anywhere in the heap and returns its payload, the
+// handle is dead afterwards (as it is once its entry got popped).
+_LIBCOMMON_EXPORT void *Common_heap_remove(Heap heap, HeapHandle handle);
+
+// top-k mode: keeps at most `k` entries, the greatest ones, so the first entry is always the
+// smallest of the top k. Returns an Optional<void*> with the payload that got pushed out (the
+// previous first entry or the offered one), none while the heap holds fewer than `k` entries.
+// The heap must not already hold more than `k` entries (pushes and a smaller `k` can do that).
+_LIBCOMMON_EXPORT Optional Common_heap_offer(Heap heap, size_t k, void *payload);
+
+// top-k mode for integer heaps, see `Common_heap_offer()`.
+_LIBCOMMON_EXPORT Optional Common_heap_offer_int(Heap heap, size_t k, long long key, void *payload);
+
+// top-k mode for double heaps, see `Common_heap_offer()`.
+_LIBCOMMON_EXPORT Optional Common_heap_offer_double(Heap heap, size_t k, double key, void *payload);
+
+// tracing
+
+// when libcommon is built with LIBCOMMON_ENABLE_TRACING (`make TRACING=1`) every thread records
+// compact events (timestamp, event id, argument) into its own ring buffer while tracing is
+// started, both from the library itself (array growth, strmerge, allocation slow paths) and
+// from user spans. The ring of an exiting thread, events included, goes to the next thread
+// which records something. Stopped tracing costs a single branch per event site. Without the flag
+// every function below does nothing and the macros expand to nothing.
+
+// starts recording events, the timestamps of a dump are relative to the first start.
+_LIBCOMMON_EXPORT void Common_trace_start(void);
+
+// stops recording events, already recorded ones are kept for `Common_trace_dump()`.
+_LIBCOMMON_EXPORT void Common_trace_stop(void);
+
+// returns the id of the event named `name`, registering it the first time. The name must
+// outlive the trace (string literals are fine). Returns 0 when there's no room for more names.
+_LIBCOMMON_EXPORT unsigned int Common_trace_event(const char *name);
+
+// records an instant event, a begin or an end of a span for the calling thread.
+_LIBCOMMON_EXPORT void Common_trace_instant(unsigned int id, unsigned long long arg);
+_LIBCOMMON_EXPORT void Common_trace_begin(unsigned int id, unsigned long long arg);
+_LIBCOMMON_EXPORT void Common_trace_end(unsigned int id, unsigned long long arg);
+
+// writes every recorded event into `path` using the Chrome trace JSON format (chrome://tracing,
+// Perfetto). Stop tracing first, rings being written to while dumping may lose events. Returns
+// LCOMMON_FALSE if the file couldn't be written.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_trace_dump(const char *path);
+
+#ifdef LIBCOMMON_ENABLE_TRACING
+_LIBCOMMON_EXPORT int __private__Common_trace_active;
+
+typedef struct trace_span_t {
+    unsigned int id;
+} TraceSpan;
+
+_LIBCOMMON_EXPORT TraceSpan __private__Common_trace_span_enter(unsigned int *id, const char *name);
+
+static inline void __private__Common_trace_span_exit(TraceSpan *span) {
+    if (span->id != 0) {
+        Common_trace_end(span->id, 0);
+    }
+}
+
+#define __private__Common_trace_concat_(a, b) a##b
+#define __private__Common_trace_concat(a, b) __private__Common_trace_concat_(a, b)
+#define __private__Common_trace_is_active() \
+    __builtin_expect(__atomic_load_n(&__private__Common_trace_active, __ATOMIC_RELAXED), 0)
+
+// traces the rest of the enclosing block as a span called `name` (a string literal).
+#define LCOMMON_TRACE_SPAN(name) \
+    static unsigned int __private__Common_trace_concat(__lcommon_trace_id_, __LINE__) = 0; \
+    __attribute__((cleanup(__private__Common_trace_span_exit), unused)) \
+    TraceSpan __private__Common_trace_concat(__lcommon_trace_span_, __LINE__) = \
+        __private__Common_trace_is_active() \
+            ? __private__Common_trace_span_enter(&__private__Common_trace_concat(__lcommon_trace_id_, __LINE__), name) \
+            : (TraceSpan) {0}
+
+// records an instant event called `name` (a string literal) with an argument.
+#define LCOMMON_TRACE_INSTANT(name, arg) \
+    do { \
+        if (__private__Common_trace_is_active()) { \
+            static unsigned int __lcommon_trace_id = 0; \
+            unsigned int __lcommon_id = __atomic_load_n(&__lcommon_trace_id, __ATOMIC_RELAXED); \
+            if (__lcommon_id == 0) { \
+                __lcommon_id = Common_trace_event(name); \
+                __atomic_store_n(&__lcommon_trace_id, __lcommon_id, __ATOMIC_RELAXED); \
+            } \
+            Common_trace_instant(__lcommon_id, (arg)); \
+        } \
+    } while (0)
+#else
+#define LCOMMON_TRACE_SPAN(name) ((void) 0)
+#define LCOMMON_TRACE_INSTANT(name, arg) ((void) 0)
+#endif
+
+// output sinks
+
+// a destination for streamed output: a file descriptor (files, pipes, sockets), a FILE* or a
+// user callback. Joins written to a sink are never assembled in memory, file descriptors get
+// the pieces and separators straight from the elements through batched writev() calls.
+typedef struct output_sink_t *OutputSink;
+
+// receives every piece written to a callback sink, returns LCOMMON_FALSE to report an error.
+typedef LCOMMON_BOOL (*OutputSinkCallback)(void *context, const char *data, size_t len);
+
+// creates a sink writing to `fd`, the descriptor isn't closed by the sink.
+_LIBCOMMON_EXPORT OutputSink Common_output_sink_fd(int fd);
+
+// creates a sink writing to `file`, the file isn't closed by the sink.
+_LIBCOMMON_EXPORT OutputSink Common_output_sink_file(FILE *file);
+
+// creates a sink handing every piece to `callback` along with `context`.
+_LIBCOMMON_EXPORT OutputSink Common_output_sink_callback(OutputSinkCallback callback, void *context);
+
+// writes `len` bytes, returns LCOMMON_FALSE if this or any previous write failed.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_output_sink_write(OutputSink sink, const char *data, size_t len);
+
+// same as `Common_output_sink_write()` for a NUL terminated string.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_output_sink_write_str(OutputSink sink, const char *s);
+
+// streams the elements of a DynamicArray<char*> joined by `separator`, like
+// `Common_strmerge_from_array()` but without building the merged string.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_output_sink_write_array(
+    OutputSink sink,
+    const char *separator,
+    const DynamicArray array
+);
+
+// streams the non None elements of an OptionalArray<char*> joined by `separator`, like
+// `Common_strmerge_from_optional_array()` but without building the merged string.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_output_sink_write_optional_array(
+    OutputSink sink,
+    const char *separator,
+    const OptionalArray array
+);
+
+// pushes anything the sink still holds (fflush() for FILE sinks).
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_output_sink_flush(OutputSink sink);
+
+// flushes and frees a sink, returns LCOMMON_FALSE if anything written to it failed.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_output_sink_destroy(OutputSink sink);
+
+// writes the elements of a DynamicArray<char*> joined by `separator` straight into `fd`.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_write_array(int fd, const char *separator, const DynamicArray array);
+
+// writes the non None elements of an OptionalArray<char*> joined by `separator` into `fd`.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_write_optional_array(int fd, const char *separator, const OptionalArray array);
+
+// batched file io
+
+// reads and writes whole batches of files with as few syscalls as possible: on Linux every
+// step of a batch (open, read or write, close) is queued in an io_uring and submitted at
+// once, elsewhere (or when io_uring isn't available) a pool of threads runs plain pread()
+// and pwrite() calls in parallel. Small reads land in a pool of buffers registered once with
+// the kernel. An IoContext must only be used by one thread at a time.
+typedef struct io_context_t *IoContext;
+
+// contents of a file, `data` is followed by a NUL byte so text can be used as a string.
+typedef struct io_buffer_t {
+    char *data;
+    size_t len;
+} IoBuffer;
+
+// creates an io context whose pool holds `pool_buffers` buffers of `pool_buffer_size` bytes
+// (files bigger than that get their own allocation), 0 picks the defaults for either.
+_LIBCOMMON_EXPORT IoContext Common_io_init(size_t pool_buffers, size_t pool_buffer_size);
+
+// checks if the context submits through io_uring or runs the thread pool fallback. Kernels
+// older than 5.6 lack the needed operations and get the fallback, a context also switches to
+// it for good if its ring fails.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_io_uses_io_uring(const IoContext context);
+
+// reads every file of a DynamicArray<char*> of paths, returns an OptionalArray<IoBuffer*> in
+// the same order where files that couldn't be read are None. Release it with
+// `Common_io_results_release()`.
+_LIBCOMMON_EXPORT OptionalArray Common_io_read_files(IoContext context, const DynamicArray paths);
+
+// same as `Common_io_read_files()` but reads `n` already open descriptors from offset 0.
+_LIBCOMMON_EXPORT OptionalArray Common_io_read_fds(IoContext context, const int *fds, size_t n);
+
+// writes `buffers[N]` (an IoBuffer*) into `paths[N]`, creating or truncating the files. When
+// `written` isn't NULL it gets whether each file was written completely, returns how many were.
+_LIBCOMMON_EXPORT size_t Common_io_write_files(
+    IoContext context,
+    const DynamicArray paths,
+    const DynamicArray buffers,
+    LCOMMON_BOOL *written
+);
+
+// gives a buffer obtained from a read back to its context.
+_LIBCOMMON_EXPORT void Common_io_buffer_release(IoContext context, IoBuffer *buffer);
+
+// releases every buffer of a read result and the result itself.
+_LIBCOMMON_EXPORT void Common_io_results_release(IoContext context, OptionalArray results);
+
+// frees an io context, every buffer obtained from it must have been released.
+_LIBCOMMON_EXPORT void Common_io_destroy(IoContext context);
+
+// slot maps
+
+// stores elements densely like a DynamicArray but hands out handles which stay valid until
+// their element is removed: a handle packs a slot index (low 32 bits) and the generation of
+// that slot (high 32 bits), removing an element bumps the generation of its slot so stale
+// handles are detected even after the slot is reused. The elements can be iterated with
+// `Common_foreach()`, removals move the last element into the hole so their order changes.
+typedef unsigned long long SlotMapHandle;
+
+// a handle no element ever gets, e.g. to mark a missing reference.
+#define LCOMMON_SLOTMAP_NULL_HANDLE ((SlotMapHandle) 0)
+
+struct slotmap_slot_t {
+    unsigned generation;
+    // dense index of the element while the slot is used, next free slot otherwise.
+    unsigned index;
+};
+
+typedef struct slotmap_t {
+    size_t len;
+    void **elements;
+    // `slot_of[N]` is the slot of `elements[N]`, needed to fix it up when N moves.
+    unsigned *slot_of;
+    size_t cap;
+    struct slotmap_slot_t *slots;
+    size_t slots_len;
+    size_t slots_cap;
+    unsigned free_slot;
+} *SlotMap;
+
+// creates a new empty slot map (allocated).
+_LIBCOMMON_EXPORT SlotMap Common_slotmap_init(void);
+
+// inserts an element in O(1), reusing the most recently freed slot if any.
+_LIBCOMMON_EXPORT SlotMapHandle Common_slotmap_insert(SlotMap map, void *element);
+
+// returns an Optional with the element of a handle, None if it was removed (or never valid).
+_LIBCOMMON_EXPORT Optional Common_slotmap_get(const SlotMap map, SlotMapHandle handle);
+
+// checks if the element of a handle is still in the map.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_slotmap_contains(const SlotMap map, SlotMapHandle handle);
+
+// replaces the element of a live handle, returns LCOMMON_FALSE if the handle is stale.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_slotmap_set(SlotMap map, SlotMapHandle handle, void *element);
+
+// removes the element of a handle in O(1) and returns it in an Optional, None if the handle
+// is stale. The element itself isn't freed.
+_LIBCOMMON_EXPORT Optional Common_slotmap_remove(SlotMap map, SlotMapHandle handle);
+
+// returns the handle of `elements[N]`, e.g. while iterating with `Common_foreach()`.
+_LIBCOMMON_EXPORT SlotMapHandle Common_slotmap_handle_at(const SlotMap map, size_t n);
+
+// removes every element but not the elements themselves, every handle becomes stale.
+_LIBCOMMON_EXPORT void Common_slotmap_clear(SlotMap map);
+
+// frees a slot map but not the elements.
+_LIBCOMMON_EXPORT void Common_slotmap_destroy(SlotMap map);
+
+// frees a slot map and every element still inside.
+_LIBCOMMON_EXPORT void Common_slotmap_free(SlotMap map);
+
+// approximate membership filters
+//
+// cheap "definitely not present" checks for strings before doing an expensive lookup, both
+// filters may answer LCOMMON_TRUE for strings which were never added (false positives) but
+// never LCOMMON_FALSE for one that was.
+
+// split block Bloom filter: every string sets 8 bits inside a single 256-bit block so a
+// query costs one cache miss, the 8 bits are computed and tested at once with AVX2 when
+// the cpu supports it.
+typedef struct bloom_filter_t *BloomFilter;
+
+// static set filter (xor8) built once from every string, smaller than a Bloom filter for
+// the same false positive rate (~0.4%) and also answers with one pass over 3 bytes.
+typedef struct xor_filter_t *XorFilter;
+
+// creates an empty Bloom filter sized for `expected_len` strings with a false positive rate
+// around `false_positive_rate` (e.g. 0.01).
+_LIBCOMMON_EXPORT BloomFilter Common_bloom_filter_init(size_t expected_len, double false_positive_rate);
+
+// frees a Bloom filter.
+_LIBCOMMON_EXPORT void Common_bloom_filter_destroy(BloomFilter filter);
+
+// adds a NUL terminated string to the filter.
+_LIBCOMMON_EXPORT void Common_bloom_filter_add(BloomFilter filter, const char *s);
+
+// checks if a string may have been added, LCOMMON_FALSE means it definitely wasn't.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_bloom_filter_may_contain(const BloomFilter filter, const char *s);
+
+// adds every string of a DynamicArray<char*>, the blocks of a whole group of strings are
+// prefetched before touching any of them.
+_LIBCOMMON_EXPORT void Common_bloom_filter_add_array(BloomFilter filter, const DynamicArray strings);
+
+// checks every string of a DynamicArray<char*> like `Common_bloom_filter_may_contain()`,
+// stores each answer in `results[N]` (when not NULL) and returns how many may be present.
+_LIBCOMMON_EXPORT size_t Common_bloom_filter_may_contain_array(
+    const BloomFilter filter,
+    const DynamicArray strings,
+    LCOMMON_BOOL *results
+);
+
+// returns the size in bytes of the filter's bit blocks.
+_LIBCOMMON_EXPORT size_t Common_bloom_filter_size(const BloomFilter filter);
+
+// serializes the filter into an allocated byte buffer of `*len` bytes, the caller is
+// responsible for freeing it with LCOMMON_FREE().
+_LIBCOMMON_EXPORT void *Common_bloom_filter_serialize(const BloomFilter filter, size_t *len);
+
+// rebuilds a filter from `Common_bloom_filter_serialize()`'s output, returns an
+// Optional<BloomFilter> which is none if the bytes aren't a valid filter.
+_LIBCOMMON_EXPORT Optional Common_bloom_filter_deserialize(const void *data, size_t len);
+
+// builds a xor filter out of every string of a DynamicArray<char*> (duplicates allowed),
+// nothing can be added afterwards.
+_LIBCOMMON_EXPORT XorFilter Common_xor_filter_build(const DynamicArray strings);
+
+// frees a xor filter.
+_LIBCOMMON_EXPORT void Common_xor_filter_destroy(XorFilter filter);
+
+// checks if a string may be part of the set the filter was built from.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_xor_filter_may_contain(const XorFilter filter, const char *s);
+
+// returns the size in bytes of the filter's fingerprints.
+_LIBCOMMON_EXPORT size_t Common_xor_filter_size(const XorFilter filter);
+
+// ordered maps (B+-trees)
+
+// ordered map from integer or string keys to pointers. Nodes hold 32 keys whose first 8
+// bytes (or the integer itself) are stored together, so searching a node mostly scans a
+// few cache lines without dereferencing strings. Leaves are chained for range scans.
+// String keys aren't copied, they must stay valid until their entry is removed, replaced
+// by another insert of the same key or the tree is destroyed.
+typedef struct btree_t *BTree;
+
+// position inside a tree, see `Common_btree_range_int()`. After `Common_btree_next()`
+// returns LCOMMON_TRUE, `key` (integer trees) or `key_str` (string trees) and `value` hold
+// the current entry. Modifying the tree invalidates every iterator.
+typedef struct btree_iterator_t {
+    void *leaf;
+    unsigned index;
+    LCOMMON_BOOL string_keys;
+    LCOMMON_BOOL bounded;
+    unsigned long long end_prefix;
+    const char *end_str;
+    long long key;
+    const char *key_str;
+    void *value;
+} BTreeIterator;
+
+// creates an empty tree with integer keys.
+_LIBCOMMON_EXPORT BTree Common_btree_init_int(void);
+
+// creates an empty tree with NUL terminated string keys, ordered like strcmp().
+_LIBCOMMON_EXPORT BTree Common_btree_init_str(void);
+
+// builds an integer tree out of `values->len` entries whose keys are `keys[N]`, which must
+// be strictly increasing. Leaves are filled and linked in one pass, in O(n).
+_LIBCOMMON_EXPORT BTree Common_btree_from_sorted_int(const long long *keys, const DynamicArray values);
+
+// builds a string tree out of a sorted DynamicArray<char*> of distinct keys, `values[N]` is
+// the value of `keys[N]` (when `values` is NULL every key is its own value).
+_LIBCOMMON_EXPORT BTree Common_btree_from_sorted_str(const DynamicArray keys, const DynamicArray values);
+
+// frees a tree but not the values.
+_LIBCOMMON_EXPORT void Common_btree_destroy(BTree tree);
+
+// frees a tree and every value still inside.
+_LIBCOMMON_EXPORT void Common_btree_free(BTree tree);
+
+// returns the amount of entries in the tree.
+_LIBCOMMON_EXPORT size_t Common_btree_len(const BTree tree);
+
+// inserts or replaces the value of a key, returns an Optional with the replaced value
+// (None if the key is new).
+_LIBCOMMON_EXPORT Optional Common_btree_insert_int(BTree tree, long long key, void *value);
+_LIBCOMMON_EXPORT Optional Common_btree_insert_str(BTree tree, const char *key, void *value);
+
+// returns an Optional with the value of a key, None if it isn't in the tree.
+_LIBCOMMON_EXPORT Optional Common_btree_get_int(const BTree tree, long long key);
+_LIBCOMMON_EXPORT Optional Common_btree_get_str(const BTree tree, const char *key);
+
+// removes a key and returns an Optional with its value, None if it wasn't in the tree.
+_LIBCOMMON_EXPORT Optional Common_btree_remove_int(BTree tree, long long key);
+_LIBCOMMON_EXPORT Optional Common_btree_remove_str(BTree tree, const char *key);
+
+// iterates over every entry in key order.
+_LIBCOMMON_EXPORT BTreeIterator Common_btree_iter(const BTree tree);
+
+// iterates over the entries whose key is in [from, to) in key order.
+_LIBCOMMON_EXPORT BTreeIterator Common_btree_range_int(const BTree tree, long long from, long long to);
+
+// same as `Common_btree_range_int()` for string trees, a NULL bound means unbounded.
+_LIBCOMMON_EXPORT BTreeIterator Common_btree_range_str(const BTree tree, const char *from, const char *to);
+
+// moves to the next entry, returns LCOMMON_FALSE once the iteration is over.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_btree_next(BTreeIterator *iterator);
+
+// lock-free queues
+
+// bounded multi-producer multi-consumer ring (Vyukov's design): every slot has its own
+// sequence number on its own cache line, so producers and consumers only contend on the
+// position counters. The capacity is rounded up to a power of two.
+typedef struct mpmc_queue_t *MpmcQueue;
+
+// bounded ring for exactly one producer thread and one consumer thread, cheaper than
+// MpmcQueue since neither side needs atomic read-modify-write operations.
+typedef struct spsc_queue_t *SpscQueue;
+
+// creates a queue holding up to `capacity` elements (rounded up to a power of two).
+_LIBCOMMON_EXPORT MpmcQueue Common_mpmc_queue_init(size_t capacity);
+
+// frees a queue but not the elements still inside, no thread may be using it.
+_LIBCOMMON_EXPORT void Common_mpmc_queue_destroy(MpmcQueue queue);
+
+// returns the capacity of the queue.
+_LIBCOMMON_EXPORT size_t Common_mpmc_queue_capacity(const MpmcQueue queue);
+
+// pushes an element without blocking, returns LCOMMON_FALSE if the queue is full.
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_mpmc_queue_push(MpmcQueue queue, void *element);
+
+// pops an element without blocking, returns an Optional which is none if the queue is empty.
+_LIBCOMMON_EXPORT Optional Common_mpmc_queue_pop(MpmcQueue queue);
+
+// pushes up to `n` elements in order claiming their slots at once, returns how many were
+// pushed (less than `n` when the queue fills up).
+_LIBCOMMON_EXPORT size_t Common_mpmc_queue_push_batch(MpmcQueue queue, void **elements, size_t n);
+
+// pops up to `n` elements into `out` claiming their slots at once, returns how many.
+_LIBCOMMON_EXPORT size_t Common_mpmc_queue_pop_batch(MpmcQueue queue, void **out, size_t n);
+
+// pushes an element, sleeping (on a futex where available) while the queue is full.
+_LIBCOMMON_EXPORT void Common_mpmc_queue_push_wait(MpmcQueue queue, void *element);
+
+// pops an element, sleeping while the queue is empty.
+_LIBCOMMON_EXPORT void *Common_mpmc_queue_pop_wait(MpmcQueue queue);
+
+// same as the `Common_mpmc_queue_*()` functions, for one producer and one consumer.
+_LIBCOMMON_EXPORT SpscQueue Common_spsc_queue_init(size_t capacity);
+_LIBCOMMON_EXPORT void Common_spsc_queue_destroy(SpscQueue queue);
+_LIBCOMMON_EXPORT size_t Common_spsc_queue_capacity(const SpscQueue queue);
+_LIBCOMMON_EXPORT LCOMMON_BOOL Common_spsc_queue_push(SpscQueue queue, void *element);
+_LIBCOMMON_EXPORT Optional Common_spsc_queue_pop(SpscQueue queue);
+_LIBCOMMON_EXPORT size_t Common_spsc_queue_push_batch(SpscQueue queue, void **elements, size_t n);
+_LIBCOMMON_EXPORT size_t Common_spsc_queue_pop_batch(SpscQueue queue, void **out, size_t n);
+_LIBCOMMON_EXPORT void Common_spsc_queue_push_wait(SpscQueue queue, void *element);
+_LIBCOMMON_EXPORT void *Common_spsc_queue_pop_wait(SpscQueue queue);
+
+// string pools
+
+// stores strings end to end in big blocks instead of one allocation each, every string is
+// found through a compact offset index and keeps its address (and NUL terminator) for the
+// pool's whole life.
+typedef struct strpool_t *StrPool;
+
+// immutable sorted and deduplicated copy of a pool, front coded: strings are stored in
+// buckets of 16 where each one only keeps the bytes it doesn't share with the previous one.
+// Buckets start with a full string so any string is decoded from at most 16 entries.
+typedef struct frozen_strpool_t *FrozenStrPool;
+
+// creates an empty string pool.
+_LIBCOMMON_EXPORT StrPool Common_strpool_init(void);
+
+// frees a pool and every string in it, pointers obtained from it become invalid.
+_LIBCOMMON_EXPORT void Common_strpool_destroy(StrPool pool);
+
+// copies a NUL terminated string into the pool and returns its index.
+_LIBCOMMON_EXPORT size_t Common_strpool_add(StrPool pool, const char *s);
+
+// copies `len` bytes into the pool as a NUL terminated string and returns its index.
+_LIBCOMMON_EXPORT size_t Common_strpool_add_n(StrPool pool, const char *s, size_t len);
+
+// copies every string of a DynamicArray<char*> into the pool.
+_LIBCOMMON_EXPORT void Common_strpool_add_array(StrPool pool, const DynamicArray strings);
+
+// returns the amount of strings in the pool.
+_LIBCOMMON_EXPORT size_t Common_strpool_len(const StrPool pool);
+
+// returns the N string of the pool.
+_LIBCOMMON_EXPORT const char *Common_strpool_get(const StrPool pool, size_t index);
+
+// returns how many bytes the pool takes (blocks and index).
+_LIBCOMMON_EXPORT size_t Common_strpool_size(const StrPool pool);
+
+// creates a DynamicArray<char*> pointing into the pool, so it can be given to any function
+// taking strings arrays. Release it with `Common_dynamic_array_destroy()` (never free the
+// elements) before destroying the pool.
+_LIBCOMMON_EXPORT DynamicArray Common_strpool_to_array(const StrPool pool);
+
+// builds the sorted front coded form of a pool, the pool itself is left untouched.
+_LIBCOMMON_EXPORT FrozenStrPool Common_strpool_freeze(const StrPool pool);
+
+// frees a frozen pool.
+_LIBCOMMON_EXPORT void Common_frozen_strpool_destroy(FrozenStrPool frozen);
+
+// returns the amount of (distinct) strings in a frozen pool.
+_LIBCOMMON_EXPORT size_t Common_frozen_strpool_len(const FrozenStrPool frozen);
+
+// returns how many bytes the frozen pool takes.
+_LIBCOMMON_EXPORT size_t Common_frozen_strpool_size(const FrozenStrPool frozen);
+
+// decodes the N string (in sorted order) into `out`, which is cleared first.
+_LIBCOMMON_EXPORT void Common_frozen_strpool_get(const FrozenStrPool frozen, size_t index, StringBuilder out);
+
+// looks a string up, returns its index in sorted order or none if it isn't in the pool.
+_LIBCOMMON_EXPORT Common_optional_of(size_t) Common_frozen_strpool_find(const FrozenStrPool frozen, const char *s);
+
 // defer macro-based implementation
 // thanks to https://gist.github.com/baruch/f005ce51e9c5bd5c1897ab24ea1ecf3b
 #ifdef LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
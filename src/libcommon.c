@@ -1,8 +1,54 @@
+#define _GNU_SOURCE
+
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <locale.h>
+#include <wchar.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+
+#ifdef LIBCOMMON_ENABLE_TRACING
+#include <time.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include) && !defined(LIBCOMMON_DISABLE_IO_URING)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#define LCOMMON_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifndef LCOMMON_HAVE_IO_URING
+#define LCOMMON_HAVE_IO_URING 0
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#define LCOMMON_HAVE_FUTEX 1
+#else
+#include <sched.h>
+#define LCOMMON_HAVE_FUTEX 0
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(LIBCOMMON_DISABLE_SIMD)
+#include <immintrin.h>
+#define LCOMMON_HAVE_X86_SIMD 1
+#else
+#define LCOMMON_HAVE_X86_SIMD 0
+#endif
 
 #define WITH_LIBCOMMON_DEFINITIONS
 #define LIBCOMMON_ENABLE_EXPERIMENTAL_DEFER
@@ -13,388 +59,7993 @@ static inline void die(const char *prefix) {
     exit(1);
 }
 
-void *Common_smalloc(size_t len) {
-    void *ptr;
-    if (!(ptr = malloc(len)))
-        die("malloc");
+// tracing
 
-    return ptr;
-}
+// ids of the events emitted by libcommon itself, user events are registered after them.
+enum trace_builtin_event_t {
+    TRACE_DYNAMIC_ARRAY_GROW = 1,
+    TRACE_OPTIONAL_ARRAY_GROW,
+    TRACE_STRMERGE,
+    TRACE_SREALLOC,
+    TRACE_THREAD_CACHE_REFILL,
+    TRACE_BUILTIN_EVENTS,
+};
 
-void *Common_srealloc(void *ptr, size_t len) {
-    void *ret;
-    if (!(ret = realloc(ptr, len)))
-        die("realloc");
+#ifdef LIBCOMMON_ENABLE_TRACING
+#define TRACE_RING_SIZE 16384
+#define TRACE_MAX_EVENTS 256
 
-    return ret;
-}
+struct trace_record_t {
+    unsigned long long timestamp;
+    unsigned long long arg;
+    unsigned short id;
+    char phase;
+    int tid;
+};
 
-int Common_is_true(int n) {
-    return n == LCOMMON_TRUE;
-}
+// written only by its thread, `head` counts every event ever recorded so the dump knows
+// which part of the ring is still valid. Rings outlive their threads so they can be dumped,
+// an exiting thread retires its ring and the next thread to record an event continues it:
+// there are never more rings than threads recording at once.
+struct trace_ring_t {
+    struct trace_ring_t *next;
+    struct trace_ring_t *next_retired;
+    size_t head;
+    struct trace_record_t records[TRACE_RING_SIZE];
+};
 
-int Common_is_false(int n) {
-    return n == LCOMMON_FALSE;
-}
+int __private__Common_trace_active = 0;
 
-DynamicArray Common_dynamic_array_init(void) {
-    DynamicArray ret = Common_smalloc(sizeof(struct dynamic_array_t));
+static const char *trace_names[TRACE_MAX_EVENTS] = {
+    [TRACE_DYNAMIC_ARRAY_GROW] = "dynamic_array_grow",
+    [TRACE_OPTIONAL_ARRAY_GROW] = "optional_array_grow",
+    [TRACE_STRMERGE] = "strmerge",
+    [TRACE_SREALLOC] = "srealloc",
+    [TRACE_THREAD_CACHE_REFILL] = "thread_cache_refill",
+};
 
-    ret->cap = 10;
-    ret->len = 0;
-    ret->elements = Common_smalloc(sizeof(void*) * ret->cap);
+static unsigned int trace_names_len = TRACE_BUILTIN_EVENTS;
+static pthread_mutex_t trace_names_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_ring_t *trace_rings = NULL;
+static struct trace_ring_t *trace_retired_rings = NULL;
+static pthread_mutex_t trace_retired_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t trace_ring_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_ring_key;
+static __thread struct trace_ring_t *trace_ring = NULL;
+static __thread int trace_tid = 0;
+static unsigned long long trace_origin_timestamp = 0;
+static struct timespec trace_origin_time;
 
-    return ret;
+static inline unsigned long long trace_timestamp(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ull + (unsigned long long) now.tv_nsec;
+#endif
 }
 
-void Common_dynamic_array_append(DynamicArray array, void *element) {
-    array->elements[array->len++] = element;
-    if (array->len >= array->cap) {
-        array->cap *= 2;
-        array->elements = Common_srealloc(array->elements, sizeof(void*) * array->cap);
-    }
+// runs when a thread which recorded events exits.
+static void trace_ring_retire(void *arg) {
+    struct trace_ring_t *ring = arg;
+
+    // events recorded by later destructors get a ring of their own.
+    trace_ring = NULL;
+
+    pthread_mutex_lock(&trace_retired_lock);
+    ring->next_retired = trace_retired_rings;
+    trace_retired_rings = ring;
+    pthread_mutex_unlock(&trace_retired_lock);
 }
 
-void Common_dynamic_array_destroy(DynamicArray array) {
-    LCOMMON_FREE(array->elements);
-    LCOMMON_FREE(array);
+static void trace_ring_setup(void) {
+    pthread_key_create(&trace_ring_key, trace_ring_retire);
 }
 
-void Common_dynamic_array_free(DynamicArray array) {
-    for (size_t i = 0; i < array->len; ++i) {
-        LCOMMON_FREE(array->elements[i]);
+static struct trace_ring_t *trace_ring_acquire(void) {
+    pthread_once(&trace_ring_once, trace_ring_setup);
+
+    pthread_mutex_lock(&trace_retired_lock);
+    struct trace_ring_t *ring = trace_retired_rings;
+    if (ring != NULL) {
+        trace_retired_rings = ring->next_retired;
     }
-    
-    Common_dynamic_array_destroy(array);
-}
+    pthread_mutex_unlock(&trace_retired_lock);
 
-Optional Common_optional_with(void *data) {
-    return (Optional) {
-        .data = data,
-        .is_none = LCOMMON_FALSE
-    };
-}
+    if (ring == NULL) {
+        ring = Common_smalloc(sizeof(struct trace_ring_t));
+        ring->head = 0;
+        ring->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
 
-Optional *Common_optional_alloc_with(void *data) {
-    Optional *opt = Common_smalloc(sizeof(struct optional_t));
+        while (!__atomic_compare_exchange_n(&trace_rings, &ring->next, ring, LCOMMON_TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
 
-    memcpy(
-        (void*) opt,
-        (const void*) &(struct optional_t) {data, LCOMMON_FALSE},
-        sizeof(struct optional_t)
-    );
+    trace_tid = (int) syscall(SYS_gettid);
+    pthread_setspecific(trace_ring_key, ring);
 
-    return opt;
+    return ring;
 }
 
-Optional Common_optional_none(void) {
-    return (Optional) {
-        .data = NULL,
-        .is_none = LCOMMON_TRUE
-    };
+static void trace_emit(unsigned int id, char phase, unsigned long long arg) {
+    struct trace_ring_t *ring = trace_ring;
+    if (__builtin_expect(ring == NULL, 0)) {
+        ring = trace_ring = trace_ring_acquire();
+    }
+
+    struct trace_record_t *record = &ring->records[ring->head & (TRACE_RING_SIZE - 1)];
+    record->timestamp = trace_timestamp();
+    record->arg = arg;
+    record->id = (unsigned short) id;
+    record->phase = phase;
+    record->tid = trace_tid;
+
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
 }
 
-Optional *Common_optional_alloc_none(void) {
-    Optional *opt = Common_smalloc(sizeof(struct optional_t));
+#define TRACE_EMIT(id, phase, arg) \
+    do { \
+        if (__private__Common_trace_is_active()) { \
+            trace_emit((id), (phase), (arg)); \
+        } \
+    } while (0)
 
-    memcpy(
-        (void*) opt,
-        (const void*) &(struct optional_t) {NULL, LCOMMON_TRUE},
-        sizeof(struct optional_t)
-    );
+#else
+#define TRACE_EMIT(id, phase, arg) ((void) (id), (void) (arg))
+#endif
 
-    return opt;
+#define TRACE_INSTANT(id, arg) TRACE_EMIT(id, 'i', arg)
+#define TRACE_BEGIN(id, arg) TRACE_EMIT(id, 'B', arg)
+#define TRACE_END(id, arg) TRACE_EMIT(id, 'E', arg)
+
+void Common_trace_start(void) {
+#ifdef LIBCOMMON_ENABLE_TRACING
+    if (trace_origin_timestamp == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &trace_origin_time);
+        trace_origin_timestamp = trace_timestamp();
+    }
+
+    __atomic_store_n(&__private__Common_trace_active, LCOMMON_TRUE, __ATOMIC_RELEASE);
+#endif
 }
 
-Optional Common_optional_from(void *payload) {
-    return payload == NULL
-        ? Common_optional_none()
-        : Common_optional_with(payload);
+void Common_trace_stop(void) {
+#ifdef LIBCOMMON_ENABLE_TRACING
+    __atomic_store_n(&__private__Common_trace_active, LCOMMON_FALSE, __ATOMIC_RELEASE);
+#endif
 }
 
-Optional *Common_optional_alloc_from(void *payload) {
-    Optional *self = Common_dsmalloc(Optional);
-    Optional opt = Common_optional_from(payload);
+unsigned int Common_trace_event(const char *name) {
+#ifdef LIBCOMMON_ENABLE_TRACING
+    unsigned int id = 0;
 
-    memcpy(
-        (void*) self,
-        (const void*) &opt,
-        sizeof(Optional)
-    );
+    pthread_mutex_lock(&trace_names_lock);
 
-    memset((void*) &opt, 0, sizeof(struct optional_t));
+    for (unsigned int i = 1; i < trace_names_len; ++i) {
+        if (strcmp(trace_names[i], name) == 0) {
+            id = i;
+            break;
+        }
+    }
 
-    return self;
-}
+    if (id == 0 && trace_names_len < TRACE_MAX_EVENTS) {
+        id = trace_names_len;
+        trace_names[trace_names_len++] = name;
+    }
 
-int Common_optional_is_none(Optional *optional) {
-    return Common_is_true(optional->is_none);
-}
+    pthread_mutex_unlock(&trace_names_lock);
 
-int Common_optional_is_some(Optional *optional) {
-    return !Common_optional_is_none(optional);
+    return id;
+#else
+    (void) name;
+    return 0;
+#endif
 }
 
-void *Common_optional_unpack(Optional *optional) {
-    LCOMMON_ASSERT(Common_optional_is_some(optional), "given optional should've data");
-    return optional->data;
+void Common_trace_instant(unsigned int id, unsigned long long arg) {
+    if (id != 0) {
+        TRACE_INSTANT(id, arg);
+    }
 }
 
-void *Common_optional_unpack_default(Optional *optional, void *default_value) {
-    if (Common_optional_is_none(optional)) {
-        return default_value;
+void Common_trace_begin(unsigned int id, unsigned long long arg) {
+    if (id != 0) {
+        TRACE_BEGIN(id, arg);
     }
-
-    return optional->data;
 }
 
-void *Common_optional_to_raw(Optional *optional) {
-    return Common_optional_is_some(optional)
-        ? Common_optional_unpack(optional)
-        : NULL;
+void Common_trace_end(unsigned int id, unsigned long long arg) {
+    if (id != 0) {
+        TRACE_END(id, arg);
+    }
 }
 
-void Common_optional_set_data(Optional *optional, void *data) {
-    optional->data = data;
+#ifdef LIBCOMMON_ENABLE_TRACING
+TraceSpan __private__Common_trace_span_enter(unsigned int *id, const char *name) {
+    TraceSpan span;
 
-    if (Common_optional_is_none(optional)) {
-        optional->is_none = LCOMMON_FALSE;
+    span.id = __atomic_load_n(id, __ATOMIC_RELAXED);
+    if (span.id == 0) {
+        span.id = Common_trace_event(name);
+        __atomic_store_n(id, span.id, __ATOMIC_RELAXED);
     }
-}
 
-void Common_optional_set_none(Optional *optional) {
-    optional->is_none = LCOMMON_TRUE;
+    Common_trace_begin(span.id, 0);
+
+    return span;
 }
+#endif
 
-void Common_optional_free_data(Optional *optional) {
-    if (Common_optional_is_some(optional)) {
-        if (optional->data != NULL) {
-            LCOMMON_FREE(optional->data);
+#ifdef LIBCOMMON_ENABLE_TRACING
+// event names come from the user, so they are escaped to keep the JSON valid.
+static void trace_write_json_string(FILE *file, const char *s) {
+    fputc('"', file);
+
+    for (; *s != '\0'; ++s) {
+        unsigned char c = (unsigned char) *s;
+
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
         }
     }
+
+    fputc('"', file);
 }
+#endif
 
-void Common_optional_destroy(Optional *optional) {
-    if (Common_optional_is_some(optional)) {
-        Common_optional_set_none(optional);
+LCOMMON_BOOL Common_trace_dump(const char *path) {
+#ifdef LIBCOMMON_ENABLE_TRACING
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return LCOMMON_FALSE;
     }
 
-    LCOMMON_FREE(optional);
-}
+    // converts timestamp ticks into microseconds by comparing them against the clock.
+    double ticks_per_us = 1000.0;
+    if (trace_origin_timestamp != 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        unsigned long long ticks = trace_timestamp() - trace_origin_timestamp;
+        double elapsed_us = (double) (now.tv_sec - trace_origin_time.tv_sec) * 1e6
+            + (double) (now.tv_nsec - trace_origin_time.tv_nsec) / 1e3;
 
-void Common_optional_free(Optional *optional) {
-    Common_optional_free_data(optional);
-    Common_optional_destroy(optional);
-}
+        if (elapsed_us > 0 && ticks > 0) {
+            ticks_per_us = (double) ticks / elapsed_us;
+        }
+    }
 
-OptionalArray Common_optional_array_init(void) {
-    OptionalArray ret = Common_smalloc(sizeof(struct optional_array_t));
+    long pid = (long) getpid();
+    LCOMMON_BOOL first = LCOMMON_TRUE;
 
-    ret->cap = 10;
-    ret->len = 0;
-    ret->elements = Common_smalloc(sizeof(struct optional_t*) * ret->cap);
+    fputs("{\"traceEvents\":[", file);
 
-    return ret;
-}
+    struct trace_ring_t *ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        size_t start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
 
-void Common_optional_array_set_data_at(
-    OptionalArray array,
-    const unsigned int n,
-    void *data
-) {
-    Common_foreach(array, Optional, cur, {
-        if (i == n) {
-            Common_optional_set_data(cur, data);
-            break;
-        }
-    });
-}
+        for (size_t i = start; i < head; ++i) {
+            const struct trace_record_t *record = &ring->records[i & (TRACE_RING_SIZE - 1)];
+            if (record->timestamp < trace_origin_timestamp || record->id >= trace_names_len) {
+                continue;
+            }
 
-void Common_optional_array_set_none_at(OptionalArray array, const unsigned int n) {
-    Common_foreach(array, Optional, cur, {
-        if (i == n) {
-            Common_optional_set_none(cur);
-            break;
-        }
-    });
-}
+            double ts = (double) (record->timestamp - trace_origin_timestamp) / ticks_per_us;
 
-void Common_optional_array_free_data_at(OptionalArray array, const unsigned int n) {
-    Common_foreach(array, Optional, cur, {
-        if (i == n) {
-            Common_optional_free_data(cur);
-            Common_optional_set_none(cur);
-            break;
+            fputs(first ? "\n{\"name\":" : ",\n{\"name\":", file);
+            trace_write_json_string(file, trace_names[record->id]);
+            fprintf(file, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%ld,\"tid\":%d,\"args\":{\"arg\":%llu}%s}",
+                    record->phase, ts, pid, record->tid,
+                    record->arg, record->phase == 'i' ? ",\"s\":\"t\"" : "");
+            first = LCOMMON_FALSE;
         }
-    });
-}
+    }
 
-void Common_optional_array_destroy(OptionalArray array) {
-    Common_foreach(array, Optional, cur, {
-        Common_optional_destroy(cur);
-    });
+    fputs("\n],\"displayTimeUnit\":\"ns\"}\n", file);
 
-    LCOMMON_FREE(array->elements);
-    LCOMMON_FREE(array);
+    return fclose(file) == 0;
+#else
+    (void) path;
+    return LCOMMON_FALSE;
+#endif
 }
 
-void Common_optional_array_free(OptionalArray array) {
-    for (size_t i = 0; i < array->len; ++i) {
-        Optional *opt_value = array->elements[i];
-        LCOMMON_ASSERT(opt_value, "must be able to obtain elements from OptionalArray");
-        Common_optional_free(opt_value);
+#ifdef LIBCOMMON_ENABLE_THREAD_CACHE
+// Thread-local caching front-end for small allocations. Blocks up to
+// THREAD_CACHE_MAX_SIZE bytes are carved out of slabs living in a single reserved
+// address range, so telling a cached block from a malloc() one is a range check
+// and the size class of a block comes from a per-slab side table (no headers).
+// Every thread keeps a free list per class and exchanges batches of blocks with
+// a shared, mutex protected depot only when its list runs empty or grows too long.
+#define THREAD_CACHE_CLASSES 12
+#define THREAD_CACHE_MAX_SIZE 256
+#define THREAD_CACHE_BATCH 32
+#define THREAD_CACHE_HIGH_WATER (THREAD_CACHE_BATCH * 2)
+#define THREAD_CACHE_SLAB_SHIFT 16
+#define THREAD_CACHE_SLAB_SIZE ((size_t) 1 << THREAD_CACHE_SLAB_SHIFT)
+#define THREAD_CACHE_ARENA_SIZE ((size_t) 1 << (sizeof(void*) >= 8 ? 32 : 28))
+#define THREAD_CACHE_SLABS (THREAD_CACHE_ARENA_SIZE >> THREAD_CACHE_SLAB_SHIFT)
+
+static const uint16_t thread_cache_class_size[THREAD_CACHE_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+};
+
+struct thread_cache_block_t {
+    struct thread_cache_block_t *next;
+};
+
+struct thread_cache_depot_t {
+    pthread_mutex_t lock;
+    struct thread_cache_block_t *head;
+    char *bump;
+    char *bump_end;
+};
+
+struct thread_cache_t {
+    struct thread_cache_block_t *heads[THREAD_CACHE_CLASSES];
+    uint32_t counts[THREAD_CACHE_CLASSES];
+    LCOMMON_BOOL registered;
+};
+
+static pthread_once_t thread_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_cache_key;
+static char *thread_cache_arena = NULL;
+static size_t thread_cache_next_slab = 0;
+static uint8_t thread_cache_slab_class[THREAD_CACHE_SLABS];
+static struct thread_cache_depot_t thread_cache_depots[THREAD_CACHE_CLASSES];
+static __thread struct thread_cache_t thread_cache;
+
+static void thread_cache_release(void *unused);
+
+static void thread_cache_setup(void) {
+    for (size_t i = 0; i < THREAD_CACHE_CLASSES; ++i) {
+        pthread_mutex_init(&thread_cache_depots[i].lock, NULL);
     }
 
-    Common_optional_array_destroy(array);
-}
+    if (pthread_key_create(&thread_cache_key, thread_cache_release) != 0) {
+        return;
+    }
 
-void Common_optional_array_append(OptionalArray array, Optional *optional) {
-    array->elements[array->len++] = optional;
-    if (array->len >= array->cap) {
-        array->cap *= 2;
-        array->elements = Common_srealloc(array->elements, sizeof(struct optional_t*) * array->cap);
+    // only address space is reserved here, slabs become accessible one at a time.
+    void *arena = mmap(NULL, THREAD_CACHE_ARENA_SIZE, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (arena != MAP_FAILED) {
+        __atomic_store_n(&thread_cache_arena, (char*) arena, __ATOMIC_RELEASE);
     }
 }
 
-LCOMMON_BOOL Common_streql(const char *a, const char *b) {
-    LCOMMON_BOOL ret = LCOMMON_TRUE;
-    for (int i = 0; a[i] != '\0'; ++i) {
-        if (a[i] != b[i]) {
-            ret = LCOMMON_FALSE;
-            break;
-        }
+static inline LCOMMON_BOOL thread_cache_owns(const void *ptr) {
+    const char *arena = __atomic_load_n(&thread_cache_arena, __ATOMIC_ACQUIRE);
+    return arena != NULL
+        && (const char*) ptr >= arena
+        && (size_t) ((const char*) ptr - arena) < THREAD_CACHE_ARENA_SIZE;
+}
+
+static inline size_t thread_cache_class_of_size(size_t len) {
+    if (len <= 128) {
+        return len == 0 ? 0 : (len - 1) >> 4;
     }
 
-    return ret;
+    return 8 + ((len - 129) >> 5);
 }
 
-size_t Common_strcount(const char *s) {
-    int i = 0;
-    for (; s[i] != '\0'; ++i);
-    return i;
+static inline size_t thread_cache_class_of_block(const void *ptr) {
+    return thread_cache_slab_class[((const char*) ptr - thread_cache_arena) >> THREAD_CACHE_SLAB_SHIFT];
 }
 
-#define STRMERGE_CHUNK_SIZE 124
+// hands the blocks in [head, tail] back to the shared depot of `class`.
+static void thread_cache_depot_push(size_t class, struct thread_cache_block_t *head, struct thread_cache_block_t *tail) {
+    struct thread_cache_depot_t *depot = &thread_cache_depots[class];
 
-char *__private__Common_strmerge(const char *separator, const char *first, ...) {
-    va_list vsprint;
-    va_start(vsprint, first);
-    defer({ va_end(vsprint); });
+    pthread_mutex_lock(&depot->lock);
+    tail->next = depot->head;
+    depot->head = head;
+    pthread_mutex_unlock(&depot->lock);
+}
 
-    size_t cap = STRMERGE_CHUNK_SIZE;
-    char *result = Common_smalloc(cap);
+// moves up to a batch of blocks from the depot into the calling thread's list,
+// carving fresh slabs when the depot is empty. Returns LCOMMON_FALSE when no block
+// could be found, once the arena is exhausted or a slab couldn't be made writable.
+static LCOMMON_BOOL thread_cache_refill(size_t class) {
+    struct thread_cache_depot_t *depot = &thread_cache_depots[class];
+    const size_t size = thread_cache_class_size[class];
+    struct thread_cache_block_t *head = NULL;
+    uint32_t count = 0;
 
-    memcpy(result, (const void*) first, strlen(first) + 1);
-    strcat(result, separator);
+    TRACE_INSTANT(TRACE_THREAD_CACHE_REFILL, size);
 
-    char *cur;
+    pthread_mutex_lock(&depot->lock);
 
-    int j = -1;
-    int i = j + 1;
+    while (count < THREAD_CACHE_BATCH && depot->head != NULL) {
+        struct thread_cache_block_t *block = depot->head;
+        depot->head = block->next;
+        block->next = head;
+        head = block;
+        count++;
+    }
 
-    for (; (cur = va_arg(vsprint, char*)) != LCOMMON_TERMINATOR; ++i, ++j) {
-        size_t counter = 0;
-        counter += Common_strcount(result) + 1;
-        counter += Common_strcount(cur) + 1;
+    while (count < THREAD_CACHE_BATCH) {
+        if (depot->bump == NULL || (size_t) (depot->bump_end - depot->bump) < size) {
+            size_t slab = __atomic_fetch_add(&thread_cache_next_slab, 1, __ATOMIC_RELAXED);
+            if (slab >= THREAD_CACHE_SLABS) {
+                break;
+            }
 
-        if (i > 1) {
-            counter += Common_strcount(separator) + 1;
-        }
+            // a slab which can't be committed (ENOMEM under overcommit limits) stays
+            // reserved, the allocation falls back to malloc when nothing was carved.
+            char *start = thread_cache_arena + (slab << THREAD_CACHE_SLAB_SHIFT);
+            if (mprotect(start, THREAD_CACHE_SLAB_SIZE, PROT_READ | PROT_WRITE) != 0) {
+                break;
+            }
 
-        if (counter >= cap) {
-            cap += STRMERGE_CHUNK_SIZE;
-            result = Common_srealloc(result, cap);
+            thread_cache_slab_class[slab] = (uint8_t) class;
+            depot->bump = start;
+            depot->bump_end = start + THREAD_CACHE_SLAB_SIZE;
         }
 
-        strcat(result, cur);
-        strcat(result, separator);
+        struct thread_cache_block_t *block = (struct thread_cache_block_t*) depot->bump;
+        depot->bump += size;
+        block->next = head;
+        head = block;
+        count++;
     }
 
-    char first_with_sep[Common_strcount(first) + Common_strcount(separator) + 1];
-    sprintf(first_with_sep, "%s%s", first, separator);
+    pthread_mutex_unlock(&depot->lock);
 
-    // removing seps when there's actually va args that have been iterated at
-    // and removing it if the result is just the first one + an uneeded sep.
-    if (j >= 0 || Common_streql(result, first_with_sep)) {
-        result[strlen(result) - strlen(separator)] = '\0';
-    }
-
-    // using the right amount of memory.
-    result = Common_srealloc(result, strlen(result) + 1);
+    thread_cache.heads[class] = head;
+    thread_cache.counts[class] = count;
 
-    return result;
+    return count > 0;
 }
 
-char *Common_strmerge_from_array(
-    const char *separator,
-    const DynamicArray dynamic_array
-) {
-    size_t cap = STRMERGE_CHUNK_SIZE;
-    char *result = Common_smalloc(cap);
-    memcpy((void*) result, (const void*) (char*) "", 1);
+// gives back every cached block of the calling thread, also used as the
+// destructor of `thread_cache_key` so exiting threads do not strand memory.
+static void thread_cache_release(void *unused) {
+    (void) unused;
 
-    Common_foreach(dynamic_array, char, element, {
-        size_t counter = strlen(result) + strlen(element) + 1;
-        LCOMMON_BOOL gonna_add_sep = i < dynamic_array->len - 1;
-
-        if (gonna_add_sep == LCOMMON_TRUE) {
-            counter += strlen(separator) + 1;
+    for (size_t class = 0; class < THREAD_CACHE_CLASSES; ++class) {
+        struct thread_cache_block_t *head = thread_cache.heads[class];
+        if (head == NULL) {
+            continue;
         }
 
-        if (counter >= strlen(result)) {
-            cap += STRMERGE_CHUNK_SIZE;
-            result = Common_srealloc(result, cap);
+        struct thread_cache_block_t *tail = head;
+        while (tail->next != NULL) {
+            tail = tail->next;
         }
 
-        strcat(result, element);
-
-        if (gonna_add_sep) {
-            strcat(result, separator);
-        }
-    });
+        thread_cache_depot_push(class, head, tail);
+        thread_cache.heads[class] = NULL;
+        thread_cache.counts[class] = 0;
+    }
 
-    // using the right memory amount
-    result = Common_srealloc(result, strlen(result) + 1);
+    // allocations made by later destructors register the thread again.
+    thread_cache.registered = LCOMMON_FALSE;
+}
 
-    return result;
+// makes sure `thread_cache_release()` runs when the calling thread exits.
+static inline void thread_cache_register(void) {
+    pthread_setspecific(thread_cache_key, &thread_cache);
+    thread_cache.registered = LCOMMON_TRUE;
 }
 
-char *Common_strmerge_from_optional_array(
-    const char *separator,
-    const OptionalArray optional_array
-) {
-    size_t cap = STRMERGE_CHUNK_SIZE;
-    char *result = Common_smalloc(cap);
-    memcpy((void*) result, (const void*) (char*) "", 1);
+static void *thread_cache_alloc(size_t len) {
+    size_t class = thread_cache_class_of_size(len);
+    struct thread_cache_block_t *block = thread_cache.heads[class];
 
-    Common_foreach(optional_array, Optional, opt_element, {
-        if (Common_optional_is_none(opt_element)) {
-            continue;
+    if (__builtin_expect(block == NULL, 0)) {
+        if (!thread_cache.registered) {
+            pthread_once(&thread_cache_once, thread_cache_setup);
+            if (thread_cache_arena == NULL) {
+                return NULL;
+            }
+
+            thread_cache_register();
         }
 
-        char *element = Common_optional_unpack(opt_element);
+        if (!thread_cache_refill(class)) {
+            return NULL;
+        }
 
-        size_t counter = strlen(result) + strlen(element) + 1;
-        LCOMMON_BOOL gonna_add_sep = i < optional_array->len - 1;
+        block = thread_cache.heads[class];
+    }
 
-        if (gonna_add_sep == LCOMMON_TRUE) {
-            counter += strlen(separator) + 1;
-        }
+    thread_cache.heads[class] = block->next;
+    thread_cache.counts[class]--;
 
-        if (counter >= strlen(result)) {
-            cap += STRMERGE_CHUNK_SIZE;
-            result = Common_srealloc(result, cap);
-        }
+    return block;
+}
 
-        strcat(result, element);
+static void thread_cache_free(void *ptr) {
+    size_t class = thread_cache_class_of_block(ptr);
+    struct thread_cache_block_t *block = ptr;
 
-        if (gonna_add_sep) {
-            strcat(result, separator);
-        }
-    });
+    if (__builtin_expect(!thread_cache.registered, 0)) {
+        thread_cache_register();
+    }
 
-    // using the right memory amount
-    result = Common_srealloc(result, strlen(result) + 1);
+    // blocks are not owned by the thread that carved them, so frees coming from
+    // other threads simply land in the local list.
+    block->next = thread_cache.heads[class];
+    thread_cache.heads[class] = block;
 
-    return result;
-}
\ No newline at end of file
+    if (__builtin_expect(++thread_cache.counts[class] <= THREAD_CACHE_HIGH_WATER, 1)) {
+        return;
+    }
+
+    // keep the most recently freed (warm) batch, send the older one to the depot.
+    struct thread_cache_block_t *keep_tail = block;
+    for (size_t i = 1; i < THREAD_CACHE_BATCH; ++i) {
+        keep_tail = keep_tail->next;
+    }
+
+    struct thread_cache_block_t *spill = keep_tail->next;
+    struct thread_cache_block_t *spill_tail = spill;
+    while (spill_tail->next != NULL) {
+        spill_tail = spill_tail->next;
+    }
+
+    keep_tail->next = NULL;
+    thread_cache.counts[class] = THREAD_CACHE_BATCH;
+
+    thread_cache_depot_push(class, spill, spill_tail);
+}
+#endif
+
+void *Common_smalloc(size_t len) {
+    void *ptr;
+
+#ifdef LIBCOMMON_ENABLE_THREAD_CACHE
+    if (len <= THREAD_CACHE_MAX_SIZE && (ptr = thread_cache_alloc(len)) != NULL)
+        return ptr;
+#endif
+
+    if (!(ptr = malloc(len)))
+        die("malloc");
+
+    return ptr;
+}
+
+void *Common_srealloc(void *ptr, size_t len) {
+    void *ret;
+
+    TRACE_INSTANT(TRACE_SREALLOC, len);
+
+#ifdef LIBCOMMON_ENABLE_THREAD_CACHE
+    if (ptr == NULL)
+        return Common_smalloc(len);
+
+    if (thread_cache_owns(ptr)) {
+        size_t size = thread_cache_class_size[thread_cache_class_of_block(ptr)];
+        if (len <= size)
+            return ptr;
+
+        ret = Common_smalloc(len);
+        memcpy(ret, ptr, size);
+        thread_cache_free(ptr);
+
+        return ret;
+    }
+#endif
+
+    if (!(ret = realloc(ptr, len)))
+        die("realloc");
+
+    return ret;
+}
+
+void Common_sfree(void *ptr) {
+#ifdef LIBCOMMON_ENABLE_THREAD_CACHE
+    if (thread_cache_owns(ptr)) {
+        thread_cache_free(ptr);
+        return;
+    }
+#endif
+
+    free(ptr);
+}
+
+void Common_thread_cache_flush(void) {
+#ifdef LIBCOMMON_ENABLE_THREAD_CACHE
+    thread_cache_release(NULL);
+#endif
+}
+
+#if LCOMMON_HAVE_X86_SIMD
+static inline LCOMMON_BOOL simd_has_avx2(void) {
+    static int has_avx2 = -1;
+
+    if (__builtin_expect(has_avx2 < 0, 0)) {
+        has_avx2 = __builtin_cpu_supports("avx2") ? LCOMMON_TRUE : LCOMMON_FALSE;
+    }
+
+    return has_avx2;
+}
+#endif
+
+int Common_is_true(int n) {
+    return n == LCOMMON_TRUE;
+}
+
+int Common_is_false(int n) {
+    return n == LCOMMON_FALSE;
+}
+
+#define DYNAMIC_ARRAY_INITIAL_CAP 10
+// past this many bytes of slots the elements live in their own anonymous mapping that
+// mremap grows in place, instead of a realloc that copies and needs both buffers at once.
+#define DYNAMIC_ARRAY_MAP_THRESHOLD (64UL << 20)
+#define DYNAMIC_ARRAY_HUGE_PAGE (2UL << 20)
+
+DynamicArray Common_dynamic_array_init(void) {
+    DynamicArray ret = Common_smalloc(sizeof(struct dynamic_array_t) + sizeof(void*) * DYNAMIC_ARRAY_INITIAL_CAP);
+
+    ret->cap = DYNAMIC_ARRAY_INITIAL_CAP;
+    ret->len = 0;
+    ret->elements = ret->storage;
+    ret->mapped = 0;
+
+    return ret;
+}
+
+// mappings are rounded to huge pages so the transparent huge page hint can apply to all of it.
+static size_t dynamic_array_map_size(size_t cap) {
+    LCOMMON_ASSERT(cap <= (SIZE_MAX - DYNAMIC_ARRAY_HUGE_PAGE) / sizeof(void*), "dynamic array capacity overflow");
+    return (sizeof(void*) * cap + DYNAMIC_ARRAY_HUGE_PAGE - 1) & ~(DYNAMIC_ARRAY_HUGE_PAGE - 1);
+}
+
+static void dynamic_array_map_advise(void *elements, size_t size) {
+#ifdef MADV_HUGEPAGE
+    // only a hint, kernels without transparent huge pages refuse it and nothing changes.
+    madvise(elements, size, MADV_HUGEPAGE);
+#else
+    (void) elements;
+    (void) size;
+#endif
+}
+
+// moves the elements to a fresh mapping of `size` bytes, the heap buffer is released.
+static void dynamic_array_map(DynamicArray array, size_t size) {
+    void **elements = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (elements == MAP_FAILED) {
+        die("mmap");
+    }
+
+    dynamic_array_map_advise(elements, size);
+    memcpy(elements, array->elements, sizeof(void*) * array->len);
+
+    if (array->elements != array->storage) {
+        LCOMMON_FREE(array->elements);
+    }
+
+    array->elements = elements;
+    array->mapped = size;
+}
+
+// moves the elements to a buffer of `cap` slots, leaving the inline storage the first time.
+static void dynamic_array_resize(DynamicArray array, size_t cap) {
+    TRACE_INSTANT(TRACE_DYNAMIC_ARRAY_GROW, cap);
+
+    if (array->mapped > 0) {
+        size_t size = dynamic_array_map_size(cap);
+
+        if (size > array->mapped) {
+            // the kernel moves page table entries rather than bytes, and most of the time
+            // it can simply extend the mapping where it is.
+            void **elements = mremap(array->elements, array->mapped, size, MREMAP_MAYMOVE);
+            if (elements == MAP_FAILED) {
+                die("mremap");
+            }
+
+            dynamic_array_map_advise(elements, size);
+            array->elements = elements;
+            array->mapped = size;
+        }
+
+        // the rounded up tail of the mapping is usable too.
+        array->cap = array->mapped / sizeof(void*);
+        return;
+    }
+
+    if (sizeof(void*) * cap >= DYNAMIC_ARRAY_MAP_THRESHOLD) {
+        dynamic_array_map(array, dynamic_array_map_size(cap));
+        array->cap = array->mapped / sizeof(void*);
+        return;
+    }
+
+    if (array->elements == array->storage) {
+        void **elements = Common_smalloc(sizeof(void*) * cap);
+        memcpy(elements, array->storage, sizeof(void*) * array->len);
+        array->elements = elements;
+    } else {
+        array->elements = Common_srealloc(array->elements, sizeof(void*) * cap);
+    }
+
+    array->cap = cap;
+}
+
+void Common_dynamic_array_append(DynamicArray array, void *element) {
+    array->elements[array->len++] = element;
+    if (array->len >= array->cap) {
+        dynamic_array_resize(array, array->cap * 2);
+    }
+}
+
+void Common_dynamic_array_reserve_virtual(DynamicArray array, size_t max_len) {
+    // one spare slot keeps the `len < cap` invariant once `max_len` elements are in.
+    size_t size = dynamic_array_map_size(max_len + 1);
+
+    if (size <= array->mapped) {
+        return;
+    }
+
+    if (array->mapped > 0) {
+        dynamic_array_resize(array, max_len + 1);
+        return;
+    }
+
+    dynamic_array_map(array, size);
+    array->cap = array->mapped / sizeof(void*);
+}
+
+// makes room for at least `len` elements while keeping the `len < cap` invariant
+// that `Common_dynamic_array_append()` relies on.
+static void dynamic_array_reserve(DynamicArray array, size_t len) {
+    if (len < array->cap) {
+        return;
+    }
+
+    dynamic_array_resize(array, len + 1);
+}
+
+void Common_dynamic_array_destroy(DynamicArray array) {
+    if (array->mapped > 0) {
+        munmap(array->elements, array->mapped);
+    } else if (array->elements != array->storage) {
+        LCOMMON_FREE(array->elements);
+    }
+
+    LCOMMON_FREE(array);
+}
+
+void Common_dynamic_array_free(DynamicArray array) {
+    for (size_t i = 0; i < array->len; ++i) {
+        LCOMMON_FREE(array->elements[i]);
+    }
+    
+    Common_dynamic_array_destroy(array);
+}
+
+SmallArray Common_small_array_init(void) {
+    SmallArray ret = Common_smalloc(sizeof(struct small_array_t));
+
+    ret->len = 0;
+    ret->cap = LCOMMON_SMALL_ARRAY_INLINE_CAP;
+    ret->elements = ret->inline_elements;
+
+    return ret;
+}
+
+void Common_small_array_append(SmallArray array, void *element) {
+    if (array->len == array->cap) {
+        LCOMMON_ASSERT(array->cap <= UINT32_MAX / 2, "small arrays can't hold more than 2^32 - 1 elements");
+
+        unsigned int cap = array->cap * 2;
+        TRACE_INSTANT(TRACE_DYNAMIC_ARRAY_GROW, cap);
+
+        if (array->elements == array->inline_elements) {
+            void **elements = Common_smalloc(sizeof(void*) * cap);
+            memcpy(elements, array->inline_elements, sizeof(void*) * array->len);
+            array->elements = elements;
+        } else {
+            array->elements = Common_srealloc(array->elements, sizeof(void*) * cap);
+        }
+
+        array->cap = cap;
+    }
+
+    array->elements[array->len++] = element;
+}
+
+void Common_small_array_release(SmallArray array) {
+    if (array->elements != array->inline_elements) {
+        LCOMMON_FREE(array->elements);
+    }
+
+    array->len = 0;
+    array->cap = LCOMMON_SMALL_ARRAY_INLINE_CAP;
+    array->elements = array->inline_elements;
+}
+
+void Common_small_array_destroy(SmallArray array) {
+    Common_small_array_release(array);
+    LCOMMON_FREE(array);
+}
+
+void Common_small_array_free(SmallArray array) {
+    for (unsigned int i = 0; i < array->len; ++i) {
+        LCOMMON_FREE(array->elements[i]);
+    }
+
+    Common_small_array_destroy(array);
+}
+
+Optional Common_optional_with(void *data) {
+    return (Optional) {
+        .data = data,
+        .is_none = LCOMMON_FALSE
+    };
+}
+
+Optional *Common_optional_alloc_with(void *data) {
+    Optional *opt = Common_smalloc(sizeof(struct optional_t));
+
+    memcpy(
+        (void*) opt,
+        (const void*) &(struct optional_t) {data, LCOMMON_FALSE},
+        sizeof(struct optional_t)
+    );
+
+    return opt;
+}
+
+Optional Common_optional_none(void) {
+    return (Optional) {
+        .data = NULL,
+        .is_none = LCOMMON_TRUE
+    };
+}
+
+Optional *Common_optional_alloc_none(void) {
+    Optional *opt = Common_smalloc(sizeof(struct optional_t));
+
+    memcpy(
+        (void*) opt,
+        (const void*) &(struct optional_t) {NULL, LCOMMON_TRUE},
+        sizeof(struct optional_t)
+    );
+
+    return opt;
+}
+
+Optional Common_optional_from(void *payload) {
+    return payload == NULL
+        ? Common_optional_none()
+        : Common_optional_with(payload);
+}
+
+Optional *Common_optional_alloc_from(void *payload) {
+    Optional *self = Common_dsmalloc(Optional);
+    Optional opt = Common_optional_from(payload);
+
+    memcpy(
+        (void*) self,
+        (const void*) &opt,
+        sizeof(Optional)
+    );
+
+    memset((void*) &opt, 0, sizeof(struct optional_t));
+
+    return self;
+}
+
+int Common_optional_is_none(Optional *optional) {
+    return Common_is_true(optional->is_none);
+}
+
+int Common_optional_is_some(Optional *optional) {
+    return !Common_optional_is_none(optional);
+}
+
+void *Common_optional_unpack(Optional *optional) {
+    LCOMMON_ASSERT(Common_optional_is_some(optional), "given optional should've data");
+    return optional->data;
+}
+
+void *Common_optional_unpack_default(Optional *optional, void *default_value) {
+    if (Common_optional_is_none(optional)) {
+        return default_value;
+    }
+
+    return optional->data;
+}
+
+void *Common_optional_to_raw(Optional *optional) {
+    return Common_optional_is_some(optional)
+        ? Common_optional_unpack(optional)
+        : NULL;
+}
+
+void Common_optional_set_data(Optional *optional, void *data) {
+    optional->data = data;
+
+    if (Common_optional_is_none(optional)) {
+        optional->is_none = LCOMMON_FALSE;
+    }
+}
+
+void Common_optional_set_none(Optional *optional) {
+    optional->is_none = LCOMMON_TRUE;
+}
+
+void Common_optional_free_data(Optional *optional) {
+    if (Common_optional_is_some(optional)) {
+        if (optional->data != NULL) {
+            LCOMMON_FREE(optional->data);
+        }
+    }
+}
+
+void Common_optional_destroy(Optional *optional) {
+    if (Common_optional_is_some(optional)) {
+        Common_optional_set_none(optional);
+    }
+
+    LCOMMON_FREE(optional);
+}
+
+void Common_optional_free(Optional *optional) {
+    Common_optional_free_data(optional);
+    Common_optional_destroy(optional);
+}
+
+OptionalArray Common_optional_array_init(void) {
+    OptionalArray ret = Common_smalloc(sizeof(struct optional_array_t));
+
+    ret->cap = 10;
+    ret->len = 0;
+    ret->elements = Common_smalloc(sizeof(struct optional_t*) * ret->cap);
+    ret->nodes = NULL;
+    ret->nodes_len = 0;
+
+    return ret;
+}
+
+OptionalArray Common_optional_array_from_buffer(void **buffer, size_t n) {
+    // [header][n + 1 element pointers][n optionals], one spare pointer slot keeps the
+    // `len < cap` invariant `Common_optional_array_append()` relies on.
+    size_t cap = n + 1;
+    char *block = Common_smalloc(sizeof(struct optional_array_t) + sizeof(struct optional_t*) * cap + sizeof(struct optional_t) * n);
+
+    OptionalArray ret = (OptionalArray) block;
+    ret->len = n;
+    ret->cap = cap;
+    ret->elements = (Optional**) (block + sizeof(struct optional_array_t));
+    ret->nodes = (Optional*) (ret->elements + cap);
+    ret->nodes_len = n;
+
+    for (size_t i = 0; i < n; ++i) {
+        ret->nodes[i].data = buffer[i];
+        ret->nodes[i].is_none = buffer[i] == NULL;
+        ret->elements[i] = &ret->nodes[i];
+    }
+
+    return ret;
+}
+
+OptionalArray Common_optional_array_from_array(const DynamicArray array) {
+    return Common_optional_array_from_buffer(array->elements, array->len);
+}
+
+// checks if the elements buffer still lives inside the array's own allocation, only
+// arrays created by the bulk constructors have `nodes` set.
+static inline LCOMMON_BOOL optional_array_has_inline_elements(const OptionalArray array) {
+    return array->nodes != NULL
+        && (const char*) array->elements == (const char*) array + sizeof(struct optional_array_t);
+}
+
+static inline LCOMMON_BOOL optional_array_owns_node(const OptionalArray array, const Optional *optional) {
+    return array->nodes_len > 0 && optional >= array->nodes && optional < array->nodes + array->nodes_len;
+}
+
+void Common_optional_array_set_data_at(
+    OptionalArray array,
+    const unsigned int n,
+    void *data
+) {
+    Common_foreach(array, Optional, cur, {
+        if (i == n) {
+            Common_optional_set_data(cur, data);
+            break;
+        }
+    });
+}
+
+void Common_optional_array_set_none_at(OptionalArray array, const unsigned int n) {
+    Common_foreach(array, Optional, cur, {
+        if (i == n) {
+            Common_optional_set_none(cur);
+            break;
+        }
+    });
+}
+
+void Common_optional_array_free_data_at(OptionalArray array, const unsigned int n) {
+    Common_foreach(array, Optional, cur, {
+        if (i == n) {
+            Common_optional_free_data(cur);
+            Common_optional_set_none(cur);
+            break;
+        }
+    });
+}
+
+void Common_optional_array_destroy(OptionalArray array) {
+    Common_foreach(array, Optional, cur, {
+        if (!optional_array_owns_node(array, cur)) {
+            Common_optional_destroy(cur);
+        }
+    });
+
+    if (!optional_array_has_inline_elements(array)) {
+        LCOMMON_FREE(array->elements);
+    }
+
+    LCOMMON_FREE(array);
+}
+
+void Common_optional_array_free(OptionalArray array) {
+    for (size_t i = 0; i < array->len; ++i) {
+        Optional *opt_value = array->elements[i];
+        LCOMMON_ASSERT(opt_value, "must be able to obtain elements from OptionalArray");
+
+        // the optionals themselves are released by Common_optional_array_destroy().
+        Common_optional_free_data(opt_value);
+    }
+
+    Common_optional_array_destroy(array);
+}
+
+void Common_optional_array_append(OptionalArray array, Optional *optional) {
+    array->elements[array->len++] = optional;
+    if (array->len >= array->cap) {
+        array->cap *= 2;
+        TRACE_INSTANT(TRACE_OPTIONAL_ARRAY_GROW, array->cap);
+
+        // elements laid out inline by the bulk constructors can't be reallocated in place.
+        if (optional_array_has_inline_elements(array)) {
+            Optional **elements = Common_smalloc(sizeof(struct optional_t*) * array->cap);
+            memcpy(elements, array->elements, sizeof(struct optional_t*) * array->len);
+            array->elements = elements;
+        } else {
+            array->elements = Common_srealloc(array->elements, sizeof(struct optional_t*) * array->cap);
+        }
+    }
+}
+
+LCOMMON_BOOL Common_streql(const char *a, const char *b) {
+    LCOMMON_BOOL ret = LCOMMON_TRUE;
+    for (int i = 0; a[i] != '\0'; ++i) {
+        if (a[i] != b[i]) {
+            ret = LCOMMON_FALSE;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+size_t Common_strcount(const char *s) {
+    int i = 0;
+    for (; s[i] != '\0'; ++i);
+    return i;
+}
+
+// string builders and formatting
+
+#define STRING_BUILDER_INITIAL_CAP 64
+
+StringBuilder Common_string_builder_init(void) {
+    StringBuilder ret = Common_smalloc(sizeof(struct string_builder_t));
+
+    ret->cap = STRING_BUILDER_INITIAL_CAP;
+    ret->len = 0;
+    ret->data = Common_smalloc(ret->cap);
+    ret->data[0] = '\0';
+
+    return ret;
+}
+
+void Common_string_builder_destroy(StringBuilder builder) {
+    LCOMMON_FREE(builder->data);
+    LCOMMON_FREE(builder);
+}
+
+char *Common_string_builder_take(StringBuilder builder) {
+    // using the right amount of memory.
+    char *result = Common_srealloc(builder->data, builder->len + 1);
+    LCOMMON_FREE(builder);
+    return result;
+}
+
+void Common_string_builder_clear(StringBuilder builder) {
+    builder->len = 0;
+    builder->data[0] = '\0';
+}
+
+void Common_string_builder_reserve(StringBuilder builder, size_t extra) {
+    size_t needed = builder->len + extra + 1;
+    if (needed <= builder->cap) {
+        return;
+    }
+
+    size_t cap = builder->cap * 2;
+    builder->cap = cap > needed ? cap : needed;
+    builder->data = Common_srealloc(builder->data, builder->cap);
+}
+
+void Common_string_builder_append_n(StringBuilder builder, const char *s, size_t n) {
+    Common_string_builder_reserve(builder, n);
+    memcpy(builder->data + builder->len, s, n);
+    builder->len += n;
+    builder->data[builder->len] = '\0';
+}
+
+void Common_string_builder_append(StringBuilder builder, const char *s) {
+    Common_string_builder_append_n(builder, s, strlen(s));
+}
+
+void Common_string_builder_append_char(StringBuilder builder, char c) {
+    Common_string_builder_reserve(builder, 1);
+    builder->data[builder->len++] = c;
+    builder->data[builder->len] = '\0';
+}
+
+// writes straight into the spare capacity of the builder, `convert` gets a buffer of at
+// least LCOMMON_FORMAT_BUFFER_SIZE bytes and returns how many of them it used.
+#define STRING_BUILDER_CONVERT(builder, convert, value) \
+    do { \
+        Common_string_builder_reserve((builder), LCOMMON_FORMAT_BUFFER_SIZE); \
+        (builder)->len += convert((builder)->data + (builder)->len, (value)); \
+        (builder)->data[(builder)->len] = '\0'; \
+    } while (0)
+
+void Common_string_builder_append_int(StringBuilder builder, long long value) {
+    STRING_BUILDER_CONVERT(builder, Common_format_int, value);
+}
+
+void Common_string_builder_append_uint(StringBuilder builder, unsigned long long value) {
+    STRING_BUILDER_CONVERT(builder, Common_format_uint, value);
+}
+
+void Common_string_builder_append_hex(StringBuilder builder, unsigned long long value) {
+    STRING_BUILDER_CONVERT(builder, Common_format_hex, value);
+}
+
+void Common_string_builder_append_double(StringBuilder builder, double value) {
+    STRING_BUILDER_CONVERT(builder, Common_format_double, value);
+}
+
+void Common_string_builder_append_array(
+    StringBuilder builder,
+    const char *separator,
+    const DynamicArray array
+) {
+    size_t separator_len = strlen(separator);
+    size_t total = 0;
+
+    // sizing everything first so the buffer grows at most once.
+    Common_foreach(array, char, element, {
+        total += strlen(element) + (i > 0 ? separator_len : 0);
+    });
+
+    Common_string_builder_reserve(builder, total);
+
+    Common_foreach(array, char, element, {
+        if (i > 0) {
+            Common_string_builder_append_n(builder, separator, separator_len);
+        }
+
+        Common_string_builder_append(builder, element);
+    });
+}
+
+void Common_string_builder_append_optional_array(
+    StringBuilder builder,
+    const char *separator,
+    const OptionalArray array
+) {
+    size_t separator_len = strlen(separator);
+    size_t total = 0;
+    LCOMMON_BOOL first = LCOMMON_TRUE;
+
+    Common_foreach(array, Optional, opt_element, {
+        if (Common_optional_is_some(opt_element)) {
+            total += strlen(Common_optional_unpack(opt_element)) + (first ? 0 : separator_len);
+            first = LCOMMON_FALSE;
+        }
+    });
+
+    Common_string_builder_reserve(builder, total);
+    first = LCOMMON_TRUE;
+
+    Common_foreach(array, Optional, opt_element, {
+        if (Common_optional_is_none(opt_element)) {
+            continue;
+        }
+
+        if (!first) {
+            Common_string_builder_append_n(builder, separator, separator_len);
+        }
+
+        Common_string_builder_append(builder, Common_optional_unpack(opt_element));
+        first = LCOMMON_FALSE;
+    });
+}
+
+void Common_string_builder_join_ints(
+    StringBuilder builder,
+    const char *separator,
+    const long long *values,
+    size_t n
+) {
+    size_t separator_len = strlen(separator);
+
+    for (size_t i = 0; i < n; ++i) {
+        Common_string_builder_reserve(builder, separator_len + LCOMMON_FORMAT_BUFFER_SIZE);
+
+        if (i > 0) {
+            memcpy(builder->data + builder->len, separator, separator_len);
+            builder->len += separator_len;
+        }
+
+        builder->len += Common_format_int(builder->data + builder->len, values[i]);
+    }
+
+    builder->data[builder->len] = '\0';
+}
+
+void Common_string_builder_join_doubles(
+    StringBuilder builder,
+    const char *separator,
+    const double *values,
+    size_t n
+) {
+    size_t separator_len = strlen(separator);
+
+    for (size_t i = 0; i < n; ++i) {
+        Common_string_builder_reserve(builder, separator_len + LCOMMON_FORMAT_BUFFER_SIZE);
+
+        if (i > 0) {
+            memcpy(builder->data + builder->len, separator, separator_len);
+            builder->len += separator_len;
+        }
+
+        builder->len += Common_format_double(builder->data + builder->len, values[i]);
+    }
+
+    builder->data[builder->len] = '\0';
+}
+
+static const char format_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char format_hex_digits[17] = "0123456789abcdef";
+
+size_t Common_format_uint(char *out, unsigned long long value) {
+    char buffer[LCOMMON_FORMAT_BUFFER_SIZE];
+    char *end = buffer + sizeof(buffer);
+    char *p = end;
+
+    // two digits per division, straight from the pairs table.
+    while (value >= 100) {
+        unsigned long long pair = (value % 100) * 2;
+        value /= 100;
+        *--p = format_digit_pairs[pair + 1];
+        *--p = format_digit_pairs[pair];
+    }
+
+    if (value >= 10) {
+        *--p = format_digit_pairs[value * 2 + 1];
+        *--p = format_digit_pairs[value * 2];
+    } else {
+        *--p = (char) ('0' + value);
+    }
+
+    memcpy(out, p, (size_t) (end - p));
+    return (size_t) (end - p);
+}
+
+size_t Common_format_int(char *out, long long value) {
+    if (value < 0) {
+        *out = '-';
+        // negating as unsigned so LLONG_MIN doesn't overflow.
+        return 1 + Common_format_uint(out + 1, 0ULL - (unsigned long long) value);
+    }
+
+    return Common_format_uint(out, (unsigned long long) value);
+}
+
+size_t Common_format_hex(char *out, unsigned long long value) {
+    size_t digits = value == 0 ? 1 : (size_t) (64 - __builtin_clzll(value) + 3) / 4;
+
+    for (size_t i = digits; i > 0; --i) {
+        out[i - 1] = format_hex_digits[value & 0xf];
+        value >>= 4;
+    }
+
+    return digits;
+}
+
+// round-trip doubles, implemented with Florian Loitsch's Grisu2 algorithm: the value and
+// its rounding boundaries are scaled by a cached power of ten so that the digits can be
+// generated with 64-bit integer arithmetic only. Grisu2 always round-trips but its
+// imprecise boundaries make a small fraction of the doubles one digit longer than needed.
+
+typedef struct format_diyfp_t {
+    uint64_t f;
+    int e;
+} FormatDiyFp;
+
+typedef struct format_cached_power_t {
+    uint64_t f;
+    int e;
+    int k;
+} FormatCachedPower;
+
+// normalized approximations of 10^k for k = -300, -292, ..., 324.
+static const FormatCachedPower format_cached_powers[] = {
+    { 0xAB70FE17C79AC6CA, -1060,  -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034,  -292 },
+    { 0xBE5691EF416BD60C, -1007,  -284 },
+    { 0x8DD01FAD907FFC3C,  -980,  -276 },
+    { 0xD3515C2831559A83,  -954,  -268 },
+    { 0x9D71AC8FADA6C9B5,  -927,  -260 },
+    { 0xEA9C227723EE8BCB,  -901,  -252 },
+    { 0xAECC49914078536D,  -874,  -244 },
+    { 0x823C12795DB6CE57,  -847,  -236 },
+    { 0xC21094364DFB5637,  -821,  -228 },
+    { 0x9096EA6F3848984F,  -794,  -220 },
+    { 0xD77485CB25823AC7,  -768,  -212 },
+    { 0xA086CFCD97BF97F4,  -741,  -204 },
+    { 0xEF340A98172AACE5,  -715,  -196 },
+    { 0xB23867FB2A35B28E,  -688,  -188 },
+    { 0x84C8D4DFD2C63F3B,  -661,  -180 },
+    { 0xC5DD44271AD3CDBA,  -635,  -172 },
+    { 0x936B9FCEBB25C996,  -608,  -164 },
+    { 0xDBAC6C247D62A584,  -582,  -156 },
+    { 0xA3AB66580D5FDAF6,  -555,  -148 },
+    { 0xF3E2F893DEC3F126,  -529,  -140 },
+    { 0xB5B5ADA8AAFF80B8,  -502,  -132 },
+    { 0x87625F056C7C4A8B,  -475,  -124 },
+    { 0xC9BCFF6034C13053,  -449,  -116 },
+    { 0x964E858C91BA2655,  -422,  -108 },
+    { 0xDFF9772470297EBD,  -396,  -100 },
+    { 0xA6DFBD9FB8E5B88F,  -369,   -92 },
+    { 0xF8A95FCF88747D94,  -343,   -84 },
+    { 0xB94470938FA89BCF,  -316,   -76 },
+    { 0x8A08F0F8BF0F156B,  -289,   -68 },
+    { 0xCDB02555653131B6,  -263,   -60 },
+    { 0x993FE2C6D07B7FAC,  -236,   -52 },
+    { 0xE45C10C42A2B3B06,  -210,   -44 },
+    { 0xAA242499697392D3,  -183,   -36 },
+    { 0xFD87B5F28300CA0E,  -157,   -28 },
+    { 0xBCE5086492111AEB,  -130,   -20 },
+    { 0x8CBCCC096F5088CC,  -103,   -12 },
+    { 0xD1B71758E219652C,   -77,    -4 },
+    { 0x9C40000000000000,   -50,     4 },
+    { 0xE8D4A51000000000,   -24,    12 },
+    { 0xAD78EBC5AC620000,     3,    20 },
+    { 0x813F3978F8940984,    30,    28 },
+    { 0xC097CE7BC90715B3,    56,    36 },
+    { 0x8F7E32CE7BEA5C70,    83,    44 },
+    { 0xD5D238A4ABE98068,   109,    52 },
+    { 0x9F4F2726179A2245,   136,    60 },
+    { 0xED63A231D4C4FB27,   162,    68 },
+    { 0xB0DE65388CC8ADA8,   189,    76 },
+    { 0x83C7088E1AAB65DB,   216,    84 },
+    { 0xC45D1DF942711D9A,   242,    92 },
+    { 0x924D692CA61BE758,   269,   100 },
+    { 0xDA01EE641A708DEA,   295,   108 },
+    { 0xA26DA3999AEF774A,   322,   116 },
+    { 0xF209787BB47D6B85,   348,   124 },
+    { 0xB454E4A179DD1877,   375,   132 },
+    { 0x865B86925B9BC5C2,   402,   140 },
+    { 0xC83553C5C8965D3D,   428,   148 },
+    { 0x952AB45CFA97A0B3,   455,   156 },
+    { 0xDE469FBD99A05FE3,   481,   164 },
+    { 0xA59BC234DB398C25,   508,   172 },
+    { 0xF6C69A72A3989F5C,   534,   180 },
+    { 0xB7DCBF5354E9BECE,   561,   188 },
+    { 0x88FCF317F22241E2,   588,   196 },
+    { 0xCC20CE9BD35C78A5,   614,   204 },
+    { 0x98165AF37B2153DF,   641,   212 },
+    { 0xE2A0B5DC971F303A,   667,   220 },
+    { 0xA8D9D1535CE3B396,   694,   228 },
+    { 0xFB9B7CD9A4A7443C,   720,   236 },
+    { 0xBB764C4CA7A44410,   747,   244 },
+    { 0x8BAB8EEFB6409C1A,   774,   252 },
+    { 0xD01FEF10A657842C,   800,   260 },
+    { 0x9B10A4E5E9913129,   827,   268 },
+    { 0xE7109BFBA19C0C9D,   853,   276 },
+    { 0xAC2820D9623BF429,   880,   284 },
+    { 0x80444B5E7AA7CF85,   907,   292 },
+    { 0xBF21E44003ACDD2D,   933,   300 },
+    { 0x8E679C2F5E44FF8F,   960,   308 },
+    { 0xD433179D9C8CB841,   986,   316 },
+    { 0x9E19DB92B4E31BA9,  1013,   324 },
+};
+
+#define FORMAT_GRISU_ALPHA (-60)
+#define FORMAT_GRISU_GAMMA (-32)
+
+static inline FormatDiyFp format_diyfp_mul(FormatDiyFp x, FormatDiyFp y) {
+    unsigned __int128 product = (unsigned __int128) x.f * y.f;
+    uint64_t high = (uint64_t) (product >> 64);
+    uint64_t low = (uint64_t) product;
+
+    // rounding the lower half into the upper one.
+    high += low >> 63;
+
+    return (FormatDiyFp) { high, x.e + y.e + 64 };
+}
+
+static inline FormatDiyFp format_diyfp_normalize(FormatDiyFp x) {
+    int shift = __builtin_clzll(x.f);
+    return (FormatDiyFp) { x.f << shift, x.e - shift };
+}
+
+static inline FormatDiyFp format_diyfp_normalize_to(FormatDiyFp x, int e) {
+    return (FormatDiyFp) { x.f << (x.e - e), e };
+}
+
+// computes the normalized value and its lower/upper rounding boundaries, every
+// decimal number strictly between them reads back as `value`.
+static void format_compute_boundaries(
+    double value,
+    FormatDiyFp *w,
+    FormatDiyFp *minus,
+    FormatDiyFp *plus
+) {
+    const uint64_t hidden_bit = (uint64_t) 1 << 52;
+    const int exponent_bias = 1075;
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint64_t fraction = bits & (hidden_bit - 1);
+    int biased_exponent = (int) (bits >> 52);
+
+    FormatDiyFp v = biased_exponent == 0
+        ? (FormatDiyFp) { fraction, 1 - exponent_bias }
+        : (FormatDiyFp) { fraction + hidden_bit, biased_exponent - exponent_bias };
+
+    // the lower boundary is closer when the fraction is zero, since the exponent
+    // below has twice the density.
+    LCOMMON_BOOL lower_is_closer = fraction == 0 && biased_exponent > 1;
+
+    FormatDiyFp m_plus = { 2 * v.f + 1, v.e - 1 };
+    FormatDiyFp m_minus = lower_is_closer
+        ? (FormatDiyFp) { 4 * v.f - 1, v.e - 2 }
+        : (FormatDiyFp) { 2 * v.f - 1, v.e - 1 };
+
+    *plus = format_diyfp_normalize(m_plus);
+    *minus = format_diyfp_normalize_to(m_minus, plus->e);
+    *w = format_diyfp_normalize(v);
+}
+
+static inline FormatCachedPower format_cached_power_for(int e) {
+    const int min_decimal_exponent = -300;
+    const int decimal_step = 8;
+
+    // k = ceil((alpha - e - 1) * log10(2)), 78913 / 2^18 ~ log10(2).
+    int f = FORMAT_GRISU_ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    int index = (-min_decimal_exponent + k + (decimal_step - 1)) / decimal_step;
+
+    return format_cached_powers[index];
+}
+
+static inline int format_largest_pow10(uint32_t n, uint32_t *pow10) {
+    static const uint32_t powers[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+
+    int digits = 10;
+    while (digits > 1 && n < powers[digits - 1]) {
+        --digits;
+    }
+
+    *pow10 = powers[digits - 1];
+    return digits;
+}
+
+static inline void format_grisu_round(
+    char *buffer,
+    int len,
+    uint64_t dist,
+    uint64_t delta,
+    uint64_t rest,
+    uint64_t ten_k
+) {
+    // moving the last digit down while we get closer to the exact value and stay
+    // inside the rounding interval.
+    while (rest < dist
+        && delta - rest >= ten_k
+        && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buffer[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+static int format_grisu_digits(
+    char *buffer,
+    int *decimal_exponent,
+    FormatDiyFp m_minus,
+    FormatDiyFp w,
+    FormatDiyFp m_plus
+) {
+    uint64_t delta = m_plus.f - m_minus.f;
+    uint64_t dist = m_plus.f - w.f;
+
+    const int one_e = m_plus.e;
+    const uint64_t one_f = (uint64_t) 1 << -one_e;
+
+    uint32_t p1 = (uint32_t) (m_plus.f >> -one_e);
+    uint64_t p2 = m_plus.f & (one_f - 1);
+
+    uint32_t pow10;
+    int n = format_largest_pow10(p1, &pow10);
+    int len = 0;
+
+    // integral part.
+    while (n > 0) {
+        buffer[len++] = (char) ('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+
+        uint64_t rest = ((uint64_t) p1 << -one_e) + p2;
+        if (rest <= delta) {
+            *decimal_exponent += n;
+            format_grisu_round(buffer, len, dist, delta, rest, (uint64_t) pow10 << -one_e);
+            return len;
+        }
+
+        pow10 /= 10;
+    }
+
+    // fractional part.
+    int m = 0;
+    for (;;) {
+        p2 *= 10;
+        buffer[len++] = (char) ('0' + (p2 >> -one_e));
+        p2 &= one_f - 1;
+        m++;
+
+        delta *= 10;
+        dist *= 10;
+
+        if (p2 <= delta) {
+            break;
+        }
+    }
+
+    *decimal_exponent -= m;
+    format_grisu_round(buffer, len, dist, delta, p2, one_f);
+
+    return len;
+}
+
+// generates the shortest digits of a finite positive double, value = digits * 10^exponent.
+static int format_grisu(char *buffer, int *decimal_exponent, double value) {
+    FormatDiyFp w, m_minus, m_plus;
+    format_compute_boundaries(value, &w, &m_minus, &m_plus);
+
+    FormatCachedPower cached = format_cached_power_for(m_plus.e);
+    FormatDiyFp c_minus_k = { cached.f, cached.e };
+
+    FormatDiyFp scaled_w = format_diyfp_mul(w, c_minus_k);
+    FormatDiyFp scaled_minus = format_diyfp_mul(m_minus, c_minus_k);
+    FormatDiyFp scaled_plus = format_diyfp_mul(m_plus, c_minus_k);
+
+    // shrinking the interval by one unit in each side to stay safe from the rounding
+    // errors of the multiplications.
+    scaled_minus.f += 1;
+    scaled_plus.f -= 1;
+
+    *decimal_exponent = -cached.k;
+
+    return format_grisu_digits(buffer, decimal_exponent, scaled_minus, scaled_w, scaled_plus);
+}
+
+size_t Common_format_double(char *out, double value) {
+    char *p = out;
+
+    if (value != value) {
+        memcpy(p, "nan", 3);
+        return 3;
+    }
+
+    if (__builtin_signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+
+    if (value == __builtin_inf()) {
+        memcpy(p, "inf", 3);
+        return (size_t) (p - out) + 3;
+    }
+
+    if (value == 0) {
+        *p++ = '0';
+        return (size_t) (p - out);
+    }
+
+    char digits[18];
+    int k;
+    int len = format_grisu(digits, &k, value);
+
+    // position of the decimal point relative to the digits.
+    int n = len + k;
+
+    if (k >= 0 && n <= 21) {
+        // 1234e7 -> 12340000000
+        memcpy(p, digits, (size_t) len);
+        memset(p + len, '0', (size_t) k);
+        p += n;
+    } else if (n > 0 && n <= 21) {
+        // 1234e-2 -> 12.34
+        memcpy(p, digits, (size_t) n);
+        p[n] = '.';
+        memcpy(p + n + 1, digits + n, (size_t) (len - n));
+        p += len + 1;
+    } else if (n > -6 && n <= 0) {
+        // 1234e-6 -> 0.001234
+        p[0] = '0';
+        p[1] = '.';
+        memset(p + 2, '0', (size_t) -n);
+        memcpy(p + 2 - n, digits, (size_t) len);
+        p += 2 - n + len;
+    } else {
+        // 1234e30 -> 1.234e+33
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, (size_t) (len - 1));
+            p += len - 1;
+        }
+
+        int exponent = n - 1;
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        p += Common_format_uint(p, (unsigned long long) (exponent < 0 ? -exponent : exponent));
+    }
+
+    return (size_t) (p - out);
+}
+
+// flags, width and precision of a conversion, `precision` is -1 when there's none.
+typedef struct format_spec_t {
+    LCOMMON_BOOL left;
+    LCOMMON_BOOL zero;
+    LCOMMON_BOOL alternate;
+    char sign;
+    int width;
+    int precision;
+} FormatSpec;
+
+// length modifiers, they only matter for integers (and long doubles).
+enum {
+    FORMAT_LENGTH_NONE,
+    FORMAT_LENGTH_HH,
+    FORMAT_LENGTH_H,
+    FORMAT_LENGTH_L,
+    FORMAT_LENGTH_LL,
+    FORMAT_LENGTH_Z,
+    FORMAT_LENGTH_J,
+    FORMAT_LENGTH_T,
+    FORMAT_LENGTH_LONG_DOUBLE,
+};
+
+static void format_fill(StringBuilder builder, char c, size_t n) {
+    Common_string_builder_reserve(builder, n);
+    memset(builder->data + builder->len, c, n);
+    builder->len += n;
+    builder->data[builder->len] = '\0';
+}
+
+// appends `prefix`, `zeros` zeros and `body` padded up to the width of the conversion.
+// Numeric conversions with the 0 flag are padded with zeros after the prefix.
+static void format_emit(
+    StringBuilder builder,
+    const FormatSpec *spec,
+    LCOMMON_BOOL numeric,
+    const char *prefix,
+    size_t zeros,
+    const char *body,
+    size_t body_len
+) {
+    size_t prefix_len = strlen(prefix);
+    size_t len = prefix_len + zeros + body_len;
+    size_t pad = spec->width > 0 && (size_t) spec->width > len ? (size_t) spec->width - len : 0;
+    LCOMMON_BOOL zero_pad = numeric && spec->zero && !spec->left;
+
+    if (!spec->left && !zero_pad) {
+        format_fill(builder, ' ', pad);
+    }
+
+    Common_string_builder_append_n(builder, prefix, prefix_len);
+    format_fill(builder, '0', zeros + (zero_pad ? pad : 0));
+    Common_string_builder_append_n(builder, body, body_len);
+
+    if (spec->left) {
+        format_fill(builder, ' ', pad);
+    }
+}
+
+static void format_integer(
+    StringBuilder builder,
+    FormatSpec *spec,
+    char sign,
+    unsigned long long value,
+    char conversion
+) {
+    char digits[LCOMMON_FORMAT_BUFFER_SIZE];
+    size_t len = 0;
+
+    if (conversion == 'x' || conversion == 'X' || conversion == 'p') {
+        len = Common_format_hex(digits, value);
+        for (size_t i = 0; conversion == 'X' && i < len; ++i) {
+            if (digits[i] >= 'a') {
+                digits[i] -= 'a' - 'A';
+            }
+        }
+    } else if (conversion == 'o') {
+        char *p = digits + sizeof(digits);
+        do {
+            *--p = (char) ('0' + (value & 7));
+            value >>= 3;
+        } while (value != 0);
+
+        len = (size_t) (digits + sizeof(digits) - p);
+        memmove(digits, p, len);
+    } else {
+        len = Common_format_uint(digits, value);
+    }
+
+    // an explicit precision of 0 prints nothing for a zero.
+    if (spec->precision == 0 && len == 1 && digits[0] == '0' && conversion != 'p') {
+        len = 0;
+    }
+
+    size_t zeros = spec->precision > 0 && (size_t) spec->precision > len ? (size_t) spec->precision - len : 0;
+    if (conversion == 'o' && spec->alternate && zeros == 0 && (len == 0 || digits[0] != '0')) {
+        zeros = 1;
+    }
+
+    char prefix[4] = {0};
+    size_t prefix_len = 0;
+    if (sign != 0) {
+        prefix[prefix_len++] = sign;
+    }
+
+    if (conversion == 'p' || (spec->alternate && value != 0 && (conversion == 'x' || conversion == 'X'))) {
+        prefix[prefix_len++] = '0';
+        prefix[prefix_len++] = conversion == 'X' ? 'X' : 'x';
+    }
+
+    // the 0 flag is ignored when a precision is given.
+    if (spec->precision >= 0) {
+        spec->zero = LCOMMON_FALSE;
+    }
+
+    format_emit(builder, spec, LCOMMON_TRUE, prefix, zeros, digits, len);
+}
+
+// hands a single conversion over to the C library, for the ones which aren't worth
+// reimplementing: floating point and wide characters.
+static void format_libc(StringBuilder builder, const char *conversion, ...) {
+    va_list args;
+    va_list copy;
+
+    // most conversions fit in the spare capacity, the long ones are written a second time.
+    va_start(args, conversion);
+    va_copy(copy, args);
+    Common_string_builder_reserve(builder, LCOMMON_FORMAT_BUFFER_SIZE);
+
+    size_t spare = builder->cap - builder->len;
+    int n = vsnprintf(builder->data + builder->len, spare, conversion, args);
+
+    if (n > 0 && (size_t) n >= spare) {
+        Common_string_builder_reserve(builder, (size_t) n);
+        vsnprintf(builder->data + builder->len, (size_t) n + 1, conversion, copy);
+    }
+
+    builder->len += n > 0 ? (size_t) n : 0;
+    builder->data[builder->len] = '\0';
+
+    va_end(copy);
+    va_end(args);
+}
+
+// the C library writes the decimal point of the current locale, it's put back to '.'.
+static void format_fix_decimal_point(StringBuilder builder, size_t from) {
+    const char *point = localeconv()->decimal_point;
+    if (point[0] == '.' && point[1] == '\0') {
+        return;
+    }
+
+    char *at = strstr(builder->data + from, point);
+    if (at == NULL) {
+        return;
+    }
+
+    size_t point_len = strlen(point);
+    *at = '.';
+    memmove(at + 1, at + point_len, (size_t) (builder->data + builder->len - at - point_len) + 1);
+    builder->len -= point_len - 1;
+}
+
+void Common_vformat(StringBuilder builder, const char *format, va_list args) {
+    int saved_errno = errno;
+    size_t start = builder->len;
+    const char *p = format;
+
+    while (*p != '\0') {
+        const char *percent = strchr(p, '%');
+        if (percent == NULL) {
+            Common_string_builder_append(builder, p);
+            return;
+        }
+
+        Common_string_builder_append_n(builder, p, (size_t) (percent - p));
+        p = percent + 1;
+
+        FormatSpec spec = { LCOMMON_FALSE, LCOMMON_FALSE, LCOMMON_FALSE, 0, 0, -1 };
+
+        // the ' flag groups thousands as the locale says, which is ignored here.
+        for (;; ++p) {
+            if (*p == '-') {
+                spec.left = LCOMMON_TRUE;
+            } else if (*p == '0') {
+                spec.zero = LCOMMON_TRUE;
+            } else if (*p == '#') {
+                spec.alternate = LCOMMON_TRUE;
+            } else if (*p == '+') {
+                spec.sign = '+';
+            } else if (*p == ' ') {
+                spec.sign = spec.sign == '+' ? '+' : ' ';
+            } else if (*p != '\'') {
+                break;
+            }
+        }
+
+        if (*p == '*') {
+            spec.width = va_arg(args, int);
+            if (spec.width < 0) {
+                spec.left = LCOMMON_TRUE;
+                spec.width = spec.width == INT_MIN ? INT_MAX : -spec.width;
+            }
+            p++;
+        } else {
+            for (; *p >= '0' && *p <= '9'; ++p) {
+                spec.width = spec.width * 10 + (*p - '0');
+            }
+        }
+
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                spec.precision = va_arg(args, int);
+                spec.precision = spec.precision < 0 ? -1 : spec.precision;
+                p++;
+            } else {
+                spec.precision = 0;
+                for (; *p >= '0' && *p <= '9'; ++p) {
+                    spec.precision = spec.precision * 10 + (*p - '0');
+                }
+            }
+        }
+
+        int length = FORMAT_LENGTH_NONE;
+        switch (*p) {
+            case 'h':
+                length = p[1] == 'h' ? FORMAT_LENGTH_HH : FORMAT_LENGTH_H;
+                break;
+            case 'l':
+                length = p[1] == 'l' ? FORMAT_LENGTH_LL : FORMAT_LENGTH_L;
+                break;
+            case 'q':
+                length = FORMAT_LENGTH_LL;
+                break;
+            case 'z':
+                length = FORMAT_LENGTH_Z;
+                break;
+            case 'j':
+                length = FORMAT_LENGTH_J;
+                break;
+            case 't':
+                length = FORMAT_LENGTH_T;
+                break;
+            case 'L':
+                length = FORMAT_LENGTH_LONG_DOUBLE;
+                break;
+        }
+
+        if (length != FORMAT_LENGTH_NONE) {
+            p += (length == FORMAT_LENGTH_HH || length == FORMAT_LENGTH_LL) && p[0] == p[1] ? 2 : 1;
+        }
+
+        #define FORMAT_SIGNED_ARG() \
+            (length == FORMAT_LENGTH_HH ? (long long) (signed char) va_arg(args, int) \
+                : length == FORMAT_LENGTH_H ? (long long) (short) va_arg(args, int) \
+                : length == FORMAT_LENGTH_L ? (long long) va_arg(args, long) \
+                : length == FORMAT_LENGTH_LL ? va_arg(args, long long) \
+                : length == FORMAT_LENGTH_Z ? (long long) va_arg(args, ssize_t) \
+                : length == FORMAT_LENGTH_J ? (long long) va_arg(args, intmax_t) \
+                : length == FORMAT_LENGTH_T ? (long long) va_arg(args, ptrdiff_t) \
+                : (long long) va_arg(args, int))
+
+        #define FORMAT_UNSIGNED_ARG() \
+            (length == FORMAT_LENGTH_HH ? (unsigned long long) (unsigned char) va_arg(args, unsigned int) \
+                : length == FORMAT_LENGTH_H ? (unsigned long long) (unsigned short) va_arg(args, unsigned int) \
+                : length == FORMAT_LENGTH_L ? (unsigned long long) va_arg(args, unsigned long) \
+                : length == FORMAT_LENGTH_LL ? va_arg(args, unsigned long long) \
+                : length == FORMAT_LENGTH_Z ? (unsigned long long) va_arg(args, size_t) \
+                : length == FORMAT_LENGTH_J ? (unsigned long long) va_arg(args, uintmax_t) \
+                : length == FORMAT_LENGTH_T ? (unsigned long long) va_arg(args, ptrdiff_t) \
+                : (unsigned long long) va_arg(args, unsigned int))
+
+        // flags, width and precision rebuilt for `format_libc()`.
+        char conversion[16] = "%";
+        size_t conversion_len = 1;
+        const char flags[] = { spec.left ? '-' : 0, spec.zero ? '0' : 0, spec.alternate ? '#' : 0, spec.sign };
+        for (size_t i = 0; i < sizeof(flags); ++i) {
+            if (flags[i] != 0) {
+                conversion[conversion_len++] = flags[i];
+            }
+        }
+
+        memcpy(conversion + conversion_len, "*.*", 3);
+        conversion_len += 3;
+        if (length == FORMAT_LENGTH_L || length == FORMAT_LENGTH_LONG_DOUBLE) {
+            conversion[conversion_len++] = length == FORMAT_LENGTH_L ? 'l' : 'L';
+        }
+        conversion[conversion_len++] = *p;
+        conversion[conversion_len] = '\0';
+
+        switch (*p) {
+            case 's': {
+                if (length == FORMAT_LENGTH_L) {
+                    format_libc(builder, conversion, spec.width, spec.precision, va_arg(args, const wchar_t*));
+                    break;
+                }
+
+                const char *s = va_arg(args, const char*);
+
+                // like glibc, a precision too short for all of "(null)" prints nothing.
+                if (s == NULL) {
+                    s = spec.precision < 0 || spec.precision >= 6 ? "(null)" : "";
+                }
+
+                size_t len = spec.precision >= 0 ? strnlen(s, (size_t) spec.precision) : strlen(s);
+                format_emit(builder, &spec, LCOMMON_FALSE, "", 0, s, len);
+                break;
+            }
+
+            case 'c': {
+                if (length == FORMAT_LENGTH_L) {
+                    format_libc(builder, conversion, spec.width, spec.precision, va_arg(args, wint_t));
+                    break;
+                }
+
+                char c = (char) va_arg(args, int);
+                format_emit(builder, &spec, LCOMMON_FALSE, "", 0, &c, 1);
+                break;
+            }
+
+            case 'd':
+            case 'i': {
+                long long value = FORMAT_SIGNED_ARG();
+                unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long) value : (unsigned long long) value;
+                format_integer(builder, &spec, value < 0 ? '-' : spec.sign, magnitude, 'd');
+                break;
+            }
+
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                format_integer(builder, &spec, 0, FORMAT_UNSIGNED_ARG(), *p);
+                break;
+
+            case 'p': {
+                void *pointer = va_arg(args, void*);
+
+                if (pointer == NULL) {
+                    format_emit(builder, &spec, LCOMMON_FALSE, "", 0, "(nil)", 5);
+                } else {
+                    format_integer(builder, &spec, spec.sign, (unsigned long long) (uintptr_t) pointer, 'p');
+                }
+                break;
+            }
+
+            case 'f':
+            case 'g':
+            case 'F':
+            case 'G':
+            case 'e':
+            case 'E':
+            case 'a':
+            case 'A': {
+                size_t at = builder->len;
+
+                if (length == FORMAT_LENGTH_LONG_DOUBLE) {
+                    format_libc(builder, conversion, spec.width, spec.precision, va_arg(args, long double));
+                } else {
+                    format_libc(builder, conversion, spec.width, spec.precision, va_arg(args, double));
+                }
+
+                format_fix_decimal_point(builder, at);
+                break;
+            }
+
+            case 'n': {
+                size_t written = builder->len - start;
+                void *out = va_arg(args, void*);
+
+                switch (length) {
+                    case FORMAT_LENGTH_HH:
+                        *(signed char*) out = (signed char) written;
+                        break;
+                    case FORMAT_LENGTH_H:
+                        *(short*) out = (short) written;
+                        break;
+                    case FORMAT_LENGTH_L:
+                        *(long*) out = (long) written;
+                        break;
+                    case FORMAT_LENGTH_LL:
+                        *(long long*) out = (long long) written;
+                        break;
+                    case FORMAT_LENGTH_Z:
+                        *(ssize_t*) out = (ssize_t) written;
+                        break;
+                    case FORMAT_LENGTH_J:
+                        *(intmax_t*) out = (intmax_t) written;
+                        break;
+                    case FORMAT_LENGTH_T:
+                        *(ptrdiff_t*) out = (ptrdiff_t) written;
+                        break;
+                    default:
+                        *(int*) out = (int) written;
+                }
+                break;
+            }
+
+            case 'm': {
+                const char *message = strerror(saved_errno);
+                format_emit(builder, &spec, LCOMMON_FALSE, "", 0, message, strlen(message));
+                break;
+            }
+
+            case '%':
+                Common_string_builder_append_char(builder, '%');
+                break;
+
+            default:
+                // unknown conversions and a lone trailing '%' are copied through as written.
+                if (*p == '\0') {
+                    Common_string_builder_append_n(builder, percent, (size_t) (p - percent));
+                    return;
+                }
+
+                Common_string_builder_append_n(builder, percent, (size_t) (p - percent) + 1);
+        }
+
+        #undef FORMAT_SIGNED_ARG
+        #undef FORMAT_UNSIGNED_ARG
+
+        p++;
+    }
+}
+
+void Common_format(StringBuilder builder, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    Common_vformat(builder, format, args);
+    va_end(args);
+}
+
+char *__private__Common_strmerge(const char *separator, const char *first, ...) {
+    va_list args;
+    va_start(args, first);
+    defer({ va_end(args); });
+
+    TRACE_BEGIN(TRACE_STRMERGE, 0);
+
+    size_t separator_len = strlen(separator);
+    size_t total = strlen(first);
+    char *cur;
+
+    // sizing everything first so the buffer grows at most once.
+    va_list sizing;
+    va_copy(sizing, args);
+    while ((cur = va_arg(sizing, char*)) != LCOMMON_TERMINATOR) {
+        total += separator_len + strlen(cur);
+    }
+    va_end(sizing);
+
+    StringBuilder builder = Common_string_builder_init();
+    Common_string_builder_reserve(builder, total);
+    Common_string_builder_append(builder, first);
+
+    while ((cur = va_arg(args, char*)) != LCOMMON_TERMINATOR) {
+        Common_string_builder_append_n(builder, separator, separator_len);
+        Common_string_builder_append(builder, cur);
+    }
+
+    TRACE_END(TRACE_STRMERGE, builder->len);
+
+    return Common_string_builder_take(builder);
+}
+
+char *Common_strmerge_from_array(
+    const char *separator,
+    const DynamicArray dynamic_array
+) {
+    TRACE_BEGIN(TRACE_STRMERGE, 0);
+
+    StringBuilder builder = Common_string_builder_init();
+    Common_string_builder_append_array(builder, separator, dynamic_array);
+
+    TRACE_END(TRACE_STRMERGE, builder->len);
+
+    return Common_string_builder_take(builder);
+}
+
+char *Common_strmerge_from_optional_array(
+    const char *separator,
+    const OptionalArray optional_array
+) {
+    TRACE_BEGIN(TRACE_STRMERGE, 0);
+
+    StringBuilder builder = Common_string_builder_init();
+    Common_string_builder_append_optional_array(builder, separator, optional_array);
+
+    TRACE_END(TRACE_STRMERGE, builder->len);
+
+    return Common_string_builder_take(builder);
+}
+
+char *Common_strmerge_from_ints(const char *separator, const long long *values, size_t n) {
+    TRACE_BEGIN(TRACE_STRMERGE, 0);
+
+    StringBuilder builder = Common_string_builder_init();
+    Common_string_builder_join_ints(builder, separator, values, n);
+
+    TRACE_END(TRACE_STRMERGE, builder->len);
+
+    return Common_string_builder_take(builder);
+}
+
+char *Common_strmerge_from_doubles(const char *separator, const double *values, size_t n) {
+    TRACE_BEGIN(TRACE_STRMERGE, 0);
+
+    StringBuilder builder = Common_string_builder_init();
+    Common_string_builder_join_doubles(builder, separator, values, n);
+
+    TRACE_END(TRACE_STRMERGE, builder->len);
+
+    return Common_string_builder_take(builder);
+}
+
+// arrays shorter than this are joined by the calling thread, starting threads costs more.
+#define STRMERGE_PARALLEL_MIN_ELEMENTS (64 * 1024)
+#define STRMERGE_PARALLEL_MAX_THREADS 64
+
+// contiguous range of elements handled by one thread. The first pass fills `bytes` and
+// `count` (how many non None elements it has), the second one copies the range starting at
+// `offset`, knowing that `index` non None elements come before it.
+struct strmerge_part_t {
+    void **elements;
+    LCOMMON_BOOL optional;
+    size_t from;
+    size_t to;
+    const char *separator;
+    size_t separator_len;
+    size_t bytes;
+    size_t count;
+    size_t offset;
+    size_t index;
+    char *out;
+};
+
+static const char *strmerge_part_element(const struct strmerge_part_t *part, size_t i) {
+    if (!part->optional) {
+        LCOMMON_ASSERT(part->elements[i] != NULL, "should be able to obtain elements from a growable array");
+        return part->elements[i];
+    }
+
+    Optional *element = part->elements[i];
+    return Common_optional_is_some(element) ? Common_optional_unpack(element) : NULL;
+}
+
+static void *strmerge_part_measure(void *arg) {
+    struct strmerge_part_t *part = arg;
+
+    for (size_t i = part->from; i < part->to; ++i) {
+        const char *element = strmerge_part_element(part, i);
+        if (element != NULL) {
+            part->bytes += strlen(element);
+            part->count++;
+        }
+    }
+
+    return NULL;
+}
+
+// every element's place is known from the offset of its part, so the copies don't overlap.
+// Lengths are measured again instead of being kept from the first pass, the string was just
+// read into cache and an n sized table of lengths would cost more memory traffic.
+static void *strmerge_part_copy(void *arg) {
+    struct strmerge_part_t *part = arg;
+    char *at = part->out + part->offset;
+    size_t index = part->index;
+
+    for (size_t i = part->from; i < part->to; ++i) {
+        const char *element = strmerge_part_element(part, i);
+        if (element == NULL) {
+            continue;
+        }
+
+        if (index++ > 0) {
+            memcpy(at, part->separator, part->separator_len);
+            at += part->separator_len;
+        }
+
+        size_t len = strlen(element);
+        memcpy(at, element, len);
+        at += len;
+    }
+
+    return NULL;
+}
+
+// runs `job` over every part, the calling thread takes the first one.
+static void strmerge_parts_run(struct strmerge_part_t *parts, size_t n, void *(*job)(void*)) {
+    pthread_t threads[STRMERGE_PARALLEL_MAX_THREADS];
+    LCOMMON_BOOL started[STRMERGE_PARALLEL_MAX_THREADS];
+
+    for (size_t i = 1; i < n; ++i) {
+        started[i] = pthread_create(&threads[i], NULL, job, &parts[i]) == 0;
+    }
+
+    job(&parts[0]);
+
+    for (size_t i = 1; i < n; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            job(&parts[i]);
+        }
+    }
+}
+
+static char *strmerge_parallel(
+    const char *separator,
+    void **elements,
+    size_t len,
+    LCOMMON_BOOL optional,
+    size_t threads
+) {
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t) cpus : 1;
+    }
+
+    if (threads > STRMERGE_PARALLEL_MAX_THREADS) {
+        threads = STRMERGE_PARALLEL_MAX_THREADS;
+    }
+
+    if (threads > len / (STRMERGE_PARALLEL_MIN_ELEMENTS / 2)) {
+        threads = len / (STRMERGE_PARALLEL_MIN_ELEMENTS / 2);
+    }
+
+    if (threads <= 1) {
+        return NULL;
+    }
+
+    TRACE_BEGIN(TRACE_STRMERGE, 0);
+
+    struct strmerge_part_t parts[STRMERGE_PARALLEL_MAX_THREADS];
+    size_t separator_len = strlen(separator);
+
+    for (size_t i = 0; i < threads; ++i) {
+        parts[i] = (struct strmerge_part_t) {
+            .elements = elements,
+            .optional = optional,
+            .from = len * i / threads,
+            .to = len * (i + 1) / threads,
+            .separator = separator,
+            .separator_len = separator_len,
+        };
+    }
+
+    strmerge_parts_run(parts, threads, strmerge_part_measure);
+
+    // prefix sum over the parts, a part starts with the separator before its first element.
+    size_t bytes = 0;
+    size_t count = 0;
+
+    for (size_t i = 0; i < threads; ++i) {
+        parts[i].index = count;
+        parts[i].offset = count > 0 ? bytes + (count - 1) * separator_len : 0;
+        bytes += parts[i].bytes;
+        count += parts[i].count;
+    }
+
+    size_t total = count > 0 ? bytes + (count - 1) * separator_len : 0;
+    char *out = Common_smalloc(total + 1);
+
+    for (size_t i = 0; i < threads; ++i) {
+        parts[i].out = out;
+    }
+
+    strmerge_parts_run(parts, threads, strmerge_part_copy);
+    out[total] = '\0';
+
+    TRACE_END(TRACE_STRMERGE, total);
+
+    return out;
+}
+
+char *Common_strmerge_from_array_parallel(
+    const char *separator,
+    const DynamicArray dynamic_array,
+    size_t threads
+) {
+    char *merged = strmerge_parallel(separator, dynamic_array->elements, dynamic_array->len, LCOMMON_FALSE, threads);
+    return merged != NULL ? merged : Common_strmerge_from_array(separator, dynamic_array);
+}
+
+char *Common_strmerge_from_optional_array_parallel(
+    const char *separator,
+    const OptionalArray optional_array,
+    size_t threads
+) {
+    char *merged = strmerge_parallel(separator, (void**) optional_array->elements, optional_array->len, LCOMMON_TRUE, threads);
+    return merged != NULL ? merged : Common_strmerge_from_optional_array(separator, optional_array);
+}
+
+
+// numeric parsing
+
+static inline LCOMMON_BOOL parse_is_digit(char c) {
+    return (unsigned char) (c - '0') < 10;
+}
+
+static inline uint64_t parse_load8(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// checks if the 8 bytes loaded in `v` are all ascii digits.
+static inline LCOMMON_BOOL parse_is_eight_digits(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+        == 0x3333333333333333;
+}
+
+// converts 8 ascii digits loaded little endian into their value with three multiplications,
+// pairs of digits are combined first, then pairs of pairs and finally both halves.
+static inline uint32_t parse_eight_digits(uint64_t v) {
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 100 + (1000000ULL << 32);
+    const uint64_t mul2 = 1 + (10000ULL << 32);
+
+    v -= 0x3030303030303030;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+
+    return (uint32_t) v;
+}
+
+// reads the digits at `*p` into `*value`, returns LCOMMON_FALSE if they don't fit into
+// 64 bits. `*p` is left at the first non digit byte.
+static LCOMMON_BOOL parse_digits(const char **p, const char *end, uint64_t *value) {
+    const char *at = *p;
+    uint64_t v = 0;
+
+    // 16 digits can't overflow, so the first two chunks go without checks.
+    for (int chunk = 0; chunk < 2 && end - at >= 8; ++chunk) {
+        uint64_t word = parse_load8(at);
+        if (!parse_is_eight_digits(word)) {
+            break;
+        }
+
+        v = v * 100000000 + parse_eight_digits(word);
+        at += 8;
+    }
+
+    for (; at < end && parse_is_digit(*at); ++at) {
+        if (__builtin_mul_overflow(v, 10, &v) || __builtin_add_overflow(v, (uint64_t) (*at - '0'), &v)) {
+            return LCOMMON_FALSE;
+        }
+    }
+
+    *p = at;
+    *value = v;
+
+    return LCOMMON_TRUE;
+}
+
+ParsedUint Common_parse_uint(const char *s, size_t len) {
+    const char *p = s;
+    const char *end = s + len;
+
+    if (p < end && *p == '+') {
+        p++;
+    }
+
+    const char *digits = p;
+    uint64_t value;
+
+    if (!parse_digits(&p, end, &value) || p == digits) {
+        return (ParsedUint) { .is_none = LCOMMON_TRUE };
+    }
+
+    return (ParsedUint) { value, (size_t) (p - s), LCOMMON_FALSE };
+}
+
+ParsedInt Common_parse_int(const char *s, size_t len) {
+    const char *p = s;
+    const char *end = s + len;
+    LCOMMON_BOOL negative = LCOMMON_FALSE;
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    const char *digits = p;
+    uint64_t magnitude;
+
+    if (!parse_digits(&p, end, &magnitude) || p == digits) {
+        return (ParsedInt) { .is_none = LCOMMON_TRUE };
+    }
+
+    uint64_t limit = (uint64_t) INT64_MAX + negative;
+    if (magnitude > limit) {
+        return (ParsedInt) { .is_none = LCOMMON_TRUE };
+    }
+
+    long long value = negative ? (long long) (0 - magnitude) : (long long) magnitude;
+
+    return (ParsedInt) { value, (size_t) (p - s), LCOMMON_FALSE };
+}
+
+// matches a case insensitive ascii word at `p`.
+static inline LCOMMON_BOOL parse_match_word(const char *p, const char *end, const char *word) {
+    size_t len = strlen(word);
+    if ((size_t) (end - p) < len) {
+        return LCOMMON_FALSE;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        if ((p[i] | 0x20) != word[i]) {
+            return LCOMMON_FALSE;
+        }
+    }
+
+    return LCOMMON_TRUE;
+}
+
+static locale_t parse_c_locale(void) {
+    static locale_t c_locale = (locale_t) 0;
+
+    locale_t current = __atomic_load_n(&c_locale, __ATOMIC_ACQUIRE);
+    if (current != (locale_t) 0) {
+        return current;
+    }
+
+    locale_t created = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+    if (created == (locale_t) 0) {
+        die("newlocale");
+    }
+
+    locale_t expected = (locale_t) 0;
+    if (!__atomic_compare_exchange_n(&c_locale, &expected, created, LCOMMON_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        freelocale(created);
+        return expected;
+    }
+
+    return created;
+}
+
+// correctly rounded conversion for the numbers the fast path can't handle exactly. The
+// text has already been validated, so strtod_l() consumes the very same bytes.
+static double parse_double_slow(const char *s, size_t len) {
+    char small[64];
+    char *copy = len < sizeof(small) ? small : Common_smalloc(len + 1);
+
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+
+    double value = strtod_l(copy, NULL, parse_c_locale());
+
+    if (copy != small) {
+        LCOMMON_FREE(copy);
+    }
+
+    return value;
+}
+
+ParsedDouble Common_parse_double(const char *s, size_t len) {
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char *p = s;
+    const char *end = s + len;
+    LCOMMON_BOOL negative = LCOMMON_FALSE;
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    const char *unsigned_start = p;
+
+    if (parse_match_word(p, end, "inf")) {
+        p += parse_match_word(p, end, "infinity") ? 8 : 3;
+        return (ParsedDouble) { negative ? -__builtin_inf() : __builtin_inf(), (size_t) (p - s), LCOMMON_FALSE };
+    }
+
+    if (parse_match_word(p, end, "nan")) {
+        return (ParsedDouble) { negative ? -__builtin_nan("") : __builtin_nan(""), (size_t) (p + 3 - s), LCOMMON_FALSE };
+    }
+
+    // up to 19 significant digits fit into the mantissa, the rest only move the exponent.
+    uint64_t mantissa = 0;
+    int significant = 0;
+    long exponent = 0;
+    LCOMMON_BOOL truncated = LCOMMON_FALSE;
+    LCOMMON_BOOL any_digit = LCOMMON_FALSE;
+
+    for (int fraction = 0; fraction < 2; ++fraction) {
+        if (fraction) {
+            if (p >= end || *p != '.') {
+                break;
+            }
+            p++;
+        }
+
+        while (p < end) {
+            if (mantissa != 0 && significant <= 11 && end - p >= 8) {
+                uint64_t word = parse_load8(p);
+                if (parse_is_eight_digits(word)) {
+                    mantissa = mantissa * 100000000 + parse_eight_digits(word);
+                    significant += 8;
+                    exponent -= fraction ? 8 : 0;
+                    any_digit = LCOMMON_TRUE;
+                    p += 8;
+                    continue;
+                }
+            }
+
+            if (!parse_is_digit(*p)) {
+                break;
+            }
+
+            int digit = *p++ - '0';
+            any_digit = LCOMMON_TRUE;
+
+            if (mantissa == 0 && digit == 0) {
+                exponent -= fraction;
+            } else if (significant < 19) {
+                mantissa = mantissa * 10 + (uint64_t) digit;
+                significant++;
+                exponent -= fraction;
+            } else {
+                exponent += !fraction;
+                truncated |= digit != 0;
+            }
+        }
+    }
+
+    if (!any_digit) {
+        return (ParsedDouble) { .is_none = LCOMMON_TRUE };
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *at = p + 1;
+        LCOMMON_BOOL negative_exponent = LCOMMON_FALSE;
+
+        if (at < end && (*at == '+' || *at == '-')) {
+            negative_exponent = *at == '-';
+            at++;
+        }
+
+        // only consuming the exponent when it has digits, "1e" is just 1.
+        if (at < end && parse_is_digit(*at)) {
+            long explicit_exponent = 0;
+            for (; at < end && parse_is_digit(*at); ++at) {
+                if (explicit_exponent < 100000) {
+                    explicit_exponent = explicit_exponent * 10 + (*at - '0');
+                }
+            }
+
+            exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+            p = at;
+        }
+    }
+
+    size_t consumed = (size_t) (p - s);
+    double value;
+
+    if (mantissa == 0) {
+        value = 0.0;
+    } else if (!truncated && mantissa <= ((uint64_t) 1 << 53) && exponent >= -22 && exponent <= 22) {
+        // both the mantissa and the power of ten are exact doubles, so a single
+        // multiplication or division rounds correctly.
+        value = exponent < 0
+            ? (double) mantissa / powers_of_ten[-exponent]
+            : (double) mantissa * powers_of_ten[exponent];
+    } else {
+        value = parse_double_slow(unsigned_start, (size_t) (p - unsigned_start));
+
+        if (value == __builtin_inf()) {
+            return (ParsedDouble) { .is_none = LCOMMON_TRUE };
+        }
+    }
+
+    return (ParsedDouble) { negative ? -value : value, consumed, LCOMMON_FALSE };
+}
+
+size_t Common_parse_ints(
+    const char *s,
+    size_t len,
+    char separator,
+    long long *out,
+    size_t out_cap,
+    size_t *consumed
+) {
+    size_t count = 0;
+    size_t at = 0;
+    size_t parsed_until = 0;
+
+    while (count < out_cap && at < len) {
+        ParsedInt parsed = Common_parse_int(s + at, len - at);
+        if (parsed.is_none) {
+            break;
+        }
+
+        out[count++] = parsed.value;
+        at += parsed.consumed;
+        parsed_until = at;
+
+        if (at >= len || s[at] != separator) {
+            break;
+        }
+
+        at++;
+    }
+
+    if (consumed != NULL) {
+        *consumed = parsed_until;
+    }
+
+    return count;
+}
+
+size_t Common_parse_doubles(
+    const char *s,
+    size_t len,
+    char separator,
+    double *out,
+    size_t out_cap,
+    size_t *consumed
+) {
+    size_t count = 0;
+    size_t at = 0;
+    size_t parsed_until = 0;
+
+    while (count < out_cap && at < len) {
+        ParsedDouble parsed = Common_parse_double(s + at, len - at);
+        if (parsed.is_none) {
+            break;
+        }
+
+        out[count++] = parsed.value;
+        at += parsed.consumed;
+        parsed_until = at;
+
+        if (at >= len || s[at] != separator) {
+            break;
+        }
+
+        at++;
+    }
+
+    if (consumed != NULL) {
+        *consumed = parsed_until;
+    }
+
+    return count;
+}
+
+
+// substring search
+
+// needles up to this length go through the first/last byte filter.
+#define SEARCH_SHORT_NEEDLE 32
+
+#define SEARCH_BITOP(set, byte, op) \
+    ((set)[(size_t) (byte) / (8 * sizeof(*(set)))] op ((size_t) 1 << ((size_t) (byte) % (8 * sizeof(*(set))))))
+
+// Crochemore-Perrin two-way matching: the needle is cut at its critical factorization,
+// the right half is compared first and on mismatch the haystack advances by either the
+// mismatch position or the needle period, which keeps the search linear. A bad character
+// shift on the last byte is used to skip ahead quickly on random text.
+//
+// returns the position of the first match or SIZE_MAX. With `reverse` the haystack is read
+// from its end, so a reversed needle finds the last occurrence.
+#define SEARCH_HAYSTACK(i) (reverse ? h[h_len - 1 - (i)] : h[i])
+
+static inline __attribute__((always_inline)) size_t search_two_way(
+    const unsigned char *h,
+    size_t h_len,
+    const unsigned char *n,
+    size_t l,
+    LCOMMON_BOOL reverse
+) {
+    size_t byteset[32 / sizeof(size_t)] = {0};
+    size_t shift[256];
+
+    for (size_t i = 0; i < l; ++i) {
+        SEARCH_BITOP(byteset, n[i], |=);
+        shift[n[i]] = i + 1;
+    }
+
+    // maximal suffix for `<`.
+    size_t ip = (size_t) -1, jp = 0, k = 1, p = 1;
+    while (jp + k < l) {
+        if (n[ip + k] == n[jp + k]) {
+            if (k == p) {
+                jp += p;
+                k = 1;
+            } else {
+                k++;
+            }
+        } else if (n[ip + k] > n[jp + k]) {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+        } else {
+            ip = jp++;
+            k = p = 1;
+        }
+    }
+
+    size_t ms = ip;
+    size_t p0 = p;
+
+    // and for `>`, the longest of both is the critical factorization.
+    ip = (size_t) -1, jp = 0, k = p = 1;
+    while (jp + k < l) {
+        if (n[ip + k] == n[jp + k]) {
+            if (k == p) {
+                jp += p;
+                k = 1;
+            } else {
+                k++;
+            }
+        } else if (n[ip + k] < n[jp + k]) {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+        } else {
+            ip = jp++;
+            k = p = 1;
+        }
+    }
+
+    if (ip + 1 > ms + 1) {
+        ms = ip;
+    } else {
+        p = p0;
+    }
+
+    // periodic needles remember how much of the left half already matched.
+    size_t mem0;
+    if (memcmp(n, n + p, ms + 1) != 0) {
+        mem0 = 0;
+        p = (ms > l - ms - 1 ? ms : l - ms - 1) + 1;
+    } else {
+        mem0 = l - p;
+    }
+
+    size_t mem = 0;
+    size_t at = 0;
+
+    for (;;) {
+        if (h_len - at < l) {
+            return SIZE_MAX;
+        }
+
+        unsigned char last = SEARCH_HAYSTACK(at + l - 1);
+        if (SEARCH_BITOP(byteset, last, &)) {
+            k = l - shift[last];
+            if (k) {
+                at += k < mem ? mem : k;
+                mem = 0;
+                continue;
+            }
+        } else {
+            at += l;
+            mem = 0;
+            continue;
+        }
+
+        // right half.
+        for (k = ms + 1 > mem ? ms + 1 : mem; k < l && n[k] == SEARCH_HAYSTACK(at + k); k++);
+        if (k < l) {
+            at += k - ms;
+            mem = 0;
+            continue;
+        }
+
+        // left half.
+        for (k = ms + 1; k > mem && n[k - 1] == SEARCH_HAYSTACK(at + k - 1); k--);
+        if (k <= mem) {
+            return at;
+        }
+
+        at += p;
+        mem = mem0;
+    }
+}
+
+#undef SEARCH_HAYSTACK
+
+static inline LCOMMON_BOOL search_matches_at(const char *at, const char *needle, size_t needle_len) {
+    // first and last bytes are already known to match.
+    return needle_len <= 2 || memcmp(at + 1, needle + 1, needle_len - 2) == 0;
+}
+
+static const char *search_forward_scalar(const char *h, size_t h_len, const char *n, size_t n_len, size_t from) {
+    for (size_t i = from; i + n_len <= h_len; ++i) {
+        if (h[i] == n[0] && h[i + n_len - 1] == n[n_len - 1] && search_matches_at(h + i, n, n_len)) {
+            return h + i;
+        }
+    }
+
+    return NULL;
+}
+
+static const char *search_backward_scalar(const char *h, const char *n, size_t n_len, size_t until) {
+    for (size_t i = until; i > 0; --i) {
+        const char *at = h + i - 1;
+        if (at[0] == n[0] && at[n_len - 1] == n[n_len - 1] && search_matches_at(at, n, n_len)) {
+            return at;
+        }
+    }
+
+    return NULL;
+}
+
+#if LCOMMON_HAVE_X86_SIMD
+
+// first/last byte filter: every candidate position whose first and last bytes match the
+// needle ones sets a bit in the mask and only those get fully compared.
+#define SEARCH_FILTER(vector, width, set1, loadu, cmpeq, and, movemask, target_attr) \
+    target_attr \
+    static const char *search_forward_##width(const char *h, size_t h_len, const char *n, size_t n_len) { \
+        const vector first = set1(n[0]); \
+        const vector last = set1(n[n_len - 1]); \
+        size_t i = 0; \
+        \
+        for (; i + n_len - 1 + width <= h_len; i += width) { \
+            vector block_first = loadu((const vector*) (h + i)); \
+            vector block_last = loadu((const vector*) (h + i + n_len - 1)); \
+            uint32_t mask = (uint32_t) movemask(and(cmpeq(first, block_first), cmpeq(last, block_last))); \
+            \
+            for (; mask != 0; mask &= mask - 1) { \
+                const char *at = h + i + __builtin_ctz(mask); \
+                if (search_matches_at(at, n, n_len)) { \
+                    return at; \
+                } \
+            } \
+        } \
+        \
+        return search_forward_scalar(h, h_len, n, n_len, i); \
+    } \
+    \
+    target_attr \
+    static const char *search_backward_##width(const char *h, size_t h_len, const char *n, size_t n_len) { \
+        const vector first = set1(n[0]); \
+        const vector last = set1(n[n_len - 1]); \
+        /* candidates are the positions [0, until). */ \
+        size_t until = h_len - n_len + 1; \
+        \
+        for (; until >= width; until -= width) { \
+            const char *block = h + until - width; \
+            vector block_first = loadu((const vector*) block); \
+            vector block_last = loadu((const vector*) (block + n_len - 1)); \
+            uint32_t mask = (uint32_t) movemask(and(cmpeq(first, block_first), cmpeq(last, block_last))); \
+            \
+            while (mask != 0) { \
+                int bit = 31 - __builtin_clz(mask); \
+                if (search_matches_at(block + bit, n, n_len)) { \
+                    return block + bit; \
+                } \
+                mask &= ~(1u << bit); \
+            } \
+        } \
+        \
+        return search_backward_scalar(h, n, n_len, until); \
+    }
+
+SEARCH_FILTER(__m128i, 16, _mm_set1_epi8, _mm_loadu_si128, _mm_cmpeq_epi8, _mm_and_si128, _mm_movemask_epi8, )
+SEARCH_FILTER(__m256i, 32, _mm256_set1_epi8, _mm256_loadu_si256, _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_movemask_epi8, __attribute__((target("avx2"))))
+
+#endif
+
+const char *Common_memfind(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    if (needle_len == 0) {
+        return haystack;
+    }
+
+    if (needle_len > haystack_len) {
+        return NULL;
+    }
+
+    if (needle_len == 1) {
+        return memchr(haystack, needle[0], haystack_len);
+    }
+
+    if (needle_len > SEARCH_SHORT_NEEDLE) {
+        size_t at = search_two_way(
+            (const unsigned char*) haystack,
+            haystack_len,
+            (const unsigned char*) needle,
+            needle_len,
+            LCOMMON_FALSE
+        );
+
+        return at != SIZE_MAX ? haystack + at : NULL;
+    }
+
+#if LCOMMON_HAVE_X86_SIMD
+    if (simd_has_avx2()) {
+        return search_forward_32(haystack, haystack_len, needle, needle_len);
+    }
+
+    return search_forward_16(haystack, haystack_len, needle, needle_len);
+#else
+    return search_forward_scalar(haystack, haystack_len, needle, needle_len, 0);
+#endif
+}
+
+const char *Common_memrfind(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    if (needle_len == 0) {
+        return haystack + haystack_len;
+    }
+
+    if (needle_len > haystack_len) {
+        return NULL;
+    }
+
+    if (needle_len == 1) {
+        return memrchr(haystack, needle[0], haystack_len);
+    }
+
+    // the last occurrence is the first one of the reversed needle in the reversed haystack.
+    if (needle_len > SEARCH_SHORT_NEEDLE) {
+        unsigned char *reversed = Common_smalloc(needle_len);
+        for (size_t i = 0; i < needle_len; ++i) {
+            reversed[i] = (unsigned char) needle[needle_len - 1 - i];
+        }
+
+        size_t at = search_two_way((const unsigned char*) haystack, haystack_len, reversed, needle_len, LCOMMON_TRUE);
+        LCOMMON_FREE(reversed);
+
+        return at != SIZE_MAX ? haystack + haystack_len - at - needle_len : NULL;
+    }
+
+#if LCOMMON_HAVE_X86_SIMD
+    if (simd_has_avx2()) {
+        return search_backward_32(haystack, haystack_len, needle, needle_len);
+    }
+
+    return search_backward_16(haystack, haystack_len, needle, needle_len);
+#else
+    return search_backward_scalar(haystack, needle, needle_len, haystack_len - needle_len + 1);
+#endif
+}
+
+Optional Common_strfind(const char *haystack, const char *needle) {
+    return Common_optional_from((void*) Common_memfind(haystack, strlen(haystack), needle, strlen(needle)));
+}
+
+Optional Common_strrfind(const char *haystack, const char *needle) {
+    return Common_optional_from((void*) Common_memrfind(haystack, strlen(haystack), needle, strlen(needle)));
+}
+
+LCOMMON_BOOL Common_strcontains(const char *haystack, const char *needle) {
+    return Common_memfind(haystack, strlen(haystack), needle, strlen(needle)) != NULL;
+}
+
+size_t Common_strcount_occurrences(const char *haystack, const char *needle) {
+    size_t needle_len = strlen(needle);
+    LCOMMON_ASSERT(needle_len > 0, "needle shouldn't be empty");
+
+    const char *end = haystack + strlen(haystack);
+    const char *at = haystack;
+    size_t count = 0;
+
+    while ((at = Common_memfind(at, (size_t) (end - at), needle, needle_len)) != NULL) {
+        count++;
+        at += needle_len;
+    }
+
+    return count;
+}
+
+char *Common_strreplace(const char *s, const char *from, const char *to) {
+    size_t from_len = strlen(from);
+    size_t to_len = strlen(to);
+    LCOMMON_ASSERT(from_len > 0, "the replaced string shouldn't be empty");
+
+    size_t s_len = strlen(s);
+    size_t occurrences = 0;
+    const char *end = s + s_len;
+
+    for (const char *at = s; (at = Common_memfind(at, (size_t) (end - at), from, from_len)) != NULL; at += from_len) {
+        occurrences++;
+    }
+
+    char *result = Common_smalloc(s_len - occurrences * from_len + occurrences * to_len + 1);
+    char *out = result;
+    const char *cur = s;
+
+    for (size_t i = 0; i < occurrences; ++i) {
+        const char *at = Common_memfind(cur, (size_t) (end - cur), from, from_len);
+
+        memcpy(out, cur, (size_t) (at - cur));
+        out += at - cur;
+        memcpy(out, to, to_len);
+        out += to_len;
+        cur = at + from_len;
+    }
+
+    memcpy(out, cur, (size_t) (end - cur) + 1);
+
+    return result;
+}
+
+DynamicArray Common_strsplit(const char *s, const char *separator) {
+    size_t separator_len = strlen(separator);
+    LCOMMON_ASSERT(separator_len > 0, "separator shouldn't be empty");
+
+    DynamicArray pieces = Common_dynamic_array_init();
+    const char *end = s + strlen(s);
+    const char *cur = s;
+
+    for (;;) {
+        const char *at = Common_memfind(cur, (size_t) (end - cur), separator, separator_len);
+        const char *piece_end = at != NULL ? at : end;
+
+        char *piece = Common_smalloc((size_t) (piece_end - cur) + 1);
+        memcpy(piece, cur, (size_t) (piece_end - cur));
+        piece[piece_end - cur] = '\0';
+        Common_dynamic_array_append(pieces, piece);
+
+        if (at == NULL) {
+            break;
+        }
+
+        cur = at + separator_len;
+    }
+
+    return pieces;
+}
+
+
+// hashing
+
+static const uint64_t hash_secret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+// 64x64 -> 128 multiplication, low half in `a` and high half in `b`.
+static inline void hash_mum(uint64_t *a, uint64_t *b) {
+    unsigned __int128 r = (unsigned __int128) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t hash_read8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hash_read4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hash_seed(uint64_t seed) {
+    return seed ^ hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+}
+
+static inline uint64_t hash_final(uint64_t a, uint64_t b, uint64_t seed, uint64_t len) {
+    a ^= hash_secret[1];
+    b ^= seed;
+    hash_mum(&a, &b);
+    return hash_mix(a ^ hash_secret[0] ^ len, b ^ hash_secret[1]);
+}
+
+// keys up to 16 bytes are read with (possibly overlapping) 4 byte loads.
+static inline uint64_t hash_short(const uint8_t *p, size_t len, uint64_t seed) {
+    uint64_t a = 0;
+    uint64_t b = 0;
+
+    if (len >= 4) {
+        size_t middle = (len >> 3) << 2;
+        a = (hash_read4(p) << 32) | hash_read4(p + middle);
+        b = (hash_read4(p + len - 4) << 32) | hash_read4(p + len - 4 - middle);
+    } else if (len > 0) {
+        a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+    }
+
+    return hash_final(a, b, seed, len);
+}
+
+// consumes 48 bytes in three independent lanes.
+static inline void hash_stripe(const uint8_t *p, uint64_t *seed, uint64_t *see1, uint64_t *see2) {
+    *seed = hash_mix(hash_read8(p) ^ hash_secret[1], hash_read8(p + 8) ^ *seed);
+    *see1 = hash_mix(hash_read8(p + 16) ^ hash_secret[2], hash_read8(p + 24) ^ *see1);
+    *see2 = hash_mix(hash_read8(p + 32) ^ hash_secret[3], hash_read8(p + 40) ^ *see2);
+}
+
+// finishes a key longer than 16 bytes whose last `left` bytes start at `p`. The 16 bytes
+// before `p` must be readable, they're part of the key when `left` < 16.
+static inline uint64_t hash_long(
+    const uint8_t *p,
+    size_t left,
+    uint64_t seed,
+    uint64_t see1,
+    uint64_t see2,
+    uint64_t total_len
+) {
+    if (total_len >= 48) {
+        for (; left >= 48; left -= 48, p += 48) {
+            hash_stripe(p, &seed, &see1, &see2);
+        }
+
+        seed ^= see1 ^ see2;
+    }
+
+    for (; left > 16; left -= 16, p += 16) {
+        seed = hash_mix(hash_read8(p) ^ hash_secret[1], hash_read8(p + 8) ^ seed);
+    }
+
+    return hash_final(hash_read8(p + left - 16), hash_read8(p + left - 8), seed, total_len);
+}
+
+unsigned long long Common_hash_bytes(const void *data, size_t len, unsigned long long seed) {
+    uint64_t s = hash_seed(seed);
+
+    if (len <= 16) {
+        return hash_short(data, len, s);
+    }
+
+    return hash_long(data, len, s, s, s, len);
+}
+
+unsigned long long Common_hash_str_len(const char *s, unsigned long long seed, size_t *len) {
+    const uint8_t *p = (const uint8_t*) s;
+    uint64_t hash_seed_value = hash_seed(seed);
+    uint64_t see1 = hash_seed_value;
+    uint64_t see2 = hash_seed_value;
+
+    // a stripe is consumed as soon as we know 48 more bytes follow, which is exactly
+    // what `Common_hash_bytes()` would do knowing the length up front.
+    size_t left;
+    while ((left = strnlen((const char*) p, 48)) == 48) {
+        hash_stripe(p, &hash_seed_value, &see1, &see2);
+        p += 48;
+    }
+
+    size_t total_len = (size_t) (p - (const uint8_t*) s) + left;
+    if (len != NULL) {
+        *len = total_len;
+    }
+
+    if (total_len <= 16) {
+        return hash_short((const uint8_t*) s, total_len, hash_seed_value);
+    }
+
+    return hash_long(p, left, hash_seed_value, see1, see2, total_len);
+}
+
+unsigned long long Common_hash_str(const char *s, unsigned long long seed) {
+    return Common_hash_str_len(s, seed, NULL);
+}
+
+unsigned long long Common_hash_u64(unsigned long long value, unsigned long long seed) {
+    uint64_t a = value ^ hash_secret[0];
+    uint64_t b = seed ^ hash_secret[1];
+
+    hash_mum(&a, &b);
+
+    return hash_mix(a ^ hash_secret[0], b ^ hash_secret[1]);
+}
+
+#define HASH_STREAM_DATA(stream) ((stream)->buffer + 16)
+
+void Common_hash_stream_init(HashStream *stream, unsigned long long seed) {
+    memset(stream, 0, sizeof(HashStream));
+    stream->seed = stream->see1 = stream->see2 = hash_seed(seed);
+}
+
+void Common_hash_stream_update(HashStream *stream, const void *data, size_t len) {
+    const uint8_t *p = data;
+    stream->total_len += len;
+
+    // stripes are only consumed when more bytes follow them, the last (up to) 48 bytes
+    // are always kept around for the digest.
+    if (stream->buffered + len <= 48) {
+        memcpy(HASH_STREAM_DATA(stream) + stream->buffered, p, len);
+        stream->buffered += len;
+        return;
+    }
+
+    uint64_t seed = stream->seed, see1 = stream->see1, see2 = stream->see2;
+
+    if (stream->buffered > 0) {
+        size_t fill = 48 - stream->buffered;
+        memcpy(HASH_STREAM_DATA(stream) + stream->buffered, p, fill);
+        p += fill;
+        len -= fill;
+
+        hash_stripe(HASH_STREAM_DATA(stream), &seed, &see1, &see2);
+        memcpy(stream->buffer, HASH_STREAM_DATA(stream) + 32, 16);
+    }
+
+    if (len > 48) {
+        for (; len > 48; len -= 48, p += 48) {
+            hash_stripe(p, &seed, &see1, &see2);
+        }
+
+        memcpy(stream->buffer, p - 16, 16);
+    }
+
+    memcpy(HASH_STREAM_DATA(stream), p, len);
+    stream->buffered = len;
+    stream->seed = seed, stream->see1 = see1, stream->see2 = see2;
+}
+
+unsigned long long Common_hash_stream_digest(const HashStream *stream) {
+    if (stream->total_len <= 16) {
+        return hash_short(HASH_STREAM_DATA(stream), stream->buffered, stream->seed);
+    }
+
+    return hash_long(
+        HASH_STREAM_DATA(stream),
+        stream->buffered,
+        stream->seed,
+        stream->see1,
+        stream->see2,
+        stream->total_len
+    );
+}
+
+
+// utf-8 helpers
+
+// length of the well formed sequence starting at `p`, or 0 if it's invalid.
+static inline size_t utf8_sequence_len(const unsigned char *p, const unsigned char *end) {
+    unsigned char c = p[0];
+    if (c < 0x80) {
+        return 1;
+    }
+
+    size_t len;
+    uint32_t codepoint;
+    uint32_t min;
+
+    if ((c & 0xE0) == 0xC0) {
+        len = 2, codepoint = c & 0x1F, min = 0x80;
+    } else if ((c & 0xF0) == 0xE0) {
+        len = 3, codepoint = c & 0x0F, min = 0x800;
+    } else if ((c & 0xF8) == 0xF0) {
+        len = 4, codepoint = c & 0x07, min = 0x10000;
+    } else {
+        return 0;
+    }
+
+    if ((size_t) (end - p) < len) {
+        return 0;
+    }
+
+    for (size_t i = 1; i < len; ++i) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+
+        codepoint = (codepoint << 6) | (p[i] & 0x3F);
+    }
+
+    if (codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        return 0;
+    }
+
+    return len;
+}
+
+static inline LCOMMON_BOOL utf8_is_continuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+static LCOMMON_BOOL utf8_validate_scalar(const unsigned char *s, size_t len) {
+    const unsigned char *p = s;
+    const unsigned char *end = s + len;
+
+    while (p < end) {
+        // skipping ascii 8 bytes at a time.
+        if (end - p >= 8) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            if ((word & 0x8080808080808080) == 0) {
+                p += 8;
+                continue;
+            }
+        }
+
+        size_t sequence_len = utf8_sequence_len(p, end);
+        if (sequence_len == 0) {
+            return LCOMMON_FALSE;
+        }
+
+        p += sequence_len;
+    }
+
+    return LCOMMON_TRUE;
+}
+
+static size_t utf8_count_scalar(const unsigned char *s, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; ++i) {
+        count += !utf8_is_continuation(s[i]);
+    }
+
+    return count;
+}
+
+static LCOMMON_BOOL utf8_offset_of_scalar(const unsigned char *s, size_t len, size_t n, size_t *offset) {
+    for (size_t i = 0; i < len; ++i) {
+        if (!utf8_is_continuation(s[i]) && n-- == 0) {
+            *offset = i;
+            return LCOMMON_TRUE;
+        }
+    }
+
+    if (n == 0) {
+        *offset = len;
+        return LCOMMON_TRUE;
+    }
+
+    return LCOMMON_FALSE;
+}
+
+static Utf8Measure utf8_measure_scalar(const unsigned char *s) {
+    Utf8Measure ret = { .is_valid = LCOMMON_TRUE };
+    const unsigned char *p = s;
+
+    while (*p != '\0') {
+        if (*p < 0x80) {
+            ret.codepoints++;
+            p++;
+            continue;
+        }
+
+        // the terminator stops any truncated sequence before it's read past, so the
+        // sequence can be checked without knowing the length.
+        size_t sequence_len = utf8_sequence_len(p, p + 4);
+
+        if (sequence_len == 0) {
+            ret.is_valid = LCOMMON_FALSE;
+            ret.codepoints += !utf8_is_continuation(*p);
+            p++;
+            continue;
+        }
+
+        ret.codepoints++;
+        p += sequence_len;
+    }
+
+    ret.bytes = (size_t) (p - s);
+    return ret;
+}
+
+#if LCOMMON_HAVE_X86_SIMD
+
+// vectorized validation from "Validating UTF-8 In Less Than One Instruction Per Byte"
+// (Keiser & Lemire): every byte is classified by looking up the high and low nibbles of
+// the previous byte and the high nibble of the current one, the three lookups are and'ed
+// together and any remaining bit flags an error.
+
+#define UTF8_TOO_SHORT (1 << 0)
+#define UTF8_TOO_LONG (1 << 1)
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTS (1 << 7)
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_high_nibbles(__m256i v) {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+// bytes of `input` shifted by N positions, pulling the last bytes of `prev_input` in.
+#define UTF8_PREV(input, prev_input, n) \
+    _mm256_alignr_epi8((input), _mm256_permute2x128_si256((prev_input), (input), 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_check_block(__m256i input, __m256i prev_input) {
+    const __m256i byte_1_high_table = UTF8_TABLE(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+    );
+
+    const __m256i byte_1_low_table = UTF8_TABLE(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+    );
+
+    const __m256i byte_2_high_table = UTF8_TABLE(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+    );
+
+    __m256i prev1 = UTF8_PREV(input, prev_input, 1);
+
+    __m256i special_cases = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(byte_1_high_table, utf8_high_nibbles(prev1)),
+            _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))
+        ),
+        _mm256_shuffle_epi8(byte_2_high_table, utf8_high_nibbles(input))
+    );
+
+    // third and fourth bytes of a sequence must be continuations, that's the only case
+    // the lookups above can't see.
+    __m256i is_third_byte = _mm256_subs_epu8(UTF8_PREV(input, prev_input, 2), _mm256_set1_epi8((char) (0xE0 - 0x80)));
+    __m256i is_fourth_byte = _mm256_subs_epu8(UTF8_PREV(input, prev_input, 3), _mm256_set1_epi8((char) (0xF0 - 0x80)));
+    __m256i must_be_continuation = _mm256_and_si256(
+        _mm256_or_si256(is_third_byte, is_fourth_byte),
+        _mm256_set1_epi8((char) 0x80)
+    );
+
+    return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+__attribute__((target("avx2")))
+static LCOMMON_BOOL utf8_validate_avx2(const unsigned char *s, size_t len) {
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*) (s + i));
+
+        // pure ascii blocks are valid on their own, checking it against the previous
+        // block is only needed to catch a sequence cut by this one.
+        if (_mm256_movemask_epi8(input) == 0 && _mm256_movemask_epi8(prev_input) == 0) {
+            prev_input = input;
+            continue;
+        }
+
+        error = _mm256_or_si256(error, utf8_check_block(input, prev_input));
+        prev_input = input;
+    }
+
+    if (i < len) {
+        unsigned char tail[32] = {0};
+        memcpy(tail, s + i, len - i);
+
+        __m256i input = _mm256_loadu_si256((const __m256i*) tail);
+        error = _mm256_or_si256(error, utf8_check_block(input, prev_input));
+        prev_input = input;
+    }
+
+    // an all zeroes block flags any sequence truncated by the end of the buffer.
+    error = _mm256_or_si256(error, utf8_check_block(_mm256_setzero_si256(), prev_input));
+
+    return _mm256_testz_si256(error, error);
+}
+
+// mask of the bytes which start a code point (everything but 10xxxxxx).
+__attribute__((target("avx2")))
+static inline uint32_t utf8_starts_mask(__m256i input) {
+    __m256i continuation = _mm256_cmpgt_epi8(_mm256_set1_epi8(-64), input);
+    return ~(uint32_t) _mm256_movemask_epi8(continuation);
+}
+
+__attribute__((target("avx2")))
+static size_t utf8_count_avx2(const unsigned char *s, size_t len) {
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        count += (size_t) __builtin_popcount(utf8_starts_mask(_mm256_loadu_si256((const __m256i*) (s + i))));
+    }
+
+    return count + utf8_count_scalar(s + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static LCOMMON_BOOL utf8_offset_of_avx2(const unsigned char *s, size_t len, size_t n, size_t *offset) {
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        uint32_t starts = utf8_starts_mask(_mm256_loadu_si256((const __m256i*) (s + i)));
+        size_t count = (size_t) __builtin_popcount(starts);
+
+        if (n < count) {
+            for (; n > 0; --n) {
+                starts &= starts - 1;
+            }
+
+            *offset = i + (size_t) __builtin_ctz(starts);
+            return LCOMMON_TRUE;
+        }
+
+        n -= count;
+    }
+
+    if (!utf8_offset_of_scalar(s + i, len - i, n, offset)) {
+        return LCOMMON_FALSE;
+    }
+
+    *offset += i;
+    return LCOMMON_TRUE;
+}
+
+// reads aligned blocks which may extend past the terminator, that never crosses a page
+// boundary but it's invisible to the address sanitizer.
+__attribute__((target("avx2"), no_sanitize_address))
+static Utf8Measure utf8_measure_avx2(const unsigned char *s) {
+    const __m256i indexes = _mm256_setr_epi8(
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31
+    );
+
+    const unsigned char *block = (const unsigned char*) ((uintptr_t) s & ~(uintptr_t) 31);
+    int skip = (int) (s - block);
+
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    size_t codepoints = 0;
+
+    for (;; block += 32, skip = 0) {
+        __m256i input = _mm256_load_si256((const __m256i*) block);
+
+        // bytes before the string are zeroed so they look like ascii.
+        input = _mm256_andnot_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8((char) skip), indexes), input);
+
+        uint32_t nul_mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(input, _mm256_setzero_si256()));
+        nul_mask &= ~0u << skip;
+
+        if (nul_mask == 0) {
+            codepoints += (size_t) __builtin_popcount(utf8_starts_mask(input) & (~0u << skip));
+            error = _mm256_or_si256(error, utf8_check_block(input, prev_input));
+            prev_input = input;
+            continue;
+        }
+
+        int nul_at = __builtin_ctz(nul_mask);
+
+        // whatever follows the terminator isn't part of the string.
+        input = _mm256_andnot_si256(_mm256_cmpgt_epi8(indexes, _mm256_set1_epi8((char) nul_at)), input);
+
+        uint32_t in_string = (~0u << skip) & ((nul_at == 0 ? 0u : ~0u >> (32 - nul_at)));
+        codepoints += (size_t) __builtin_popcount(utf8_starts_mask(input) & in_string);
+        error = _mm256_or_si256(error, utf8_check_block(input, prev_input));
+
+        return (Utf8Measure) {
+            .bytes = (size_t) (block + nul_at - s),
+            .codepoints = codepoints,
+            .is_valid = _mm256_testz_si256(error, error)
+        };
+    }
+}
+
+#endif
+
+LCOMMON_BOOL Common_utf8_validate(const char *s, size_t len) {
+#if LCOMMON_HAVE_X86_SIMD
+    if (simd_has_avx2()) {
+        return utf8_validate_avx2((const unsigned char*) s, len);
+    }
+#endif
+
+    return utf8_validate_scalar((const unsigned char*) s, len);
+}
+
+size_t Common_utf8_count(const char *s, size_t len) {
+#if LCOMMON_HAVE_X86_SIMD
+    if (simd_has_avx2()) {
+        return utf8_count_avx2((const unsigned char*) s, len);
+    }
+#endif
+
+    return utf8_count_scalar((const unsigned char*) s, len);
+}
+
+LCOMMON_BOOL Common_utf8_offset_of(const char *s, size_t len, size_t n, size_t *offset) {
+#if LCOMMON_HAVE_X86_SIMD
+    if (simd_has_avx2()) {
+        return utf8_offset_of_avx2((const unsigned char*) s, len, n, offset);
+    }
+#endif
+
+    return utf8_offset_of_scalar((const unsigned char*) s, len, n, offset);
+}
+
+Utf8Measure Common_utf8_measure(const char *s) {
+#if LCOMMON_HAVE_X86_SIMD
+    if (simd_has_avx2()) {
+        return utf8_measure_avx2((const unsigned char*) s);
+    }
+#endif
+
+    return utf8_measure_scalar((const unsigned char*) s);
+}
+
+
+// binary snapshots
+
+#define SNAPSHOT_MAGIC "LCSNAPSH"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGNMENT 64
+
+struct snapshot_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t len;
+    uint64_t record_size;
+    uint64_t offsets_at;
+    uint64_t bitmap_at;
+    uint64_t blob_at;
+    uint64_t blob_len;
+};
+
+struct snapshot_t {
+    void *map;
+    size_t map_len;
+    const struct snapshot_header_t *header;
+    const uint64_t *offsets;
+    const uint64_t *bitmap;
+    const char *blob;
+};
+
+static inline uint64_t snapshot_align(uint64_t n) {
+    return (n + SNAPSHOT_ALIGNMENT - 1) & ~((uint64_t) SNAPSHOT_ALIGNMENT - 1);
+}
+
+static LCOMMON_BOOL snapshot_write_padding(FILE *file, uint64_t from, uint64_t to) {
+    static const char zeroes[SNAPSHOT_ALIGNMENT] = {0};
+    return fwrite(zeroes, 1, to - from, file) == to - from;
+}
+
+// computes where every section starts and writes the header, `blob_len` must be known.
+static LCOMMON_BOOL snapshot_write_header(
+    FILE *file,
+    struct snapshot_header_t *header,
+    LCOMMON_BOOL with_offsets,
+    LCOMMON_BOOL with_bitmap
+) {
+    uint64_t at = sizeof(struct snapshot_header_t);
+
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+
+    header->offsets_at = with_offsets ? at : 0;
+    at += with_offsets ? sizeof(uint64_t) * (header->len + 1) : 0;
+
+    header->bitmap_at = with_bitmap ? at : 0;
+    at += with_bitmap ? sizeof(uint64_t) * ((header->len + 63) / 64) : 0;
+
+    header->blob_at = snapshot_align(at);
+
+    return fwrite(header, sizeof(struct snapshot_header_t), 1, file) == 1;
+}
+
+static FILE *snapshot_open_for_writing(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file != NULL) {
+        setvbuf(file, NULL, _IOFBF, 1 << 16);
+    }
+
+    return file;
+}
+
+static LCOMMON_BOOL snapshot_close(FILE *file, LCOMMON_BOOL ok) {
+    if (fclose(file) != 0) {
+        ok = LCOMMON_FALSE;
+    }
+
+    return ok;
+}
+
+// returns the string behind an element of a DynamicArray or an OptionalArray, NULL for None.
+static inline const char *snapshot_string_of(void *element, LCOMMON_BOOL optional) {
+    return optional ? Common_optional_to_raw((Optional*) element) : (const char*) element;
+}
+
+// shared writer for strings and optional strings snapshots.
+static LCOMMON_BOOL snapshot_save_strings(
+    const char *path,
+    SnapshotKind kind,
+    void **elements,
+    size_t len,
+    LCOMMON_BOOL optional
+) {
+    FILE *file = snapshot_open_for_writing(path);
+    if (file == NULL) {
+        return LCOMMON_FALSE;
+    }
+
+    struct snapshot_header_t header = { .kind = kind, .len = len };
+    for (size_t i = 0; i < len; ++i) {
+        const char *string = snapshot_string_of(elements[i], optional);
+        header.blob_len += string != NULL ? strlen(string) + 1 : 0;
+    }
+
+    LCOMMON_BOOL ok = snapshot_write_header(file, &header, LCOMMON_TRUE, optional);
+
+    uint64_t offset = 0;
+    for (size_t i = 0; ok && i <= len; ++i) {
+        ok = fwrite(&offset, sizeof(uint64_t), 1, file) == 1;
+
+        if (i < len) {
+            const char *string = snapshot_string_of(elements[i], optional);
+            offset += string != NULL ? strlen(string) + 1 : 0;
+        }
+    }
+
+    for (size_t word_at = 0; ok && optional && word_at < len; word_at += 64) {
+        uint64_t word = 0;
+        for (size_t i = word_at; i < len && i < word_at + 64; ++i) {
+            if (snapshot_string_of(elements[i], optional) == NULL) {
+                word |= (uint64_t) 1 << (i - word_at);
+            }
+        }
+
+        ok = fwrite(&word, sizeof(uint64_t), 1, file) == 1;
+    }
+
+    if (ok) {
+        ok = snapshot_write_padding(file, (uint64_t) ftell(file), header.blob_at);
+    }
+
+    for (size_t i = 0; ok && i < len; ++i) {
+        const char *string = snapshot_string_of(elements[i], optional);
+        if (string != NULL) {
+            size_t string_len = strlen(string) + 1;
+            ok = fwrite(string, 1, string_len, file) == string_len;
+        }
+    }
+
+    return snapshot_close(file, ok);
+}
+
+LCOMMON_BOOL Common_dynamic_array_save(const DynamicArray array, const char *path) {
+    return snapshot_save_strings(path, LCOMMON_SNAPSHOT_STRINGS, array->elements, array->len, LCOMMON_FALSE);
+}
+
+LCOMMON_BOOL Common_optional_array_save(const OptionalArray array, const char *path) {
+    return snapshot_save_strings(
+        path,
+        LCOMMON_SNAPSHOT_OPTIONAL_STRINGS,
+        (void**) array->elements,
+        array->len,
+        LCOMMON_TRUE
+    );
+}
+
+LCOMMON_BOOL Common_dynamic_array_save_records(
+    const DynamicArray array,
+    size_t record_size,
+    const char *path
+) {
+    LCOMMON_ASSERT(record_size > 0, "records must be at least one byte long");
+
+    FILE *file = snapshot_open_for_writing(path);
+    if (file == NULL) {
+        return LCOMMON_FALSE;
+    }
+
+    struct snapshot_header_t header = {
+        .kind = LCOMMON_SNAPSHOT_RECORDS,
+        .len = array->len,
+        .record_size = record_size,
+        .blob_len = (uint64_t) array->len * record_size
+    };
+
+    LCOMMON_BOOL ok = snapshot_write_header(file, &header, LCOMMON_FALSE, LCOMMON_FALSE)
+        && snapshot_write_padding(file, sizeof(struct snapshot_header_t), header.blob_at);
+
+    for (size_t i = 0; ok && i < array->len; ++i) {
+        ok = fwrite(array->elements[i], record_size, 1, file) == 1;
+    }
+
+    return snapshot_close(file, ok);
+}
+
+// checks that every section described by the header lies inside the mapping.
+static LCOMMON_BOOL snapshot_is_sane(const struct snapshot_header_t *header, size_t map_len) {
+    if (map_len < sizeof(struct snapshot_header_t)
+        || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0
+        || header->version != SNAPSHOT_VERSION
+        || header->blob_at > map_len
+        || header->blob_len > map_len - header->blob_at) {
+        return LCOMMON_FALSE;
+    }
+
+    switch (header->kind) {
+        // sections a kind doesn't have must be absent, `Common_snapshot_map()` uses any
+        // non zero position.
+        case LCOMMON_SNAPSHOT_RECORDS:
+            return header->offsets_at == 0
+                && header->bitmap_at == 0
+                && header->record_size > 0
+                && header->blob_len % header->record_size == 0
+                && header->blob_len / header->record_size == header->len;
+
+        case LCOMMON_SNAPSHOT_STRINGS:
+        case LCOMMON_SNAPSHOT_OPTIONAL_STRINGS: {
+            // every string has an offset, which also keeps the section ends from overflowing.
+            if (header->len > map_len / sizeof(uint64_t)
+                || header->offsets_at > header->blob_at
+                || header->bitmap_at > header->blob_at) {
+                return LCOMMON_FALSE;
+            }
+
+            uint64_t offsets_end = header->offsets_at + sizeof(uint64_t) * (header->len + 1);
+            uint64_t bitmap_end = header->bitmap_at + sizeof(uint64_t) * ((header->len + 63) / 64);
+            LCOMMON_BOOL needs_bitmap = header->kind == LCOMMON_SNAPSHOT_OPTIONAL_STRINGS;
+
+            return header->offsets_at >= sizeof(struct snapshot_header_t)
+                && header->offsets_at % sizeof(uint64_t) == 0
+                && offsets_end <= header->blob_at
+                && (needs_bitmap
+                    ? header->bitmap_at >= offsets_end
+                        && header->bitmap_at % sizeof(uint64_t) == 0
+                        && bitmap_end <= header->blob_at
+                    : header->bitmap_at == 0);
+        }
+
+        default:
+            return LCOMMON_FALSE;
+    }
+}
+
+Optional Common_snapshot_map(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Common_optional_none();
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(struct snapshot_header_t)) {
+        close(fd);
+        return Common_optional_none();
+    }
+
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return Common_optional_none();
+    }
+
+    const struct snapshot_header_t *header = map;
+    if (!snapshot_is_sane(header, (size_t) st.st_size)) {
+        munmap(map, (size_t) st.st_size);
+        return Common_optional_none();
+    }
+
+    Snapshot snapshot = Common_dsmalloc(struct snapshot_t);
+    snapshot->map = map;
+    snapshot->map_len = (size_t) st.st_size;
+    snapshot->header = header;
+    snapshot->offsets = header->offsets_at ? (const uint64_t*) ((const char*) map + header->offsets_at) : NULL;
+    snapshot->bitmap = header->bitmap_at ? (const uint64_t*) ((const char*) map + header->bitmap_at) : NULL;
+    snapshot->blob = (const char*) map + header->blob_at;
+
+    return Common_optional_with(snapshot);
+}
+
+void Common_snapshot_unmap(Snapshot snapshot) {
+    munmap(snapshot->map, snapshot->map_len);
+    LCOMMON_FREE(snapshot);
+}
+
+SnapshotKind Common_snapshot_kind(const Snapshot snapshot) {
+    return (SnapshotKind) snapshot->header->kind;
+}
+
+size_t Common_snapshot_len(const Snapshot snapshot) {
+    return snapshot->header->len;
+}
+
+size_t Common_snapshot_record_size(const Snapshot snapshot) {
+    return snapshot->header->record_size;
+}
+
+LCOMMON_BOOL Common_snapshot_is_none_at(const Snapshot snapshot, size_t n) {
+    LCOMMON_ASSERT(n < snapshot->header->len, "index should be inside the snapshot");
+
+    if (snapshot->bitmap == NULL) {
+        return LCOMMON_FALSE;
+    }
+
+    return (snapshot->bitmap[n / 64] >> (n % 64)) & 1;
+}
+
+const char *Common_snapshot_string_at(const Snapshot snapshot, size_t n) {
+    LCOMMON_ASSERT(snapshot->offsets != NULL, "snapshot should contain strings");
+
+    if (Common_snapshot_is_none_at(snapshot, n)) {
+        return NULL;
+    }
+
+    uint64_t start = snapshot->offsets[n];
+    uint64_t end = snapshot->offsets[n + 1];
+
+    // offsets come from the file, so they're checked instead of trusted.
+    if (start >= end || end > snapshot->header->blob_len || snapshot->blob[end - 1] != '\0') {
+        return NULL;
+    }
+
+    return snapshot->blob + start;
+}
+
+size_t Common_snapshot_string_len_at(const Snapshot snapshot, size_t n) {
+    return Common_snapshot_string_at(snapshot, n) != NULL
+        ? snapshot->offsets[n + 1] - snapshot->offsets[n] - 1
+        : 0;
+}
+
+const void *Common_snapshot_record_at(const Snapshot snapshot, size_t n) {
+    LCOMMON_ASSERT(snapshot->header->kind == LCOMMON_SNAPSHOT_RECORDS, "snapshot should contain records");
+    LCOMMON_ASSERT(n < snapshot->header->len, "index should be inside the snapshot");
+
+    return snapshot->blob + n * snapshot->header->record_size;
+}
+
+DynamicArray Common_snapshot_to_array(const Snapshot snapshot) {
+    DynamicArray array = Common_dynamic_array_init();
+    dynamic_array_reserve(array, snapshot->header->len);
+
+    for (size_t i = 0; i < snapshot->header->len; ++i) {
+        const void *element = snapshot->header->kind == LCOMMON_SNAPSHOT_RECORDS
+            ? Common_snapshot_record_at(snapshot, i)
+            : (const void*) Common_snapshot_string_at(snapshot, i);
+
+        if (element != NULL) {
+            Common_dynamic_array_append(array, (void*) element);
+        }
+    }
+
+    return array;
+}
+
+static void *snapshot_copy(const void *data, size_t len) {
+    void *copy = Common_smalloc(len);
+    memcpy(copy, data, len);
+    return copy;
+}
+
+static Optional snapshot_map_kind(const char *path, SnapshotKind kind) {
+    Optional opt_snapshot = Common_snapshot_map(path);
+
+    if (Common_optional_is_some(&opt_snapshot)
+        && Common_snapshot_kind(Common_optional_unpack(&opt_snapshot)) != kind) {
+        Common_snapshot_unmap(Common_optional_unpack(&opt_snapshot));
+        return Common_optional_none();
+    }
+
+    return opt_snapshot;
+}
+
+Optional Common_dynamic_array_load(const char *path) {
+    Optional opt_snapshot = snapshot_map_kind(path, LCOMMON_SNAPSHOT_STRINGS);
+    if (Common_optional_is_none(&opt_snapshot)) {
+        return Common_optional_none();
+    }
+
+    Snapshot snapshot = Common_optional_unpack(&opt_snapshot);
+    DynamicArray array = Common_dynamic_array_init();
+    dynamic_array_reserve(array, snapshot->header->len);
+
+    for (size_t i = 0; i < snapshot->header->len; ++i) {
+        const char *string = Common_snapshot_string_at(snapshot, i);
+        if (string == NULL) {
+            Common_dynamic_array_free(array);
+            Common_snapshot_unmap(snapshot);
+            return Common_optional_none();
+        }
+
+        size_t len = snapshot->offsets[i + 1] - snapshot->offsets[i];
+        Common_dynamic_array_append(array, snapshot_copy(string, len));
+    }
+
+    Common_snapshot_unmap(snapshot);
+
+    return Common_optional_with(array);
+}
+
+Optional Common_dynamic_array_load_records(const char *path, size_t record_size) {
+    Optional opt_snapshot = snapshot_map_kind(path, LCOMMON_SNAPSHOT_RECORDS);
+    if (Common_optional_is_none(&opt_snapshot)) {
+        return Common_optional_none();
+    }
+
+    Snapshot snapshot = Common_optional_unpack(&opt_snapshot);
+    if (snapshot->header->record_size != record_size) {
+        Common_snapshot_unmap(snapshot);
+        return Common_optional_none();
+    }
+
+    DynamicArray array = Common_dynamic_array_init();
+    dynamic_array_reserve(array, snapshot->header->len);
+
+    for (size_t i = 0; i < snapshot->header->len; ++i) {
+        Common_dynamic_array_append(array, snapshot_copy(Common_snapshot_record_at(snapshot, i), record_size));
+    }
+
+    Common_snapshot_unmap(snapshot);
+
+    return Common_optional_with(array);
+}
+
+Optional Common_optional_array_load(const char *path) {
+    Optional opt_snapshot = snapshot_map_kind(path, LCOMMON_SNAPSHOT_OPTIONAL_STRINGS);
+    if (Common_optional_is_none(&opt_snapshot)) {
+        return Common_optional_none();
+    }
+
+    Snapshot snapshot = Common_optional_unpack(&opt_snapshot);
+    OptionalArray array = Common_optional_array_init();
+
+    for (size_t i = 0; i < snapshot->header->len; ++i) {
+        if (Common_snapshot_is_none_at(snapshot, i)) {
+            Common_optional_array_append(array, Common_optional_alloc_none());
+            continue;
+        }
+
+        const char *string = Common_snapshot_string_at(snapshot, i);
+        if (string == NULL) {
+            Common_optional_array_free(array);
+            Common_snapshot_unmap(snapshot);
+            return Common_optional_none();
+        }
+
+        size_t len = snapshot->offsets[i + 1] - snapshot->offsets[i];
+        Common_optional_array_append(array, Common_optional_alloc_with(snapshot_copy(string, len)));
+    }
+
+    Common_snapshot_unmap(snapshot);
+
+    return Common_optional_with(array);
+}
+
+// shared arrays
+
+#define SHARED_ARRAY_INITIAL_CAP 16
+#define SHARED_ARRAY_CACHE_LINE 64
+
+struct shared_array_buffer_t {
+    size_t cap;
+    unsigned long long retired_epoch;
+    struct shared_array_buffer_t *next_retired;
+    void *elements[];
+};
+
+// every reader owns a cache line so announcing an epoch never bounces the lines other
+// readers are writing to. An epoch of 0 means the reader isn't in a read section.
+struct shared_array_reader_t {
+    unsigned long long epoch;
+    int in_use;
+    SharedArray array;
+    struct shared_array_reader_t *next;
+} __attribute__((aligned(SHARED_ARRAY_CACHE_LINE)));
+
+struct shared_array_t {
+    struct shared_array_buffer_t *current;
+    size_t len;
+    unsigned long long epoch;
+    struct shared_array_reader_t *readers;
+    struct shared_array_buffer_t *retired;
+};
+
+static struct shared_array_buffer_t *shared_array_buffer_alloc(size_t cap) {
+    struct shared_array_buffer_t *buffer = Common_smalloc(sizeof(struct shared_array_buffer_t) + sizeof(void*) * cap);
+
+    buffer->cap = cap;
+    buffer->retired_epoch = 0;
+    buffer->next_retired = NULL;
+
+    return buffer;
+}
+
+SharedArray Common_shared_array_init(void) {
+    SharedArray ret = Common_smalloc(sizeof(struct shared_array_t));
+
+    ret->current = shared_array_buffer_alloc(SHARED_ARRAY_INITIAL_CAP);
+    ret->len = 0;
+    ret->epoch = 1;
+    ret->readers = NULL;
+    ret->retired = NULL;
+
+    return ret;
+}
+
+// publishes a buffer twice as big, the old one stays readable until it's reclaimed.
+static void shared_array_grow(SharedArray array) {
+    struct shared_array_buffer_t *old = array->current;
+    struct shared_array_buffer_t *buffer = shared_array_buffer_alloc(old->cap * 2);
+
+    memcpy(buffer->elements, old->elements, sizeof(void*) * array->len);
+
+    // a reader that announced the current epoch may still load `old`, readers that
+    // announce a later one are ordered after the new buffer was published.
+    __atomic_store_n(&array->current, buffer, __ATOMIC_SEQ_CST);
+    old->retired_epoch = __atomic_fetch_add(&array->epoch, 1, __ATOMIC_SEQ_CST);
+    old->next_retired = array->retired;
+    array->retired = old;
+
+    Common_shared_array_reclaim(array);
+}
+
+void Common_shared_array_append(SharedArray array, void *element) {
+    if (array->len == array->current->cap) {
+        shared_array_grow(array);
+    }
+
+    array->current->elements[array->len] = element;
+
+    // the element must be visible before the length that covers it.
+    __atomic_store_n(&array->len, array->len + 1, __ATOMIC_RELEASE);
+}
+
+size_t Common_shared_array_reclaim(SharedArray array) {
+    if (array->retired == NULL) {
+        return 0;
+    }
+
+    // buffers retired before the oldest epoch still announced by a reader are unreachable.
+    unsigned long long oldest = __atomic_load_n(&array->epoch, __ATOMIC_SEQ_CST);
+    // seq_cst pairs with the push in `Common_shared_array_reader_init()`: either this load sees a
+    // reader pushed concurrently or that reader only loads buffers published after the retire.
+    struct shared_array_reader_t *reader = __atomic_load_n(&array->readers, __ATOMIC_SEQ_CST);
+
+    for (; reader != NULL; reader = reader->next) {
+        unsigned long long epoch = __atomic_load_n(&reader->epoch, __ATOMIC_SEQ_CST);
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    size_t pending = 0;
+    struct shared_array_buffer_t **link = &array->retired;
+
+    while (*link != NULL) {
+        struct shared_array_buffer_t *buffer = *link;
+
+        if (buffer->retired_epoch < oldest) {
+            *link = buffer->next_retired;
+            LCOMMON_FREE(buffer);
+            continue;
+        }
+
+        pending++;
+        link = &buffer->next_retired;
+    }
+
+    return pending;
+}
+
+void Common_shared_array_destroy(SharedArray array) {
+    while (array->retired != NULL) {
+        struct shared_array_buffer_t *next = array->retired->next_retired;
+        LCOMMON_FREE(array->retired);
+        array->retired = next;
+    }
+
+    while (array->readers != NULL) {
+        struct shared_array_reader_t *next = array->readers->next;
+        LCOMMON_FREE(array->readers);
+        array->readers = next;
+    }
+
+    LCOMMON_FREE(array->current);
+    LCOMMON_FREE(array);
+}
+
+void Common_shared_array_free(SharedArray array) {
+    for (size_t i = 0; i < array->len; ++i) {
+        LCOMMON_FREE(array->current->elements[i]);
+    }
+
+    Common_shared_array_destroy(array);
+}
+
+SharedArrayReader Common_shared_array_reader_init(SharedArray array) {
+    struct shared_array_reader_t *reader = __atomic_load_n(&array->readers, __ATOMIC_ACQUIRE);
+
+    // records are never unlinked while the array lives, so released ones get reused.
+    for (; reader != NULL; reader = reader->next) {
+        int expected = LCOMMON_FALSE;
+        if (!__atomic_load_n(&reader->in_use, __ATOMIC_RELAXED)
+            && __atomic_compare_exchange_n(&reader->in_use, &expected, LCOMMON_TRUE, LCOMMON_FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return reader;
+        }
+    }
+
+    if (posix_memalign((void**) &reader, SHARED_ARRAY_CACHE_LINE, sizeof(struct shared_array_reader_t)) != 0) {
+        die("posix_memalign");
+    }
+
+    reader->epoch = 0;
+    reader->in_use = LCOMMON_TRUE;
+    reader->array = array;
+    reader->next = __atomic_load_n(&array->readers, __ATOMIC_RELAXED);
+
+    while (!__atomic_compare_exchange_n(&array->readers, &reader->next, reader, LCOMMON_TRUE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        ;
+
+    return reader;
+}
+
+void Common_shared_array_reader_destroy(SharedArrayReader reader) {
+    LCOMMON_ASSERT(reader->epoch == 0, "a reader can't be released inside a read section");
+    __atomic_store_n(&reader->in_use, LCOMMON_FALSE, __ATOMIC_RELEASE);
+}
+
+SharedArrayView Common_shared_array_read_lock(SharedArrayReader reader) {
+    SharedArray array = reader->array;
+    SharedArrayView view;
+
+    LCOMMON_ASSERT(reader->epoch == 0, "read sections can't be nested");
+
+    // announcing the epoch must be ordered before loading the buffer, pairs with the
+    // sequentially consistent publish and scan done by the writer.
+    __atomic_store_n(&reader->epoch, __atomic_load_n(&array->epoch, __ATOMIC_RELAXED), __ATOMIC_SEQ_CST);
+
+    // the length is loaded first: any buffer published afterwards holds at least as many elements.
+    view.len = __atomic_load_n(&array->len, __ATOMIC_ACQUIRE);
+    view.elements = __atomic_load_n(&array->current, __ATOMIC_SEQ_CST)->elements;
+
+    return view;
+}
+
+void Common_shared_array_read_unlock(SharedArrayReader reader) {
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+// scratch allocator
+
+#define SCRATCH_CHUNK_SIZE (64 * 1024)
+#define SCRATCH_ALIGNMENT 16
+
+struct scratch_chunk_t {
+    struct scratch_chunk_t *prev;
+    size_t cap;
+    size_t used;
+    size_t padding;
+    char data[];
+};
+
+// `current` is the top of the stack of chunks, `spare` keeps the last popped chunk around
+// so a scope that crosses a chunk boundary in a loop doesn't hit malloc every iteration.
+static __thread struct scratch_chunk_t *scratch_current = NULL;
+static __thread struct scratch_chunk_t *scratch_spare = NULL;
+static __thread LCOMMON_BOOL scratch_registered = LCOMMON_FALSE;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static pthread_key_t scratch_key;
+
+// destructor of `scratch_key`, frees the chunks of threads exiting without calling
+// `Common_scratch_release()`.
+static void scratch_thread_exit(void *unused) {
+    (void) unused;
+    Common_scratch_release();
+}
+
+static void scratch_setup(void) {
+    pthread_key_create(&scratch_key, scratch_thread_exit);
+}
+
+// makes sure `scratch_thread_exit()` runs when the calling thread exits.
+static void scratch_register(void) {
+    pthread_once(&scratch_once, scratch_setup);
+    pthread_setspecific(scratch_key, &scratch_registered);
+    scratch_registered = LCOMMON_TRUE;
+}
+
+static void scratch_retire(struct scratch_chunk_t *chunk) {
+    if (scratch_spare == NULL || scratch_spare->cap < chunk->cap) {
+        struct scratch_chunk_t *old = scratch_spare;
+        scratch_spare = chunk;
+        chunk = old;
+    }
+
+    if (chunk != NULL) {
+        LCOMMON_FREE(chunk);
+    }
+}
+
+static struct scratch_chunk_t *scratch_chunk_for(size_t len) {
+    struct scratch_chunk_t *chunk = scratch_spare;
+
+    if (chunk != NULL && chunk->cap >= len) {
+        scratch_spare = NULL;
+    } else {
+        size_t cap = len > SCRATCH_CHUNK_SIZE ? len : SCRATCH_CHUNK_SIZE;
+        chunk = Common_smalloc(sizeof(struct scratch_chunk_t) + cap);
+        chunk->cap = cap;
+
+        if (!scratch_registered) {
+            scratch_register();
+        }
+    }
+
+    chunk->used = 0;
+    chunk->prev = scratch_current;
+    scratch_current = chunk;
+
+    return chunk;
+}
+
+ScratchMark Common_scratch_push(void) {
+    ScratchMark mark;
+
+    mark.chunk = scratch_current;
+    mark.used = scratch_current != NULL ? scratch_current->used : 0;
+
+    return mark;
+}
+
+void Common_scratch_pop(ScratchMark mark) {
+    while (scratch_current != mark.chunk) {
+        LCOMMON_ASSERT(scratch_current != NULL, "scratch marks must be popped in reverse order");
+
+        struct scratch_chunk_t *chunk = scratch_current;
+        scratch_current = chunk->prev;
+        scratch_retire(chunk);
+    }
+
+    if (scratch_current != NULL) {
+        scratch_current->used = mark.used;
+    }
+}
+
+void *Common_scratch_alloc(size_t len) {
+    struct scratch_chunk_t *chunk = scratch_current;
+    size_t at = 0;
+
+    if (chunk != NULL) {
+        at = (chunk->used + SCRATCH_ALIGNMENT - 1) & ~(size_t) (SCRATCH_ALIGNMENT - 1);
+    }
+
+    if (chunk == NULL || at > chunk->cap || chunk->cap - at < len) {
+        chunk = scratch_chunk_for(len);
+        at = 0;
+    }
+
+    chunk->used = at + len;
+
+    return chunk->data + at;
+}
+
+void Common_scratch_release(void) {
+    while (scratch_current != NULL) {
+        struct scratch_chunk_t *chunk = scratch_current;
+        scratch_current = chunk->prev;
+        LCOMMON_FREE(chunk);
+    }
+
+    if (scratch_spare != NULL) {
+        LCOMMON_FREE(scratch_spare);
+    }
+
+    // scratch memory used by later destructors registers the thread again.
+    scratch_registered = LCOMMON_FALSE;
+}
+
+void __private__Common_scratch_scope_exit(ScratchMark *mark) {
+    Common_scratch_pop(*mark);
+}
+
+char *Common_scratch_strdup(const char *s) {
+    size_t len = strlen(s);
+    char *ret = Common_scratch_alloc(len + 1);
+
+    memcpy(ret, s, len + 1);
+
+    return ret;
+}
+
+char *__private__Common_scratch_strmerge(const char *separator, const char *first, ...) {
+    size_t separator_len = strlen(separator);
+    size_t len = strlen(first);
+    char *cur;
+
+    // sized first so the result is a single bump with no intermediate copies.
+    va_list args;
+    va_start(args, first);
+    while ((cur = va_arg(args, char*)) != LCOMMON_TERMINATOR) {
+        len += separator_len + strlen(cur);
+    }
+    va_end(args);
+
+    char *ret = Common_scratch_alloc(len + 1);
+    char *out = ret;
+
+    size_t n = strlen(first);
+    memcpy(out, first, n);
+    out += n;
+
+    va_start(args, first);
+    while ((cur = va_arg(args, char*)) != LCOMMON_TERMINATOR) {
+        memcpy(out, separator, separator_len);
+        out += separator_len;
+
+        n = strlen(cur);
+        memcpy(out, cur, n);
+        out += n;
+    }
+    va_end(args);
+
+    *out = '\0';
+
+    return ret;
+}
+
+char *Common_scratch_strmerge_from_array(
+    const char *separator,
+    const DynamicArray dynamic_array
+) {
+    size_t separator_len = strlen(separator);
+    size_t len = 0;
+
+    for (size_t i = 0; i < dynamic_array->len; ++i) {
+        len += strlen(dynamic_array->elements[i]) + (i > 0 ? separator_len : 0);
+    }
+
+    char *ret = Common_scratch_alloc(len + 1);
+    char *out = ret;
+
+    for (size_t i = 0; i < dynamic_array->len; ++i) {
+        if (i > 0) {
+            memcpy(out, separator, separator_len);
+            out += separator_len;
+        }
+
+        size_t n = strlen(dynamic_array->elements[i]);
+        memcpy(out, dynamic_array->elements[i], n);
+        out += n;
+    }
+
+    *out = '\0';
+
+    return ret;
+}
+
+// heaps (priority queues)
+
+#define HEAP_ARITY 4
+#define HEAP_INITIAL_CAP 16
+#define HEAP_NO_POSITION ((size_t) -1)
+
+typedef enum heap_kind_t {
+    HEAP_COMPARATOR,
+    HEAP_INT_KEYS,
+    HEAP_DOUBLE_KEYS,
+} HeapKind;
+
+struct heap_entry_t {
+    union {
+        long long i;
+        double d;
+    } key;
+    void *payload;
+    size_t handle;
+};
+
+// `positions[handle]` is the index of the entry owning that handle, handles which are
+// not in use form a free list threaded through the same array (`free_handle` is its head).
+struct heap_t {
+    HeapKind kind;
+    HeapCompare compare;
+    size_t len;
+    size_t cap;
+    struct heap_entry_t *entries;
+    size_t *positions;
+    size_t handles_cap;
+    size_t free_handle;
+};
+
+#define HEAP_LESS_INT(heap, a, b) ((a)->key.i < (b)->key.i)
+#define HEAP_LESS_DOUBLE(heap, a, b) ((a)->key.d < (b)->key.d)
+#define HEAP_LESS_COMPARATOR(heap, a, b) ((heap)->compare((a)->payload, (b)->payload) < 0)
+
+// generates hole-based sifts for every kind of key so the hot loops don't branch on it.
+#define HEAP_SIFT_FUNCTIONS(suffix, less) \
+    static size_t heap_sift_up_##suffix(Heap heap, size_t at) { \
+        struct heap_entry_t entry = heap->entries[at]; \
+        while (at > 0) { \
+            size_t parent = (at - 1) / HEAP_ARITY; \
+            if (!less(heap, &entry, &heap->entries[parent])) { \
+                break; \
+            } \
+            heap->entries[at] = heap->entries[parent]; \
+            heap->positions[heap->entries[at].handle] = at; \
+            at = parent; \
+        } \
+        heap->entries[at] = entry; \
+        heap->positions[entry.handle] = at; \
+        return at; \
+    } \
+    static void heap_sift_down_##suffix(Heap heap, size_t at) { \
+        struct heap_entry_t entry = heap->entries[at]; \
+        for (;;) { \
+            size_t first = at * HEAP_ARITY + 1; \
+            if (first >= heap->len) { \
+                break; \
+            } \
+            size_t last = first + HEAP_ARITY < heap->len ? first + HEAP_ARITY : heap->len; \
+            size_t best = first; \
+            for (size_t child = first + 1; child < last; ++child) { \
+                if (less(heap, &heap->entries[child], &heap->entries[best])) { \
+                    best = child; \
+                } \
+            } \
+            if (!less(heap, &heap->entries[best], &entry)) { \
+                break; \
+            } \
+            heap->entries[at] = heap->entries[best]; \
+            heap->positions[heap->entries[at].handle] = at; \
+            at = best; \
+        } \
+        heap->entries[at] = entry; \
+        heap->positions[entry.handle] = at; \
+    }
+
+HEAP_SIFT_FUNCTIONS(int, HEAP_LESS_INT)
+HEAP_SIFT_FUNCTIONS(double, HEAP_LESS_DOUBLE)
+HEAP_SIFT_FUNCTIONS(comparator, HEAP_LESS_COMPARATOR)
+
+static inline size_t heap_sift_up(Heap heap, size_t at) {
+    switch (heap->kind) {
+        case HEAP_INT_KEYS: return heap_sift_up_int(heap, at);
+        case HEAP_DOUBLE_KEYS: return heap_sift_up_double(heap, at);
+        default: return heap_sift_up_comparator(heap, at);
+    }
+}
+
+static inline void heap_sift_down(Heap heap, size_t at) {
+    switch (heap->kind) {
+        case HEAP_INT_KEYS: heap_sift_down_int(heap, at); break;
+        case HEAP_DOUBLE_KEYS: heap_sift_down_double(heap, at); break;
+        default: heap_sift_down_comparator(heap, at); break;
+    }
+}
+
+// moves an entry whose key changed in either direction.
+static inline void heap_sift(Heap heap, size_t at) {
+    if (heap_sift_up(heap, at) == at) {
+        heap_sift_down(heap, at);
+    }
+}
+
+static Heap heap_new(HeapKind kind, HeapCompare compare, size_t cap) {
+    Heap ret = Common_smalloc(sizeof(struct heap_t));
+
+    ret->kind = kind;
+    ret->compare = compare;
+    ret->len = 0;
+    ret->cap = cap < HEAP_INITIAL_CAP ? HEAP_INITIAL_CAP : cap;
+    ret->entries = Common_smalloc(sizeof(struct heap_entry_t) * ret->cap);
+    ret->positions = Common_smalloc(sizeof(size_t) * ret->cap);
+    ret->handles_cap = ret->cap;
+    ret->free_handle = HEAP_NO_POSITION;
+
+    return ret;
+}
+
+static size_t heap_take_handle(Heap heap) {
+    if (heap->free_handle != HEAP_NO_POSITION) {
+        size_t handle = heap->free_handle;
+        heap->free_handle = heap->positions[handle];
+        return handle;
+    }
+
+    // without free handles every handle below `len` is in use.
+    if (heap->len == heap->handles_cap) {
+        heap->handles_cap *= 2;
+        heap->positions = Common_srealloc(heap->positions, sizeof(size_t) * heap->handles_cap);
+    }
+
+    return heap->len;
+}
+
+static void heap_give_handle(Heap heap, size_t handle) {
+    heap->positions[handle] = heap->free_handle;
+    heap->free_handle = handle;
+}
+
+static HeapHandle heap_push_entry(Heap heap, struct heap_entry_t entry) {
+    if (heap->len == heap->cap) {
+        heap->cap *= 2;
+        heap->entries = Common_srealloc(heap->entries, sizeof(struct heap_entry_t) * heap->cap);
+    }
+
+    entry.handle = heap_take_handle(heap);
+    heap->entries[heap->len] = entry;
+    heap_sift_up(heap, heap->len++);
+
+    return entry.handle;
+}
+
+// takes the entry at `at` out of the heap, filling the hole with the last entry.
+static void *heap_remove_at(Heap heap, size_t at) {
+    void *payload = heap->entries[at].payload;
+
+    heap_give_handle(heap, heap->entries[at].handle);
+
+    if (at != --heap->len) {
+        heap->entries[at] = heap->entries[heap->len];
+        heap_sift(heap, at);
+    }
+
+    return payload;
+}
+
+// bounded insertion shared by every `Common_heap_offer*()`, `entry` already holds its key.
+static Optional heap_offer_entry(Heap heap, size_t k, struct heap_entry_t entry) {
+    LCOMMON_ASSERT(k > 0, "a top-k heap must keep at least one entry");
+    LCOMMON_ASSERT(heap->len <= k, "heap already holds more than k entries");
+
+    if (heap->len < k) {
+        heap_push_entry(heap, entry);
+        return Common_optional_none();
+    }
+
+    entry.handle = heap->entries[0].handle;
+
+    switch (heap->kind) {
+        case HEAP_INT_KEYS:
+            if (!HEAP_LESS_INT(heap, &heap->entries[0], &entry)) {
+                return Common_optional_with(entry.payload);
+            }
+            break;
+        case HEAP_DOUBLE_KEYS:
+            if (!HEAP_LESS_DOUBLE(heap, &heap->entries[0], &entry)) {
+                return Common_optional_with(entry.payload);
+            }
+            break;
+        default:
+            if (!HEAP_LESS_COMPARATOR(heap, &heap->entries[0], &entry)) {
+                return Common_optional_with(entry.payload);
+            }
+            break;
+    }
+
+    // the new entry takes over the slot (and handle) of the evicted first entry.
+    void *evicted = heap->entries[0].payload;
+    heap->entries[0] = entry;
+    heap_sift_down(heap, 0);
+
+    return Common_optional_with(evicted);
+}
+
+// Floyd's bottom-up construction, sifting down every internal node from the last one.
+static void heap_build(Heap heap) {
+    for (size_t i = 0; i < heap->len; ++i) {
+        heap->positions[i] = i;
+    }
+
+    if (heap->len < 2) {
+        return;
+    }
+
+    for (size_t at = (heap->len - 2) / HEAP_ARITY + 1; at-- > 0;) {
+        heap_sift_down(heap, at);
+    }
+}
+
+Heap Common_heap_init(HeapCompare compare) {
+    LCOMMON_ASSERT(compare != NULL, "a comparator heap needs a comparator");
+    return heap_new(HEAP_COMPARATOR, compare, HEAP_INITIAL_CAP);
+}
+
+Heap Common_heap_init_int(void) {
+    return heap_new(HEAP_INT_KEYS, NULL, HEAP_INITIAL_CAP);
+}
+
+Heap Common_heap_init_double(void) {
+    return heap_new(HEAP_DOUBLE_KEYS, NULL, HEAP_INITIAL_CAP);
+}
+
+Heap Common_heap_from_array(HeapCompare compare, const DynamicArray array) {
+    LCOMMON_ASSERT(compare != NULL, "a comparator heap needs a comparator");
+    Heap heap = heap_new(HEAP_COMPARATOR, compare, array->len);
+
+    for (size_t i = 0; i < array->len; ++i) {
+        heap->entries[i].key.i = 0;
+        heap->entries[i].payload = array->elements[i];
+        heap->entries[i].handle = i;
+    }
+
+    heap->len = array->len;
+    heap_build(heap);
+
+    return heap;
+}
+
+Heap Common_heap_from_array_int(const DynamicArray array, const long long *keys) {
+    Heap heap = heap_new(HEAP_INT_KEYS, NULL, array->len);
+
+    for (size_t i = 0; i < array->len; ++i) {
+        heap->entries[i].key.i = keys[i];
+        heap->entries[i].payload = array->elements[i];
+        heap->entries[i].handle = i;
+    }
+
+    heap->len = array->len;
+    heap_build(heap);
+
+    return heap;
+}
+
+Heap Common_heap_from_array_double(const DynamicArray array, const double *keys) {
+    Heap heap = heap_new(HEAP_DOUBLE_KEYS, NULL, array->len);
+
+    for (size_t i = 0; i < array->len; ++i) {
+        heap->entries[i].key.d = keys[i];
+        heap->entries[i].payload = array->elements[i];
+        heap->entries[i].handle = i;
+    }
+
+    heap->len = array->len;
+    heap_build(heap);
+
+    return heap;
+}
+
+void Common_heap_destroy(Heap heap) {
+    LCOMMON_FREE(heap->entries);
+    LCOMMON_FREE(heap->positions);
+    LCOMMON_FREE(heap);
+}
+
+void Common_heap_free(Heap heap) {
+    for (size_t i = 0; i < heap->len; ++i) {
+        LCOMMON_FREE(heap->entries[i].payload);
+    }
+
+    Common_heap_destroy(heap);
+}
+
+size_t Common_heap_len(const Heap heap) {
+    return heap->len;
+}
+
+HeapHandle Common_heap_push(Heap heap, void *payload) {
+    LCOMMON_ASSERT(heap->kind == HEAP_COMPARATOR, "keyed heaps need a key to push");
+
+    struct heap_entry_t entry;
+    entry.key.i = 0;
+    entry.payload = payload;
+
+    return heap_push_entry(heap, entry);
+}
+
+HeapHandle Common_heap_push_int(Heap heap, long long key, void *payload) {
+    LCOMMON_ASSERT(heap->kind == HEAP_INT_KEYS, "heap isn't ordered by integer keys");
+
+    struct heap_entry_t entry;
+    entry.key.i = key;
+    entry.payload = payload;
+
+    return heap_push_entry(heap, entry);
+}
+
+HeapHandle Common_heap_push_double(Heap heap, double key, void *payload) {
+    LCOMMON_ASSERT(heap->kind == HEAP_DOUBLE_KEYS, "heap isn't ordered by double keys");
+
+    struct heap_entry_t entry;
+    entry.key.d = key;
+    entry.payload = payload;
+
+    return heap_push_entry(heap, entry);
+}
+
+Optional Common_heap_peek(const Heap heap) {
+    if (heap->len == 0) {
+        return Common_optional_none();
+    }
+
+    return Common_optional_with(heap->entries[0].payload);
+}
+
+Optional Common_heap_pop(Heap heap) {
+    if (heap->len == 0) {
+        return Common_optional_none();
+    }
+
+    return Common_optional_with(heap_remove_at(heap, 0));
+}
+
+long long Common_heap_top_int(const Heap heap) {
+    LCOMMON_ASSERT(heap->kind == HEAP_INT_KEYS, "heap isn't ordered by integer keys");
+    LCOMMON_ASSERT(heap->len > 0, "heap is empty");
+    return heap->entries[0].key.i;
+}
+
+double Common_heap_top_double(const Heap heap) {
+    LCOMMON_ASSERT(heap->kind == HEAP_DOUBLE_KEYS, "heap isn't ordered by double keys");
+    LCOMMON_ASSERT(heap->len > 0, "heap is empty");
+    return heap->entries[0].key.d;
+}
+
+// returns the index of the entry behind `handle`, a handle which was already popped or
+// removed (and maybe sits in the free list) doesn't point back at itself.
+static size_t heap_position(const Heap heap, HeapHandle handle) {
+    LCOMMON_ASSERT(handle < heap->handles_cap, "invalid heap handle");
+
+    size_t at = heap->positions[handle];
+    LCOMMON_ASSERT(at < heap->len && heap->entries[at].handle == handle, "stale heap handle");
+
+    return at;
+}
+
+void Common_heap_update(Heap heap, HeapHandle handle) {
+    heap_sift(heap, heap_position(heap, handle));
+}
+
+void Common_heap_update_int(Heap heap, HeapHandle handle, long long key) {
+    LCOMMON_ASSERT(heap->kind == HEAP_INT_KEYS, "heap isn't ordered by integer keys");
+    size_t at = heap_position(heap, handle);
+    heap->entries[at].key.i = key;
+    heap_sift(heap, at);
+}
+
+void Common_heap_update_double(Heap heap, HeapHandle handle, double key) {
+    LCOMMON_ASSERT(heap->kind == HEAP_DOUBLE_KEYS, "heap isn't ordered by double keys");
+    size_t at = heap_position(heap, handle);
+    heap->entries[at].key.d = key;
+    heap_sift(heap, at);
+}
+
+void *Common_heap_remove(Heap heap, HeapHandle handle) {
+    return heap_remove_at(heap, heap_position(heap, handle));
+}
+
+Optional Common_heap_offer(Heap heap, size_t k, void *payload) {
+    LCOMMON_ASSERT(heap->kind == HEAP_COMPARATOR, "keyed heaps need a key to offer");
+
+    struct heap_entry_t entry;
+    entry.key.i = 0;
+    entry.payload = payload;
+
+    return heap_offer_entry(heap, k, entry);
+}
+
+Optional Common_heap_offer_int(Heap heap, size_t k, long long key, void *payload) {
+    LCOMMON_ASSERT(heap->kind == HEAP_INT_KEYS, "heap isn't ordered by integer keys");
+
+    struct heap_entry_t entry;
+    entry.key.i = key;
+    entry.payload = payload;
+
+    return heap_offer_entry(heap, k, entry);
+}
+
+Optional Common_heap_offer_double(Heap heap, size_t k, double key, void *payload) {
+    LCOMMON_ASSERT(heap->kind == HEAP_DOUBLE_KEYS, "heap isn't ordered by double keys");
+
+    struct heap_entry_t entry;
+    entry.key.d = key;
+    entry.payload = payload;
+
+    return heap_offer_entry(heap, k, entry);
+}
+
+// output sinks
+
+#ifdef IOV_MAX
+#define OUTPUT_SINK_BATCH (IOV_MAX < 1024 ? IOV_MAX : 1024)
+#else
+#define OUTPUT_SINK_BATCH 1024
+#endif
+
+typedef enum output_sink_kind_t {
+    OUTPUT_SINK_FD,
+    OUTPUT_SINK_FILE,
+    OUTPUT_SINK_CALLBACK,
+} OutputSinkKind;
+
+// fd sinks queue pointers to the pieces instead of copying them, so the queue must be
+// flushed before the memory behind them can go away (every public write does so).
+struct output_sink_t {
+    OutputSinkKind kind;
+    int fd;
+    FILE *file;
+    OutputSinkCallback callback;
+    void *context;
+    LCOMMON_BOOL failed;
+    int pending;
+    struct iovec parts[OUTPUT_SINK_BATCH];
+};
+
+static OutputSink output_sink_new(OutputSinkKind kind) {
+    OutputSink sink = Common_smalloc(sizeof(struct output_sink_t));
+
+    sink->kind = kind;
+    sink->fd = -1;
+    sink->file = NULL;
+    sink->callback = NULL;
+    sink->context = NULL;
+    sink->failed = LCOMMON_FALSE;
+    sink->pending = 0;
+
+    return sink;
+}
+
+// writes every queued part, resuming after short writes and signal interruptions.
+static LCOMMON_BOOL output_sink_drain(OutputSink sink) {
+    struct iovec *parts = sink->parts;
+    int count = sink->pending;
+
+    sink->pending = 0;
+
+    while (count > 0 && !sink->failed) {
+        ssize_t written = writev(sink->fd, parts, count);
+        if (written <= 0) {
+            if (written == 0 || errno != EINTR) {
+                sink->failed = LCOMMON_TRUE;
+            }
+            continue;
+        }
+
+        while (count > 0 && (size_t) written >= parts->iov_len) {
+            written -= parts->iov_len;
+            parts++;
+            count--;
+        }
+
+        if (count > 0) {
+            parts->iov_base = (char*) parts->iov_base + written;
+            parts->iov_len -= written;
+        }
+    }
+
+    return !sink->failed;
+}
+
+static void output_sink_emit(OutputSink sink, const char *data, size_t len) {
+    if (len == 0 || sink->failed) {
+        return;
+    }
+
+    switch (sink->kind) {
+        case OUTPUT_SINK_FD:
+            if (sink->pending == OUTPUT_SINK_BATCH) {
+                output_sink_drain(sink);
+            }
+
+            sink->parts[sink->pending].iov_base = (void*) data;
+            sink->parts[sink->pending].iov_len = len;
+            sink->pending++;
+            break;
+
+        case OUTPUT_SINK_FILE:
+            if (fwrite(data, 1, len, sink->file) != len) {
+                sink->failed = LCOMMON_TRUE;
+            }
+            break;
+
+        case OUTPUT_SINK_CALLBACK:
+            if (!sink->callback(sink->context, data, len)) {
+                sink->failed = LCOMMON_TRUE;
+            }
+            break;
+    }
+}
+
+OutputSink Common_output_sink_fd(int fd) {
+    OutputSink sink = output_sink_new(OUTPUT_SINK_FD);
+    sink->fd = fd;
+    return sink;
+}
+
+OutputSink Common_output_sink_file(FILE *file) {
+    OutputSink sink = output_sink_new(OUTPUT_SINK_FILE);
+    sink->file = file;
+    return sink;
+}
+
+OutputSink Common_output_sink_callback(OutputSinkCallback callback, void *context) {
+    LCOMMON_ASSERT(callback != NULL, "a callback sink needs a callback");
+
+    OutputSink sink = output_sink_new(OUTPUT_SINK_CALLBACK);
+    sink->callback = callback;
+    sink->context = context;
+
+    return sink;
+}
+
+LCOMMON_BOOL Common_output_sink_write(OutputSink sink, const char *data, size_t len) {
+    output_sink_emit(sink, data, len);
+    return output_sink_drain(sink);
+}
+
+LCOMMON_BOOL Common_output_sink_write_str(OutputSink sink, const char *s) {
+    return Common_output_sink_write(sink, s, strlen(s));
+}
+
+LCOMMON_BOOL Common_output_sink_write_array(
+    OutputSink sink,
+    const char *separator,
+    const DynamicArray array
+) {
+    size_t separator_len = strlen(separator);
+
+    Common_foreach(array, char, element, {
+        if (i > 0) {
+            output_sink_emit(sink, separator, separator_len);
+        }
+
+        output_sink_emit(sink, element, strlen(element));
+    });
+
+    return output_sink_drain(sink);
+}
+
+LCOMMON_BOOL Common_output_sink_write_optional_array(
+    OutputSink sink,
+    const char *separator,
+    const OptionalArray array
+) {
+    size_t separator_len = strlen(separator);
+    LCOMMON_BOOL first = LCOMMON_TRUE;
+
+    Common_foreach(array, Optional, opt_element, {
+        if (Common_optional_is_none(opt_element)) {
+            continue;
+        }
+
+        if (!first) {
+            output_sink_emit(sink, separator, separator_len);
+        }
+
+        const char *element = Common_optional_unpack(opt_element);
+        output_sink_emit(sink, element, strlen(element));
+        first = LCOMMON_FALSE;
+    });
+
+    return output_sink_drain(sink);
+}
+
+LCOMMON_BOOL Common_output_sink_flush(OutputSink sink) {
+    output_sink_drain(sink);
+
+    if (sink->kind == OUTPUT_SINK_FILE && !sink->failed && fflush(sink->file) != 0) {
+        sink->failed = LCOMMON_TRUE;
+    }
+
+    return !sink->failed;
+}
+
+LCOMMON_BOOL Common_output_sink_destroy(OutputSink sink) {
+    LCOMMON_BOOL ret = Common_output_sink_flush(sink);
+    LCOMMON_FREE(sink);
+    return ret;
+}
+
+LCOMMON_BOOL Common_write_array(int fd, const char *separator, const DynamicArray array) {
+    OutputSink sink = Common_output_sink_fd(fd);
+    Common_output_sink_write_array(sink, separator, array);
+    return Common_output_sink_destroy(sink);
+}
+
+LCOMMON_BOOL Common_write_optional_array(int fd, const char *separator, const OptionalArray array) {
+    OutputSink sink = Common_output_sink_fd(fd);
+    Common_output_sink_write_optional_array(sink, separator, array);
+    return Common_output_sink_destroy(sink);
+}
+
+// batched file io
+
+#define IO_DEFAULT_POOL_BUFFERS 128
+#define IO_DEFAULT_POOL_BUFFER_SIZE (16 * 1024)
+#define IO_RING_ENTRIES 256
+#define IO_BATCH (IO_RING_ENTRIES / 2)
+#define IO_RING_MAX_TRANSFER ((size_t) 1 << 30)
+#define IO_MIN_WORKERS 4
+#define IO_MAX_WORKERS 8
+
+typedef enum io_operation_t {
+    IO_READ_PATHS,
+    IO_READ_FDS,
+    IO_WRITE_PATHS,
+} IoOperation;
+
+// state of one file while its batch goes through the open, transfer and close steps.
+// `cap` is how many bytes the read buffer can hold (without its NUL).
+struct io_item_t {
+    const char *path;
+    int fd;
+    LCOMMON_BOOL owns_fd;
+    LCOMMON_BOOL ok;
+    size_t cap;
+    IoBuffer *buffer;
+};
+
+#if LCOMMON_HAVE_IO_URING
+struct io_ring_t {
+    int fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    void *cq_map;
+    size_t sq_map_size;
+    size_t cq_map_size;
+    size_t sqes_size;
+    unsigned tail;
+    unsigned queued;
+};
+#endif
+
+struct io_workers_t {
+    pthread_t threads[IO_MAX_WORKERS];
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned long generation;
+    size_t busy;
+    LCOMMON_BOOL stopping;
+};
+
+struct io_context_t {
+    char *pool;
+    size_t pool_buffers;
+    size_t pool_buffer_size;
+    size_t *pool_free;
+    size_t pool_free_len;
+    pthread_mutex_t pool_lock;
+
+#if LCOMMON_HAVE_IO_URING
+    struct io_ring_t ring;
+    LCOMMON_BOOL has_ring;
+    LCOMMON_BOOL pool_registered;
+#endif
+
+    struct io_workers_t workers;
+
+    // batch being processed by the fallback workers.
+    IoOperation operation;
+    struct io_item_t *items;
+    size_t items_len;
+    size_t next_item;
+};
+
+static LCOMMON_BOOL io_pool_owns(const IoContext context, const char *data) {
+    return data >= context->pool && data < context->pool + context->pool_buffers * context->pool_buffer_size;
+}
+
+// gives `item` a buffer able to hold `cap` bytes plus a NUL, from the pool when it fits.
+static void io_buffer_new(IoContext context, struct io_item_t *item, size_t cap) {
+    IoBuffer *buffer = Common_smalloc(sizeof(IoBuffer));
+    buffer->data = NULL;
+    buffer->len = 0;
+
+    if (cap < context->pool_buffer_size) {
+        pthread_mutex_lock(&context->pool_lock);
+        if (context->pool_free_len > 0) {
+            size_t index = context->pool_free[--context->pool_free_len];
+            buffer->data = context->pool + index * context->pool_buffer_size;
+            cap = context->pool_buffer_size - 1;
+        }
+        pthread_mutex_unlock(&context->pool_lock);
+    }
+
+    if (buffer->data == NULL) {
+        buffer->data = Common_smalloc(cap + 1);
+    }
+
+    item->buffer = buffer;
+    item->cap = cap;
+}
+
+// moves the contents of the item's buffer into a private one of `cap` bytes.
+static void io_buffer_grow(IoContext context, struct io_item_t *item, size_t cap) {
+    IoBuffer *buffer = item->buffer;
+
+    if (io_pool_owns(context, buffer->data)) {
+        char *data = Common_smalloc(cap + 1);
+        memcpy(data, buffer->data, buffer->len);
+
+        pthread_mutex_lock(&context->pool_lock);
+        context->pool_free[context->pool_free_len++] = (size_t) (buffer->data - context->pool) / context->pool_buffer_size;
+        pthread_mutex_unlock(&context->pool_lock);
+
+        buffer->data = data;
+    } else {
+        buffer->data = Common_srealloc(buffer->data, cap + 1);
+    }
+
+    item->cap = cap;
+}
+
+void Common_io_buffer_release(IoContext context, IoBuffer *buffer) {
+    if (io_pool_owns(context, buffer->data)) {
+        pthread_mutex_lock(&context->pool_lock);
+        context->pool_free[context->pool_free_len++] = (size_t) (buffer->data - context->pool) / context->pool_buffer_size;
+        pthread_mutex_unlock(&context->pool_lock);
+    } else {
+        LCOMMON_FREE(buffer->data);
+    }
+
+    LCOMMON_FREE(buffer);
+}
+
+void Common_io_results_release(IoContext context, OptionalArray results) {
+    Common_foreach(results, Optional, result, {
+        if (Common_optional_is_some(result)) {
+            Common_io_buffer_release(context, Common_optional_unpack(result));
+        }
+    });
+
+    Common_optional_array_destroy(results);
+}
+
+static void io_item_fail(IoContext context, struct io_item_t *item) {
+    if (item->buffer != NULL) {
+        Common_io_buffer_release(context, item->buffer);
+        item->buffer = NULL;
+    }
+
+    item->ok = LCOMMON_FALSE;
+}
+
+// blocking read of the rest of a descriptor, after the `item->buffer->len` bytes already
+// read (if any). Used by the fallback and for files which don't fit a pool buffer.
+static void io_read_blocking(IoContext context, struct io_item_t *item) {
+    struct stat st;
+    if (fstat(item->fd, &st) != 0) {
+        io_item_fail(context, item);
+        return;
+    }
+
+    size_t size = st.st_size > 0 ? (size_t) st.st_size : 0;
+
+    if (item->buffer == NULL) {
+        io_buffer_new(context, item, size > 0 ? size : 4096);
+    } else if (size > item->cap) {
+        io_buffer_grow(context, item, size);
+    }
+
+    size_t len = item->buffer->len;
+
+    // files reporting no size (e.g. /proc) are read until EOF, the others up to their size.
+    while (size == 0 || len < size) {
+        if (len == item->cap) {
+            io_buffer_grow(context, item, item->cap * 2);
+        }
+
+        ssize_t got = pread(item->fd, item->buffer->data + len, item->cap - len, (off_t) len);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            io_item_fail(context, item);
+            return;
+        }
+
+        if (got == 0) {
+            break;
+        }
+
+        len += (size_t) got;
+    }
+
+    item->buffer->data[len] = '\0';
+    item->buffer->len = len;
+    item->ok = LCOMMON_TRUE;
+}
+
+static void io_write_blocking(struct io_item_t *item) {
+    size_t done = 0;
+
+    while (done < item->buffer->len) {
+        ssize_t put = pwrite(item->fd, item->buffer->data + done, item->buffer->len - done, (off_t) done);
+        if (put < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            item->ok = LCOMMON_FALSE;
+            return;
+        }
+
+        done += (size_t) put;
+    }
+
+    item->ok = LCOMMON_TRUE;
+}
+
+// runs a whole item with blocking syscalls, this is what the fallback workers do.
+static void io_run_item_blocking(IoContext context, struct io_item_t *item) {
+    switch (context->operation) {
+        case IO_READ_PATHS:
+            item->fd = open(item->path, O_RDONLY | O_CLOEXEC);
+            break;
+        case IO_WRITE_PATHS:
+            item->fd = open(item->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            break;
+        case IO_READ_FDS:
+            break;
+    }
+
+    if (item->fd < 0) {
+        return;
+    }
+
+    if (context->operation == IO_WRITE_PATHS) {
+        io_write_blocking(item);
+    } else {
+        io_read_blocking(context, item);
+    }
+
+    if (context->operation != IO_READ_FDS) {
+        close(item->fd);
+    }
+}
+
+static void io_drain_items(IoContext context) {
+    size_t i;
+    while ((i = __atomic_fetch_add(&context->next_item, 1, __ATOMIC_RELAXED)) < context->items_len) {
+        io_run_item_blocking(context, &context->items[i]);
+    }
+}
+
+static void *io_worker(void *arg) {
+    IoContext context = arg;
+    struct io_workers_t *workers = &context->workers;
+    unsigned long seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&workers->lock);
+        while (!workers->stopping && workers->generation == seen) {
+            pthread_cond_wait(&workers->wake, &workers->lock);
+        }
+
+        if (workers->stopping) {
+            pthread_mutex_unlock(&workers->lock);
+            return NULL;
+        }
+
+        seen = workers->generation;
+        pthread_mutex_unlock(&workers->lock);
+
+        io_drain_items(context);
+
+        pthread_mutex_lock(&workers->lock);
+        if (--workers->busy == 0) {
+            pthread_cond_signal(&workers->done);
+        }
+        pthread_mutex_unlock(&workers->lock);
+    }
+}
+
+// fallback: spreads the items over the worker threads (started on first use), the
+// calling thread works too.
+static void io_run_blocking(IoContext context, struct io_item_t *items, size_t len) {
+    struct io_workers_t *workers = &context->workers;
+
+    if (workers->count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t wanted = cpus < IO_MIN_WORKERS ? IO_MIN_WORKERS : (cpus > IO_MAX_WORKERS ? IO_MAX_WORKERS : (size_t) cpus);
+
+        for (size_t i = 0; i + 1 < wanted; ++i) {
+            if (pthread_create(&workers->threads[workers->count], NULL, io_worker, context) == 0) {
+                workers->count++;
+            }
+        }
+    }
+
+    context->items = items;
+    context->items_len = len;
+    context->next_item = 0;
+
+    pthread_mutex_lock(&workers->lock);
+    workers->busy = workers->count;
+    workers->generation++;
+    pthread_cond_broadcast(&workers->wake);
+    pthread_mutex_unlock(&workers->lock);
+
+    io_drain_items(context);
+
+    pthread_mutex_lock(&workers->lock);
+    while (workers->busy > 0) {
+        pthread_cond_wait(&workers->done, &workers->lock);
+    }
+    pthread_mutex_unlock(&workers->lock);
+}
+
+#if LCOMMON_HAVE_IO_URING
+static void io_ring_destroy(struct io_ring_t *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    munmap(ring->sq_map, ring->sq_map_size);
+    close(ring->fd);
+}
+
+// io_uring_setup exists since Linux 5.1 but OPENAT, READ, WRITE and CLOSE only came in
+// 5.6, older kernels would fail every request. Probing came in 5.6 too, so a kernel which
+// can't answer doesn't have them either.
+static LCOMMON_BOOL io_ring_probe(struct io_ring_t *ring) {
+    static const unsigned char required[] = {
+        IORING_OP_OPENAT,
+        IORING_OP_READ,
+        IORING_OP_READ_FIXED,
+        IORING_OP_WRITE,
+        IORING_OP_CLOSE,
+    };
+
+    size_t size = sizeof(struct io_uring_probe) + sizeof(struct io_uring_probe_op) * 256;
+    struct io_uring_probe *probe = Common_smalloc(size);
+    memset(probe, 0, size);
+
+    LCOMMON_BOOL ok = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+
+    for (size_t i = 0; ok && i < sizeof(required); ++i) {
+        ok = required[i] <= probe->last_op && (probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    LCOMMON_FREE(probe);
+
+    return ok;
+}
+
+static LCOMMON_BOOL io_ring_init(struct io_ring_t *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return LCOMMON_FALSE;
+    }
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_map = ring->sq_map;
+    if (ring->sq_map != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = MAP_FAILED;
+    if (ring->sq_map != MAP_FAILED && ring->cq_map != MAP_FAILED) {
+        ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    }
+
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map) {
+            munmap(ring->cq_map, ring->cq_map_size);
+        }
+        if (ring->sq_map != MAP_FAILED) {
+            munmap(ring->sq_map, ring->sq_map_size);
+        }
+        close(ring->fd);
+        return LCOMMON_FALSE;
+    }
+
+    char *sq = ring->sq_map;
+    char *cq = ring->cq_map;
+
+    ring->sq_tail = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    ring->tail = *ring->sq_tail;
+    ring->queued = 0;
+
+    if (!io_ring_probe(ring)) {
+        io_ring_destroy(ring);
+        return LCOMMON_FALSE;
+    }
+
+    return LCOMMON_TRUE;
+}
+
+// returns a cleared submission entry, nothing reaches the kernel until `io_ring_run()`.
+static struct io_uring_sqe *io_ring_sqe(struct io_ring_t *ring, unsigned long long user_data) {
+    unsigned index = ring->tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    ring->tail++;
+    ring->queued++;
+
+    return sqe;
+}
+
+// submits every queued entry with a single syscall and waits for all their completions,
+// stores the result of each one in `results[user_data]`. Returns LCOMMON_FALSE if the
+// ring itself failed.
+static LCOMMON_BOOL io_ring_run(struct io_ring_t *ring, int *results) {
+    unsigned expected = ring->queued;
+    unsigned submitted = 0;
+    unsigned completed = 0;
+
+    __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+    ring->queued = 0;
+
+    while (completed < expected) {
+        long ret = syscall(__NR_io_uring_enter, ring->fd, expected - submitted, expected - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return LCOMMON_FALSE;
+        }
+
+        submitted += (unsigned) ret;
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            results[cqe->user_data] = cqe->res;
+            completed++;
+        }
+
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return LCOMMON_TRUE;
+}
+
+static void io_ring_close(IoContext context, struct io_item_t *item, unsigned long long user_data) {
+    struct io_uring_sqe *sqe = io_ring_sqe(&context->ring, user_data);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = item->fd;
+    item->owns_fd = LCOMMON_FALSE;
+}
+
+// first step: opens every path of the batch at once. Sizes aren't asked for, statx is
+// always punted to io_uring's worker threads which costs more than the reads themselves.
+static LCOMMON_BOOL io_ring_open(IoContext context, IoOperation operation, struct io_item_t *items, size_t len, int *results) {
+    for (size_t i = 0; i < len; ++i) {
+        struct io_uring_sqe *sqe = io_ring_sqe(&context->ring, i);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uintptr_t) items[i].path;
+
+        if (operation == IO_WRITE_PATHS) {
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            sqe->len = 0644;
+        } else {
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        }
+    }
+
+    if (!io_ring_run(&context->ring, results)) {
+        return LCOMMON_FALSE;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        items[i].fd = results[i];
+        items[i].owns_fd = items[i].fd >= 0;
+        items[i].ok = items[i].fd >= 0;
+    }
+
+    return LCOMMON_TRUE;
+}
+
+// second step for reads: every file is read into a pool sized buffer at once, files which
+// fill it are finished with blocking calls. Then every descriptor we opened is closed in
+// one more submission.
+static LCOMMON_BOOL io_ring_read(IoContext context, struct io_item_t *items, size_t len, int *results) {
+    for (size_t i = 0; i < len; ++i) {
+        struct io_item_t *item = &items[i];
+        if (!item->ok) {
+            continue;
+        }
+
+        io_buffer_new(context, item, context->pool_buffer_size - 1);
+
+        struct io_uring_sqe *sqe = io_ring_sqe(&context->ring, i);
+        sqe->fd = item->fd;
+        sqe->addr = (uintptr_t) item->buffer->data;
+        sqe->len = (unsigned) item->cap;
+
+        if (context->pool_registered && io_pool_owns(context, item->buffer->data)) {
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->buf_index = (unsigned short) ((size_t) (item->buffer->data - context->pool) / context->pool_buffer_size);
+        } else {
+            sqe->opcode = IORING_OP_READ;
+        }
+    }
+
+    if (!io_ring_run(&context->ring, results)) {
+        return LCOMMON_FALSE;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        struct io_item_t *item = &items[i];
+        if (!item->ok) {
+            continue;
+        }
+
+        if (results[i] < 0) {
+            io_item_fail(context, item);
+        } else {
+            item->buffer->len = (size_t) results[i];
+
+            if (item->buffer->len == item->cap) {
+                io_read_blocking(context, item);
+            } else {
+                item->buffer->data[item->buffer->len] = '\0';
+            }
+        }
+
+        if (item->owns_fd) {
+            io_ring_close(context, item, i);
+        }
+    }
+
+    return io_ring_run(&context->ring, results);
+}
+
+// second step for writes: every write is hard linked with the close of its descriptor,
+// so both happen in one submission and the close runs even if the write fails.
+static LCOMMON_BOOL io_ring_write(IoContext context, struct io_item_t *items, size_t len, int *results) {
+    for (size_t i = 0; i < len; ++i) {
+        struct io_item_t *item = &items[i];
+        size_t size = item->buffer->len;
+
+        results[i] = 0;
+        if (!item->owns_fd) {
+            continue;
+        }
+
+        if (size > IO_RING_MAX_TRANSFER) {
+            io_write_blocking(item);
+        } else if (size > 0) {
+            struct io_uring_sqe *sqe = io_ring_sqe(&context->ring, i);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = item->fd;
+            sqe->addr = (uintptr_t) item->buffer->data;
+            sqe->len = (unsigned) size;
+            sqe->flags |= IOSQE_IO_HARDLINK;
+        }
+
+        io_ring_close(context, item, len + i);
+    }
+
+    if (!io_ring_run(&context->ring, results)) {
+        return LCOMMON_FALSE;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        struct io_item_t *item = &items[i];
+        size_t size = item->buffer->len;
+
+        if (item->ok && size > 0 && size <= IO_RING_MAX_TRANSFER) {
+            item->ok = results[i] >= 0 && (size_t) results[i] == size;
+        }
+    }
+
+    return LCOMMON_TRUE;
+}
+#endif
+
+#if LCOMMON_HAVE_IO_URING
+// the ring itself failed (io_uring_enter errors are about the ring, not the files) in the
+// middle of `batch`: the ring is torn down, this context carries on with the blocking
+// fallback and `batch` is reset so it can be run again from scratch. Descriptors whose
+// open or close was lost with the ring can't be known and aren't touched.
+static void io_ring_abandon(IoContext context, IoOperation operation, struct io_item_t *batch, size_t len) {
+    io_ring_destroy(&context->ring);
+    context->has_ring = LCOMMON_FALSE;
+    context->pool_registered = LCOMMON_FALSE;
+
+    for (size_t i = 0; i < len; ++i) {
+        struct io_item_t *item = &batch[i];
+
+        if (item->owns_fd) {
+            close(item->fd);
+        }
+
+        // written buffers belong to the caller.
+        if (operation != IO_WRITE_PATHS && item->buffer != NULL) {
+            io_item_fail(context, item);
+        }
+
+        item->ok = LCOMMON_FALSE;
+        item->owns_fd = LCOMMON_FALSE;
+        item->cap = 0;
+    }
+}
+#endif
+
+// runs a whole operation over `items`, through io_uring in batches when possible.
+static void io_run(IoContext context, IoOperation operation, struct io_item_t *items, size_t len) {
+    context->operation = operation;
+
+    for (size_t i = 0; i < len; ++i) {
+        items[i].ok = LCOMMON_FALSE;
+        items[i].owns_fd = LCOMMON_FALSE;
+        items[i].cap = 0;
+    }
+
+#if LCOMMON_HAVE_IO_URING
+    if (context->has_ring) {
+        int results[IO_BATCH * 2];
+
+        for (size_t at = 0; at < len; at += IO_BATCH) {
+            size_t n = len - at < IO_BATCH ? len - at : IO_BATCH;
+            struct io_item_t *batch = items + at;
+            LCOMMON_BOOL ok = LCOMMON_TRUE;
+
+            if (operation == IO_READ_FDS) {
+                for (size_t i = 0; i < n; ++i) {
+                    batch[i].ok = batch[i].fd >= 0;
+                }
+            } else {
+                ok = io_ring_open(context, operation, batch, n, results);
+            }
+
+            ok = ok && (operation == IO_WRITE_PATHS
+                ? io_ring_write(context, batch, n, results)
+                : io_ring_read(context, batch, n, results));
+
+            if (!ok) {
+                io_ring_abandon(context, operation, batch, n);
+                io_run_blocking(context, batch, len - at);
+                return;
+            }
+        }
+
+        return;
+    }
+#endif
+
+    io_run_blocking(context, items, len);
+}
+
+IoContext Common_io_init(size_t pool_buffers, size_t pool_buffer_size) {
+    IoContext context = Common_smalloc(sizeof(struct io_context_t));
+
+    context->pool_buffers = pool_buffers > 0 ? pool_buffers : IO_DEFAULT_POOL_BUFFERS;
+    context->pool_buffer_size = pool_buffer_size > 1 ? pool_buffer_size : IO_DEFAULT_POOL_BUFFER_SIZE;
+    context->pool = mmap(NULL, context->pool_buffers * context->pool_buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (context->pool == MAP_FAILED) {
+        die("mmap");
+    }
+
+    context->pool_free = Common_smalloc(sizeof(size_t) * context->pool_buffers);
+    context->pool_free_len = context->pool_buffers;
+    for (size_t i = 0; i < context->pool_buffers; ++i) {
+        context->pool_free[i] = context->pool_buffers - 1 - i;
+    }
+
+    pthread_mutex_init(&context->pool_lock, NULL);
+
+    memset(&context->workers, 0, sizeof(struct io_workers_t));
+    pthread_mutex_init(&context->workers.lock, NULL);
+    pthread_cond_init(&context->workers.wake, NULL);
+    pthread_cond_init(&context->workers.done, NULL);
+
+#if LCOMMON_HAVE_IO_URING
+    context->has_ring = io_ring_init(&context->ring, IO_RING_ENTRIES);
+    context->pool_registered = LCOMMON_FALSE;
+
+    // registering the pool pins it once instead of on every read, if the kernel refuses
+    // (e.g. locked memory limits) plain reads are used instead.
+    if (context->has_ring && context->pool_buffers <= UINT16_MAX) {
+        struct iovec *parts = Common_smalloc(sizeof(struct iovec) * context->pool_buffers);
+        for (size_t i = 0; i < context->pool_buffers; ++i) {
+            parts[i].iov_base = context->pool + i * context->pool_buffer_size;
+            parts[i].iov_len = context->pool_buffer_size;
+        }
+
+        context->pool_registered = syscall(__NR_io_uring_register, context->ring.fd, IORING_REGISTER_BUFFERS, parts, (unsigned) context->pool_buffers) == 0;
+        LCOMMON_FREE(parts);
+    }
+#endif
+
+    return context;
+}
+
+LCOMMON_BOOL Common_io_uses_io_uring(const IoContext context) {
+#if LCOMMON_HAVE_IO_URING
+    return context->has_ring;
+#else
+    (void) context;
+    return LCOMMON_FALSE;
+#endif
+}
+
+// turns the items of a read into an OptionalArray<IoBuffer*>, failed items become None.
+static OptionalArray io_collect(struct io_item_t *items, size_t len) {
+    void **buffers = Common_smalloc(sizeof(void*) * (len > 0 ? len : 1));
+
+    for (size_t i = 0; i < len; ++i) {
+        buffers[i] = items[i].ok ? items[i].buffer : NULL;
+    }
+
+    OptionalArray results = Common_optional_array_from_buffer(buffers, len);
+    LCOMMON_FREE(buffers);
+
+    return results;
+}
+
+OptionalArray Common_io_read_files(IoContext context, const DynamicArray paths) {
+    struct io_item_t *items = Common_smalloc(sizeof(struct io_item_t) * (paths->len > 0 ? paths->len : 1));
+
+    for (size_t i = 0; i < paths->len; ++i) {
+        items[i].path = paths->elements[i];
+        items[i].fd = -1;
+        items[i].buffer = NULL;
+    }
+
+    io_run(context, IO_READ_PATHS, items, paths->len);
+
+    OptionalArray results = io_collect(items, paths->len);
+    LCOMMON_FREE(items);
+
+    return results;
+}
+
+OptionalArray Common_io_read_fds(IoContext context, const int *fds, size_t n) {
+    struct io_item_t *items = Common_smalloc(sizeof(struct io_item_t) * (n > 0 ? n : 1));
+
+    for (size_t i = 0; i < n; ++i) {
+        items[i].path = NULL;
+        items[i].fd = fds[i];
+        items[i].buffer = NULL;
+    }
+
+    io_run(context, IO_READ_FDS, items, n);
+
+    OptionalArray results = io_collect(items, n);
+    LCOMMON_FREE(items);
+
+    return results;
+}
+
+size_t Common_io_write_files(
+    IoContext context,
+    const DynamicArray paths,
+    const DynamicArray buffers,
+    LCOMMON_BOOL *written
+) {
+    LCOMMON_ASSERT(paths->len == buffers->len, "every path needs a buffer to write");
+
+    struct io_item_t *items = Common_smalloc(sizeof(struct io_item_t) * (paths->len > 0 ? paths->len : 1));
+
+    for (size_t i = 0; i < paths->len; ++i) {
+        items[i].path = paths->elements[i];
+        items[i].fd = -1;
+        items[i].buffer = buffers->elements[i];
+    }
+
+    io_run(context, IO_WRITE_PATHS, items, paths->len);
+
+    size_t ok = 0;
+    for (size_t i = 0; i < paths->len; ++i) {
+        ok += items[i].ok ? 1 : 0;
+        if (written != NULL) {
+            written[i] = items[i].ok;
+        }
+    }
+
+    LCOMMON_FREE(items);
+
+    return ok;
+}
+
+void Common_io_destroy(IoContext context) {
+    struct io_workers_t *workers = &context->workers;
+
+    pthread_mutex_lock(&workers->lock);
+    workers->stopping = LCOMMON_TRUE;
+    pthread_cond_broadcast(&workers->wake);
+    pthread_mutex_unlock(&workers->lock);
+
+    for (size_t i = 0; i < workers->count; ++i) {
+        pthread_join(workers->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&workers->lock);
+    pthread_cond_destroy(&workers->wake);
+    pthread_cond_destroy(&workers->done);
+
+#if LCOMMON_HAVE_IO_URING
+    if (context->has_ring) {
+        io_ring_destroy(&context->ring);
+    }
+#endif
+
+    pthread_mutex_destroy(&context->pool_lock);
+    munmap(context->pool, context->pool_buffers * context->pool_buffer_size);
+    LCOMMON_FREE(context->pool_free);
+    LCOMMON_FREE(context);
+}
+
+// slot maps
+
+#define SLOTMAP_INITIAL_CAP 16
+#define SLOTMAP_NO_SLOT 0xffffffffu
+
+#define SLOTMAP_HANDLE(slot, generation) (((SlotMapHandle) (generation) << 32) | (slot))
+#define SLOTMAP_HANDLE_SLOT(handle) ((unsigned) ((handle) & 0xffffffffu))
+#define SLOTMAP_HANDLE_GENERATION(handle) ((unsigned) ((handle) >> 32))
+
+SlotMap Common_slotmap_init(void) {
+    SlotMap map = Common_smalloc(sizeof(struct slotmap_t));
+
+    map->len = 0;
+    map->cap = SLOTMAP_INITIAL_CAP;
+    map->elements = Common_smalloc(sizeof(void*) * map->cap);
+    map->slot_of = Common_smalloc(sizeof(unsigned) * map->cap);
+    map->slots_len = 0;
+    map->slots_cap = SLOTMAP_INITIAL_CAP;
+    map->slots = Common_smalloc(sizeof(struct slotmap_slot_t) * map->slots_cap);
+    map->free_slot = SLOTMAP_NO_SLOT;
+
+    return map;
+}
+
+// returns the slot of a handle if it's still live, NULL otherwise. Freed slots already
+// carry the next generation so no handle given out so far can match them.
+static struct slotmap_slot_t *slotmap_lookup(const SlotMap map, SlotMapHandle handle) {
+    unsigned slot = SLOTMAP_HANDLE_SLOT(handle);
+
+    if (slot >= map->slots_len || map->slots[slot].generation != SLOTMAP_HANDLE_GENERATION(handle)) {
+        return NULL;
+    }
+
+    return &map->slots[slot];
+}
+
+SlotMapHandle Common_slotmap_insert(SlotMap map, void *element) {
+    unsigned slot;
+
+    if (map->free_slot != SLOTMAP_NO_SLOT) {
+        slot = map->free_slot;
+        map->free_slot = map->slots[slot].index;
+    } else {
+        LCOMMON_ASSERT(map->slots_len < SLOTMAP_NO_SLOT, "slot map can't hold more than 2^32 - 1 slots");
+
+        if (map->slots_len == map->slots_cap) {
+            map->slots_cap *= 2;
+            map->slots = Common_srealloc(map->slots, sizeof(struct slotmap_slot_t) * map->slots_cap);
+        }
+
+        slot = (unsigned) map->slots_len++;
+        // generation 0 is never used so that LCOMMON_SLOTMAP_NULL_HANDLE stays invalid.
+        map->slots[slot].generation = 1;
+    }
+
+    if (map->len == map->cap) {
+        map->cap *= 2;
+        map->elements = Common_srealloc(map->elements, sizeof(void*) * map->cap);
+        map->slot_of = Common_srealloc(map->slot_of, sizeof(unsigned) * map->cap);
+    }
+
+    map->slots[slot].index = (unsigned) map->len;
+    map->elements[map->len] = element;
+    map->slot_of[map->len] = slot;
+    map->len++;
+
+    return SLOTMAP_HANDLE(slot, map->slots[slot].generation);
+}
+
+Optional Common_slotmap_get(const SlotMap map, SlotMapHandle handle) {
+    struct slotmap_slot_t *slot = slotmap_lookup(map, handle);
+    return slot != NULL ? Common_optional_with(map->elements[slot->index]) : Common_optional_none();
+}
+
+LCOMMON_BOOL Common_slotmap_contains(const SlotMap map, SlotMapHandle handle) {
+    return slotmap_lookup(map, handle) != NULL;
+}
+
+LCOMMON_BOOL Common_slotmap_set(SlotMap map, SlotMapHandle handle, void *element) {
+    struct slotmap_slot_t *slot = slotmap_lookup(map, handle);
+    if (slot == NULL) {
+        return LCOMMON_FALSE;
+    }
+
+    map->elements[slot->index] = element;
+    return LCOMMON_TRUE;
+}
+
+Optional Common_slotmap_remove(SlotMap map, SlotMapHandle handle) {
+    struct slotmap_slot_t *slot = slotmap_lookup(map, handle);
+    if (slot == NULL) {
+        return Common_optional_none();
+    }
+
+    unsigned index = slot->index;
+    void *element = map->elements[index];
+
+    // the last element fills the hole so the storage stays dense.
+    size_t last = --map->len;
+    if (index != last) {
+        map->elements[index] = map->elements[last];
+        map->slot_of[index] = map->slot_of[last];
+        map->slots[map->slot_of[index]].index = index;
+    }
+
+    if (++slot->generation == 0) {
+        slot->generation = 1;
+    }
+
+    slot->index = map->free_slot;
+    map->free_slot = SLOTMAP_HANDLE_SLOT(handle);
+
+    return Common_optional_with(element);
+}
+
+SlotMapHandle Common_slotmap_handle_at(const SlotMap map, size_t n) {
+    LCOMMON_ASSERT(n < map->len, "index should be inside the slot map");
+
+    unsigned slot = map->slot_of[n];
+    return SLOTMAP_HANDLE(slot, map->slots[slot].generation);
+}
+
+void Common_slotmap_clear(SlotMap map) {
+    for (size_t i = 0; i < map->len; ++i) {
+        struct slotmap_slot_t *slot = &map->slots[map->slot_of[i]];
+
+        if (++slot->generation == 0) {
+            slot->generation = 1;
+        }
+
+        slot->index = map->free_slot;
+        map->free_slot = map->slot_of[i];
+    }
+
+    map->len = 0;
+}
+
+void Common_slotmap_destroy(SlotMap map) {
+    LCOMMON_FREE(map->elements);
+    LCOMMON_FREE(map->slot_of);
+    LCOMMON_FREE(map->slots);
+    LCOMMON_FREE(map);
+}
+
+void Common_slotmap_free(SlotMap map) {
+    for (size_t i = 0; i < map->len; ++i) {
+        LCOMMON_FREE(map->elements[i]);
+    }
+
+    Common_slotmap_destroy(map);
+}
+
+// approximate membership filters
+
+#define BLOOM_MAGIC "LCBLOOM1"
+#define BLOOM_SEED 0x5f3759df9e3779b9ULL
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_BLOCK_SIZE (BLOOM_BLOCK_WORDS * sizeof(uint32_t))
+#define BLOOM_BATCH 16
+
+// odd constants spreading the low 32 bits of a hash over the 8 words of a block, they're
+// the ones used by Impala and Parquet so filters behave like theirs.
+#define BLOOM_SALTS \
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, \
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+
+static const uint32_t bloom_salts[BLOOM_BLOCK_WORDS] = { BLOOM_SALTS };
+
+struct bloom_filter_t {
+    uint32_t *blocks;
+    size_t blocks_len;
+};
+
+struct bloom_header_t {
+    char magic[8];
+    uint64_t blocks_len;
+};
+
+// false positive rate of a split block filter holding `bits_per_key` bits per string: the
+// amount of strings landing in a block is Poisson distributed, and a string with `n`
+// others in its block is a false positive if its 8 bits were all set by them.
+static double bloom_false_positive_rate(double bits_per_key) {
+    // the Poisson terms are summed unnormalized (without e^-lambda) to not need libm.
+    double lambda = BLOOM_BLOCK_SIZE * 8 / bits_per_key;
+    double term = 1;
+    double terms = 0;
+    double rate = 0;
+    double unset = 1;
+
+    for (size_t n = 0; n < (size_t) (lambda * 4) + 32; ++n) {
+        if (n > 0) {
+            term *= lambda / (double) n;
+            unset *= 1 - 1.0 / 32;
+        }
+
+        double set = 1 - unset;
+        set *= set;
+        set *= set;
+        set *= set;
+
+        terms += term;
+        rate += term * set;
+    }
+
+    return rate / terms;
+}
+
+static BloomFilter bloom_filter_alloc(size_t blocks_len) {
+    BloomFilter filter = Common_smalloc(sizeof(struct bloom_filter_t));
+
+    // blocks are cache line aligned so a probe never straddles two lines.
+    if (posix_memalign((void**) &filter->blocks, 64, blocks_len * BLOOM_BLOCK_SIZE) != 0) {
+        die("posix_memalign");
+    }
+
+    filter->blocks_len = blocks_len;
+
+    return filter;
+}
+
+BloomFilter Common_bloom_filter_init(size_t expected_len, double false_positive_rate) {
+    LCOMMON_ASSERT(false_positive_rate > 0 && false_positive_rate < 1, "false positive rate should be between 0 and 1");
+
+    double bits_per_key = 4;
+    while (bits_per_key < 64 && bloom_false_positive_rate(bits_per_key) > false_positive_rate) {
+        bits_per_key += 0.5;
+    }
+
+    size_t bits = (size_t) (bits_per_key * (double) (expected_len > 0 ? expected_len : 1));
+    size_t blocks_len = (bits + BLOOM_BLOCK_SIZE * 8 - 1) / (BLOOM_BLOCK_SIZE * 8);
+
+    BloomFilter filter = bloom_filter_alloc(blocks_len);
+    memset(filter->blocks, 0, blocks_len * BLOOM_BLOCK_SIZE);
+
+    return filter;
+}
+
+void Common_bloom_filter_destroy(BloomFilter filter) {
+    LCOMMON_FREE(filter->blocks);
+    LCOMMON_FREE(filter);
+}
+
+// the high 32 bits of the hash pick the block (without a division), the low ones the bits.
+static inline uint32_t *bloom_block(const BloomFilter filter, uint64_t hash) {
+    return filter->blocks + (((hash >> 32) * filter->blocks_len) >> 32) * BLOOM_BLOCK_WORDS;
+}
+
+static inline void bloom_block_add_scalar(uint32_t *block, uint32_t key) {
+    for (size_t i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+        block[i] |= (uint32_t) 1 << ((key * bloom_salts[i]) >> 27);
+    }
+}
+
+static inline LCOMMON_BOOL bloom_block_check_scalar(const uint32_t *block, uint32_t key) {
+    for (size_t i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+        if (!(block[i] & ((uint32_t) 1 << ((key * bloom_salts[i]) >> 27)))) {
+            return LCOMMON_FALSE;
+        }
+    }
+
+    return LCOMMON_TRUE;
+}
+
+#if LCOMMON_HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static inline __m256i bloom_block_mask_avx2(uint32_t key) {
+    __m256i bits = _mm256_mullo_epi32(_mm256_set1_epi32((int) key), _mm256_setr_epi32(BLOOM_SALTS));
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), _mm256_srli_epi32(bits, 27));
+}
+
+__attribute__((target("avx2")))
+static void bloom_block_add_avx2(uint32_t *block, uint32_t key) {
+    __m256i *words = (__m256i*) block;
+    _mm256_store_si256(words, _mm256_or_si256(_mm256_load_si256(words), bloom_block_mask_avx2(key)));
+}
+
+__attribute__((target("avx2")))
+static LCOMMON_BOOL bloom_block_check_avx2(const uint32_t *block, uint32_t key) {
+    return _mm256_testc_si256(_mm256_load_si256((const __m256i*) block), bloom_block_mask_avx2(key));
+}
+#endif
+
+static inline void bloom_block_add(uint32_t *block, uint32_t key) {
+#if LCOMMON_HAVE_X86_SIMD
+    if (simd_has_avx2()) {
+        bloom_block_add_avx2(block, key);
+        return;
+    }
+#endif
+
+    bloom_block_add_scalar(block, key);
+}
+
+static inline LCOMMON_BOOL bloom_block_check(const uint32_t *block, uint32_t key) {
+#if LCOMMON_HAVE_X86_SIMD
+    if (simd_has_avx2()) {
+        return bloom_block_check_avx2(block, key);
+    }
+#endif
+
+    return bloom_block_check_scalar(block, key);
+}
+
+void Common_bloom_filter_add(BloomFilter filter, const char *s) {
+    uint64_t hash = Common_hash_str(s, BLOOM_SEED);
+    bloom_block_add(bloom_block(filter, hash), (uint32_t) hash);
+}
+
+LCOMMON_BOOL Common_bloom_filter_may_contain(const BloomFilter filter, const char *s) {
+    uint64_t hash = Common_hash_str(s, BLOOM_SEED);
+    return bloom_block_check(bloom_block(filter, hash), (uint32_t) hash);
+}
+
+// hashes a group of strings and prefetches their blocks, so the misses of the whole group
+// overlap instead of being paid one after the other.
+static size_t bloom_hash_batch(const BloomFilter filter, const DynamicArray strings, size_t at, uint64_t *hashes) {
+    size_t n = strings->len - at < BLOOM_BATCH ? strings->len - at : BLOOM_BATCH;
+
+    for (size_t i = 0; i < n; ++i) {
+        LCOMMON_ASSERT(strings->elements[at + i] != NULL, "should be able to obtain elements from a growable array");
+        hashes[i] = Common_hash_str(strings->elements[at + i], BLOOM_SEED);
+        __builtin_prefetch(bloom_block(filter, hashes[i]));
+    }
+
+    return n;
+}
+
+void Common_bloom_filter_add_array(BloomFilter filter, const DynamicArray strings) {
+    uint64_t hashes[BLOOM_BATCH];
+
+    for (size_t at = 0; at < strings->len; at += BLOOM_BATCH) {
+        size_t n = bloom_hash_batch(filter, strings, at, hashes);
+
+        for (size_t i = 0; i < n; ++i) {
+            bloom_block_add(bloom_block(filter, hashes[i]), (uint32_t) hashes[i]);
+        }
+    }
+}
+
+size_t Common_bloom_filter_may_contain_array(
+    const BloomFilter filter,
+    const DynamicArray strings,
+    LCOMMON_BOOL *results
+) {
+    uint64_t hashes[BLOOM_BATCH];
+    size_t found = 0;
+
+    for (size_t at = 0; at < strings->len; at += BLOOM_BATCH) {
+        size_t n = bloom_hash_batch(filter, strings, at, hashes);
+
+        for (size_t i = 0; i < n; ++i) {
+            LCOMMON_BOOL maybe = bloom_block_check(bloom_block(filter, hashes[i]), (uint32_t) hashes[i]);
+            found += maybe ? 1 : 0;
+
+            if (results != NULL) {
+                results[at + i] = maybe;
+            }
+        }
+    }
+
+    return found;
+}
+
+size_t Common_bloom_filter_size(const BloomFilter filter) {
+    return filter->blocks_len * BLOOM_BLOCK_SIZE;
+}
+
+void *Common_bloom_filter_serialize(const BloomFilter filter, size_t *len) {
+    size_t size = Common_bloom_filter_size(filter);
+    char *data = Common_smalloc(sizeof(struct bloom_header_t) + size);
+
+    struct bloom_header_t header;
+    memcpy(header.magic, BLOOM_MAGIC, sizeof(header.magic));
+    header.blocks_len = filter->blocks_len;
+
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), filter->blocks, size);
+    *len = sizeof(header) + size;
+
+    return data;
+}
+
+Optional Common_bloom_filter_deserialize(const void *data, size_t len) {
+    struct bloom_header_t header;
+
+    if (len < sizeof(header)) {
+        return Common_optional_none();
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, BLOOM_MAGIC, sizeof(header.magic)) != 0
+        || header.blocks_len == 0
+        || header.blocks_len > (len - sizeof(header)) / BLOOM_BLOCK_SIZE
+        || header.blocks_len * BLOOM_BLOCK_SIZE != len - sizeof(header)) {
+        return Common_optional_none();
+    }
+
+    BloomFilter filter = bloom_filter_alloc(header.blocks_len);
+    memcpy(filter->blocks, (const char*) data + sizeof(header), len - sizeof(header));
+
+    return Common_optional_with(filter);
+}
+
+// xor8 filter, see "Xor Filters: Faster and Smaller Than Bloom and Cuckoo Filters".
+
+#define XOR_FILTER_MAX_ATTEMPTS 64
+
+struct xor_filter_t {
+    uint64_t seed;
+    uint32_t block_len;
+    uint8_t *fingerprints;
+};
+
+// what every slot knows while peeling: how many keys map to it and the xor of their hashes,
+// which is the hash of the last one once the count drops to 1.
+struct xor_filter_slot_t {
+    uint64_t hashes;
+    uint32_t count;
+};
+
+struct xor_filter_peeled_t {
+    uint64_t hash;
+    uint32_t slot;
+};
+
+static inline uint32_t xor_filter_reduce(uint32_t hash, uint32_t n) {
+    return (uint32_t) (((uint64_t) hash * n) >> 32);
+}
+
+static inline uint8_t xor_filter_fingerprint(uint64_t hash) {
+    return (uint8_t) (hash ^ (hash >> 32));
+}
+
+static inline void xor_filter_slots(const XorFilter filter, uint64_t hash, uint32_t slots[3]) {
+    slots[0] = xor_filter_reduce((uint32_t) hash, filter->block_len);
+    slots[1] = xor_filter_reduce((uint32_t) ((hash << 21) | (hash >> 43)), filter->block_len) + filter->block_len;
+    slots[2] = xor_filter_reduce((uint32_t) ((hash << 42) | (hash >> 22)), filter->block_len) + 2 * filter->block_len;
+}
+
+static int xor_filter_compare_keys(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+// one construction attempt with the filter's seed, fails if the keys can't all be peeled.
+static LCOMMON_BOOL xor_filter_try_build(
+    XorFilter filter,
+    const uint64_t *keys,
+    size_t len,
+    struct xor_filter_slot_t *slots,
+    uint32_t *queue,
+    struct xor_filter_peeled_t *stack
+) {
+    size_t capacity = (size_t) filter->block_len * 3;
+    memset(slots, 0, sizeof(struct xor_filter_slot_t) * capacity);
+
+    for (size_t i = 0; i < len; ++i) {
+        uint64_t hash = Common_hash_u64(keys[i], filter->seed);
+        uint32_t at[3];
+        xor_filter_slots(filter, hash, at);
+
+        for (size_t j = 0; j < 3; ++j) {
+            slots[at[j]].hashes ^= hash;
+            slots[at[j]].count++;
+        }
+    }
+
+    size_t queue_len = 0;
+    for (size_t i = 0; i < capacity; ++i) {
+        if (slots[i].count == 1) {
+            queue[queue_len++] = (uint32_t) i;
+        }
+    }
+
+    size_t stack_len = 0;
+    while (queue_len > 0) {
+        uint32_t slot = queue[--queue_len];
+        if (slots[slot].count != 1) {
+            continue;
+        }
+
+        uint64_t hash = slots[slot].hashes;
+        stack[stack_len].hash = hash;
+        stack[stack_len].slot = slot;
+        stack_len++;
+
+        uint32_t at[3];
+        xor_filter_slots(filter, hash, at);
+
+        for (size_t j = 0; j < 3; ++j) {
+            slots[at[j]].hashes ^= hash;
+            if (--slots[at[j]].count == 1) {
+                queue[queue_len++] = at[j];
+            }
+        }
+    }
+
+    if (stack_len != len) {
+        return LCOMMON_FALSE;
+    }
+
+    // keys peeled last are assigned first, the slot each one owns is still free by then.
+    memset(filter->fingerprints, 0, capacity);
+
+    while (stack_len > 0) {
+        struct xor_filter_peeled_t peeled = stack[--stack_len];
+        uint32_t at[3];
+        xor_filter_slots(filter, peeled.hash, at);
+
+        filter->fingerprints[peeled.slot] = xor_filter_fingerprint(peeled.hash)
+            ^ filter->fingerprints[at[0]] ^ filter->fingerprints[at[1]] ^ filter->fingerprints[at[2]];
+    }
+
+    return LCOMMON_TRUE;
+}
+
+XorFilter Common_xor_filter_build(const DynamicArray strings) {
+    // the same key twice can never be peeled, so the hashed keys are deduplicated first.
+    uint64_t *keys = Common_smalloc(sizeof(uint64_t) * (strings->len > 0 ? strings->len : 1));
+    size_t len = 0;
+
+    Common_foreach(strings, const char, s, {
+        keys[len++] = Common_hash_str(s, 0);
+    });
+
+    qsort(keys, len, sizeof(uint64_t), xor_filter_compare_keys);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (unique == 0 || keys[unique - 1] != keys[i]) {
+            keys[unique++] = keys[i];
+        }
+    }
+
+    LCOMMON_ASSERT(unique < (size_t) UINT32_MAX / 2, "too many strings for a xor filter");
+
+    XorFilter filter = Common_smalloc(sizeof(struct xor_filter_t));
+    filter->block_len = (uint32_t) ((32 + 1.23 * (double) unique) / 3) + 1;
+
+    size_t capacity = (size_t) filter->block_len * 3;
+    filter->fingerprints = Common_smalloc(capacity);
+
+    struct xor_filter_slot_t *slots = Common_smalloc(sizeof(struct xor_filter_slot_t) * capacity);
+    uint32_t *queue = Common_smalloc(sizeof(uint32_t) * capacity);
+    struct xor_filter_peeled_t *stack = Common_smalloc(sizeof(struct xor_filter_peeled_t) * (unique > 0 ? unique : 1));
+
+    LCOMMON_BOOL built = LCOMMON_FALSE;
+    for (size_t attempt = 0; attempt < XOR_FILTER_MAX_ATTEMPTS && !built; ++attempt) {
+        filter->seed = Common_hash_u64(attempt, BLOOM_SEED);
+        built = xor_filter_try_build(filter, keys, unique, slots, queue, stack);
+    }
+
+    LCOMMON_ASSERT(built, "xor filter construction should succeed with distinct keys");
+
+    LCOMMON_FREE(keys);
+    LCOMMON_FREE(slots);
+    LCOMMON_FREE(queue);
+    LCOMMON_FREE(stack);
+
+    return filter;
+}
+
+void Common_xor_filter_destroy(XorFilter filter) {
+    LCOMMON_FREE(filter->fingerprints);
+    LCOMMON_FREE(filter);
+}
+
+LCOMMON_BOOL Common_xor_filter_may_contain(const XorFilter filter, const char *s) {
+    uint64_t hash = Common_hash_u64(Common_hash_str(s, 0), filter->seed);
+    uint32_t at[3];
+    xor_filter_slots(filter, hash, at);
+
+    return xor_filter_fingerprint(hash)
+        == (filter->fingerprints[at[0]] ^ filter->fingerprints[at[1]] ^ filter->fingerprints[at[2]]);
+}
+
+size_t Common_xor_filter_size(const XorFilter filter) {
+    return (size_t) filter->block_len * 3;
+}
+
+// ordered maps (B+-trees)
+
+#define BTREE_MAX_KEYS 32
+#define BTREE_MIN_KEYS (BTREE_MAX_KEYS / 2)
+
+// keys are compared through `prefix` first: the integer with its sign bit flipped (so it
+// orders as unsigned), or the first 8 bytes of a string in big endian. Strings are only
+// read when two prefixes are equal and longer than 7 bytes.
+struct btree_key_t {
+    unsigned long long prefix;
+    const char *str;
+};
+
+struct btree_node_t {
+    unsigned len;
+    LCOMMON_BOOL leaf;
+    unsigned long long prefixes[BTREE_MAX_KEYS];
+    const char *strs[BTREE_MAX_KEYS];
+};
+
+struct btree_leaf_t {
+    struct btree_node_t node;
+    void *values[BTREE_MAX_KEYS];
+    struct btree_leaf_t *prev;
+    struct btree_leaf_t *next;
+};
+
+// `children[N]` holds the keys below key N, `children[N + 1]` the ones from key N on.
+struct btree_inner_t {
+    struct btree_node_t node;
+    struct btree_node_t *children[BTREE_MAX_KEYS + 1];
+};
+
+struct btree_t {
+    struct btree_node_t *root;
+    struct btree_leaf_t *first;
+    size_t len;
+    LCOMMON_BOOL string_keys;
+};
+
+#define BTREE_LEAF(node) ((struct btree_leaf_t*) (node))
+#define BTREE_INNER(node) ((struct btree_inner_t*) (node))
+
+static inline struct btree_key_t btree_key_int(long long key) {
+    struct btree_key_t k = { (unsigned long long) key ^ (1ULL << 63), NULL };
+    return k;
+}
+
+static inline struct btree_key_t btree_key_str(const char *key) {
+    struct btree_key_t k = { 0, key };
+
+    for (size_t i = 0; i < 8 && key[i] != '\0'; ++i) {
+        k.prefix |= (unsigned long long) (unsigned char) key[i] << (56 - 8 * i);
+    }
+
+    return k;
+}
+
+static inline int btree_compare(const struct btree_key_t *key, const struct btree_node_t *node, unsigned i) {
+    if (key->prefix != node->prefixes[i]) {
+        return key->prefix < node->prefixes[i] ? -1 : 1;
+    }
+
+    // equal prefixes whose last byte is 0 are both strings shorter than 8 bytes (or integers).
+    if (key->str == NULL || (key->prefix & 0xff) == 0) {
+        return 0;
+    }
+
+    return strcmp(key->str + 8, node->strs[i] + 8);
+}
+
+// first key of the node which is >= `key`.
+static unsigned btree_lower_bound(const struct btree_node_t *node, const struct btree_key_t *key) {
+    unsigned low = 0;
+    unsigned high = node->len;
+
+    while (low < high) {
+        unsigned mid = (low + high) / 2;
+        if (btree_compare(key, node, mid) > 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+// first key of the node which is > `key`, i.e. the child of an inner node to descend into.
+static unsigned btree_upper_bound(const struct btree_node_t *node, const struct btree_key_t *key) {
+    unsigned low = 0;
+    unsigned high = node->len;
+
+    while (low < high) {
+        unsigned mid = (low + high) / 2;
+        if (btree_compare(key, node, mid) >= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static struct btree_leaf_t *btree_leaf_new(void) {
+    struct btree_leaf_t *leaf = Common_smalloc(sizeof(struct btree_leaf_t));
+    leaf->node.len = 0;
+    leaf->node.leaf = LCOMMON_TRUE;
+    leaf->prev = NULL;
+    leaf->next = NULL;
+
+    return leaf;
+}
+
+static struct btree_inner_t *btree_inner_new(void) {
+    struct btree_inner_t *inner = Common_smalloc(sizeof(struct btree_inner_t));
+    inner->node.len = 0;
+    inner->node.leaf = LCOMMON_FALSE;
+
+    return inner;
+}
+
+static BTree btree_new(LCOMMON_BOOL string_keys) {
+    BTree tree = Common_smalloc(sizeof(struct btree_t));
+    tree->first = btree_leaf_new();
+    tree->root = &tree->first->node;
+    tree->len = 0;
+    tree->string_keys = string_keys;
+
+    return tree;
+}
+
+BTree Common_btree_init_int(void) {
+    return btree_new(LCOMMON_FALSE);
+}
+
+BTree Common_btree_init_str(void) {
+    return btree_new(LCOMMON_TRUE);
+}
+
+static void btree_node_free(struct btree_node_t *node, LCOMMON_BOOL values) {
+    if (node->leaf) {
+        if (values) {
+            for (unsigned i = 0; i < node->len; ++i) {
+                LCOMMON_FREE(BTREE_LEAF(node)->values[i]);
+            }
+        }
+    } else {
+        for (unsigned i = 0; i <= node->len; ++i) {
+            btree_node_free(BTREE_INNER(node)->children[i], values);
+        }
+    }
+
+    LCOMMON_FREE(node);
+}
+
+void Common_btree_destroy(BTree tree) {
+    btree_node_free(tree->root, LCOMMON_FALSE);
+    LCOMMON_FREE(tree);
+}
+
+void Common_btree_free(BTree tree) {
+    btree_node_free(tree->root, LCOMMON_TRUE);
+    LCOMMON_FREE(tree);
+}
+
+size_t Common_btree_len(const BTree tree) {
+    return tree->len;
+}
+
+static inline void btree_set_key(struct btree_node_t *node, unsigned i, const struct btree_key_t *key) {
+    node->prefixes[i] = key->prefix;
+    node->strs[i] = key->str;
+}
+
+static inline struct btree_key_t btree_get_key(const struct btree_node_t *node, unsigned i) {
+    struct btree_key_t key = { node->prefixes[i], node->strs[i] };
+    return key;
+}
+
+// moves `n` keys of `from` starting at `from_at` to `to` at `to_at` (ranges may overlap).
+static inline void btree_move_keys(struct btree_node_t *to, unsigned to_at, const struct btree_node_t *from, unsigned from_at, unsigned n) {
+    memmove(&to->prefixes[to_at], &from->prefixes[from_at], sizeof(unsigned long long) * n);
+    memmove(&to->strs[to_at], &from->strs[from_at], sizeof(const char*) * n);
+}
+
+// result of inserting into a subtree which had to split: `right` must be linked in the
+// parent right after the subtree, separated by `key`.
+struct btree_split_t {
+    struct btree_node_t *right;
+    struct btree_key_t key;
+};
+
+static LCOMMON_BOOL btree_leaf_insert(
+    BTree tree,
+    struct btree_leaf_t *leaf,
+    const struct btree_key_t *key,
+    void *value,
+    Optional *replaced,
+    struct btree_split_t *split
+) {
+    struct btree_node_t *node = &leaf->node;
+    unsigned at = btree_lower_bound(node, key);
+
+    if (at < node->len && btree_compare(key, node, at) == 0) {
+        // the new key string replaces the old one too, the caller may free either.
+        *replaced = Common_optional_with(leaf->values[at]);
+        leaf->values[at] = value;
+        node->strs[at] = key->str;
+        return LCOMMON_FALSE;
+    }
+
+    if (node->len == BTREE_MAX_KEYS) {
+        // the upper half moves to a new leaf, then the key goes into whichever half it belongs.
+        struct btree_leaf_t *right = btree_leaf_new();
+        unsigned half = BTREE_MAX_KEYS / 2;
+
+        btree_move_keys(&right->node, 0, node, half, BTREE_MAX_KEYS - half);
+        memcpy(right->values, &leaf->values[half], sizeof(void*) * (BTREE_MAX_KEYS - half));
+        right->node.len = BTREE_MAX_KEYS - half;
+        node->len = half;
+
+        right->next = leaf->next;
+        right->prev = leaf;
+        if (leaf->next != NULL) {
+            leaf->next->prev = right;
+        }
+        leaf->next = right;
+
+        split->right = &right->node;
+        btree_leaf_insert(tree, at > half ? right : leaf, key, value, replaced, split);
+        split->key = btree_get_key(&right->node, 0);
+
+        return LCOMMON_TRUE;
+    }
+
+    btree_move_keys(node, at + 1, node, at, node->len - at);
+    memmove(&leaf->values[at + 1], &leaf->values[at], sizeof(void*) * (node->len - at));
+    btree_set_key(node, at, key);
+    leaf->values[at] = value;
+    node->len++;
+    tree->len++;
+
+    return LCOMMON_FALSE;
+}
+
+// inserts `key` and `child` at `at` in a non full inner node.
+static void btree_inner_insert_at(struct btree_inner_t *inner, unsigned at, const struct btree_key_t *key, struct btree_node_t *child) {
+    struct btree_node_t *node = &inner->node;
+
+    btree_move_keys(node, at + 1, node, at, node->len - at);
+    memmove(&inner->children[at + 2], &inner->children[at + 1], sizeof(struct btree_node_t*) * (node->len - at));
+    btree_set_key(node, at, key);
+    inner->children[at + 1] = child;
+    node->len++;
+}
+
+static LCOMMON_BOOL btree_node_insert(
+    BTree tree,
+    struct btree_node_t *node,
+    const struct btree_key_t *key,
+    void *value,
+    Optional *replaced,
+    struct btree_split_t *split
+) {
+    if (node->leaf) {
+        return btree_leaf_insert(tree, BTREE_LEAF(node), key, value, replaced, split);
+    }
+
+    struct btree_inner_t *inner = BTREE_INNER(node);
+    unsigned at = btree_upper_bound(node, key);
+    struct btree_split_t child_split;
+
+    if (!btree_node_insert(tree, inner->children[at], key, value, replaced, &child_split)) {
+        // a replaced key may also be the separator in front of its subtree.
+        if (at > 0 && btree_compare(key, node, at - 1) == 0) {
+            node->strs[at - 1] = key->str;
+        }
+
+        return LCOMMON_FALSE;
+    }
+
+    if (node->len < BTREE_MAX_KEYS) {
+        btree_inner_insert_at(inner, at, &child_split.key, child_split.right);
+        return LCOMMON_FALSE;
+    }
+
+    // the middle key moves up, the keys after it (and their children) go to a new node.
+    struct btree_inner_t *right = btree_inner_new();
+    unsigned half = BTREE_MAX_KEYS / 2;
+
+    split->key = btree_get_key(node, half);
+    btree_move_keys(&right->node, 0, node, half + 1, BTREE_MAX_KEYS - half - 1);
+    memcpy(right->children, &inner->children[half + 1], sizeof(struct btree_node_t*) * (BTREE_MAX_KEYS - half));
+    right->node.len = BTREE_MAX_KEYS - half - 1;
+    node->len = half;
+
+    if (at <= half) {
+        btree_inner_insert_at(inner, at, &child_split.key, child_split.right);
+    } else {
+        btree_inner_insert_at(right, at - half - 1, &child_split.key, child_split.right);
+    }
+
+    split->right = &right->node;
+
+    return LCOMMON_TRUE;
+}
+
+static Optional btree_insert(BTree tree, const struct btree_key_t *key, void *value) {
+    Optional replaced = Common_optional_none();
+    struct btree_split_t split;
+
+    if (btree_node_insert(tree, tree->root, key, value, &replaced, &split)) {
+        struct btree_inner_t *root = btree_inner_new();
+        root->children[0] = tree->root;
+        root->children[1] = split.right;
+        btree_set_key(&root->node, 0, &split.key);
+        root->node.len = 1;
+        tree->root = &root->node;
+    }
+
+    return replaced;
+}
+
+Optional Common_btree_insert_int(BTree tree, long long key, void *value) {
+    LCOMMON_ASSERT(!tree->string_keys, "tree should have integer keys");
+
+    struct btree_key_t k = btree_key_int(key);
+    return btree_insert(tree, &k, value);
+}
+
+Optional Common_btree_insert_str(BTree tree, const char *key, void *value) {
+    LCOMMON_ASSERT(tree->string_keys, "tree should have string keys");
+
+    struct btree_key_t k = btree_key_str(key);
+    return btree_insert(tree, &k, value);
+}
+
+// leaf where `key` is or would be.
+static struct btree_leaf_t *btree_find_leaf(const BTree tree, const struct btree_key_t *key) {
+    struct btree_node_t *node = tree->root;
+
+    while (!node->leaf) {
+        node = BTREE_INNER(node)->children[btree_upper_bound(node, key)];
+    }
+
+    return BTREE_LEAF(node);
+}
+
+static Optional btree_get(const BTree tree, const struct btree_key_t *key) {
+    struct btree_leaf_t *leaf = btree_find_leaf(tree, key);
+    unsigned at = btree_lower_bound(&leaf->node, key);
+
+    if (at < leaf->node.len && btree_compare(key, &leaf->node, at) == 0) {
+        return Common_optional_with(leaf->values[at]);
+    }
+
+    return Common_optional_none();
+}
+
+Optional Common_btree_get_int(const BTree tree, long long key) {
+    LCOMMON_ASSERT(!tree->string_keys, "tree should have integer keys");
+
+    struct btree_key_t k = btree_key_int(key);
+    return btree_get(tree, &k);
+}
+
+Optional Common_btree_get_str(const BTree tree, const char *key) {
+    LCOMMON_ASSERT(tree->string_keys, "tree should have string keys");
+
+    struct btree_key_t k = btree_key_str(key);
+    return btree_get(tree, &k);
+}
+
+// removes key `at` and the child after it from an inner node.
+static void btree_inner_remove_at(struct btree_inner_t *inner, unsigned at) {
+    struct btree_node_t *node = &inner->node;
+
+    btree_move_keys(node, at, node, at + 1, node->len - at - 1);
+    memmove(&inner->children[at + 1], &inner->children[at + 2], sizeof(struct btree_node_t*) * (node->len - at - 1));
+    node->len--;
+}
+
+// merges `children[at + 1]` into `children[at]`, both together fit in one node.
+static void btree_merge(struct btree_inner_t *parent, unsigned at) {
+    struct btree_node_t *left = parent->children[at];
+    struct btree_node_t *right = parent->children[at + 1];
+
+    if (left->leaf) {
+        struct btree_leaf_t *l = BTREE_LEAF(left);
+        struct btree_leaf_t *r = BTREE_LEAF(right);
+
+        btree_move_keys(left, left->len, right, 0, right->len);
+        memcpy(&l->values[left->len], r->values, sizeof(void*) * right->len);
+        left->len += right->len;
+
+        l->next = r->next;
+        if (r->next != NULL) {
+            r->next->prev = l;
+        }
+    } else {
+        struct btree_key_t separator = btree_get_key(&parent->node, at);
+
+        btree_set_key(left, left->len, &separator);
+        btree_move_keys(left, left->len + 1, right, 0, right->len);
+        memcpy(&BTREE_INNER(left)->children[left->len + 1], BTREE_INNER(right)->children, sizeof(struct btree_node_t*) * (right->len + 1));
+        left->len += right->len + 1;
+    }
+
+    LCOMMON_FREE(right);
+    btree_inner_remove_at(parent, at);
+}
+
+// fixes `children[at]` after it went below the minimum, by borrowing an entry from a
+// sibling which can spare one or merging with a sibling otherwise.
+static void btree_rebalance(struct btree_inner_t *parent, unsigned at) {
+    struct btree_node_t *child = parent->children[at];
+    struct btree_node_t *left = at > 0 ? parent->children[at - 1] : NULL;
+    struct btree_node_t *right = at < parent->node.len ? parent->children[at + 1] : NULL;
+
+    if (left != NULL && left->len > BTREE_MIN_KEYS) {
+        btree_move_keys(child, 1, child, 0, child->len);
+
+        if (child->leaf) {
+            memmove(&BTREE_LEAF(child)->values[1], BTREE_LEAF(child)->values, sizeof(void*) * child->len);
+            btree_move_keys(child, 0, left, left->len - 1, 1);
+            BTREE_LEAF(child)->values[0] = BTREE_LEAF(left)->values[left->len - 1];
+            btree_move_keys(&parent->node, at - 1, child, 0, 1);
+        } else {
+            struct btree_inner_t *c = BTREE_INNER(child);
+            memmove(&c->children[1], c->children, sizeof(struct btree_node_t*) * (child->len + 1));
+            btree_move_keys(child, 0, &parent->node, at - 1, 1);
+            c->children[0] = BTREE_INNER(left)->children[left->len];
+            btree_move_keys(&parent->node, at - 1, left, left->len - 1, 1);
+        }
+
+        child->len++;
+        left->len--;
+    } else if (right != NULL && right->len > BTREE_MIN_KEYS) {
+        if (child->leaf) {
+            btree_move_keys(child, child->len, right, 0, 1);
+            BTREE_LEAF(child)->values[child->len] = BTREE_LEAF(right)->values[0];
+            memmove(BTREE_LEAF(right)->values, &BTREE_LEAF(right)->values[1], sizeof(void*) * (right->len - 1));
+            btree_move_keys(right, 0, right, 1, right->len - 1);
+            btree_move_keys(&parent->node, at, right, 0, 1);
+        } else {
+            struct btree_inner_t *r = BTREE_INNER(right);
+            btree_move_keys(child, child->len, &parent->node, at, 1);
+            BTREE_INNER(child)->children[child->len + 1] = r->children[0];
+            btree_move_keys(&parent->node, at, right, 0, 1);
+            btree_move_keys(right, 0, right, 1, right->len - 1);
+            memmove(r->children, &r->children[1], sizeof(struct btree_node_t*) * right->len);
+        }
+
+        child->len++;
+        right->len--;
+    } else {
+        btree_merge(parent, left != NULL ? at - 1 : at);
+    }
+}
+
+// smallest key of a subtree, which can't be empty.
+static struct btree_key_t btree_first_key(const struct btree_node_t *node) {
+    while (!node->leaf) {
+        node = BTREE_INNER(node)->children[0];
+    }
+
+    return btree_get_key(node, 0);
+}
+
+static LCOMMON_BOOL btree_node_remove(struct btree_node_t *node, const struct btree_key_t *key, void **value) {
+    if (node->leaf) {
+        unsigned at = btree_lower_bound(node, key);
+        if (at == node->len || btree_compare(key, node, at) != 0) {
+            return LCOMMON_FALSE;
+        }
+
+        struct btree_leaf_t *leaf = BTREE_LEAF(node);
+        *value = leaf->values[at];
+
+        btree_move_keys(node, at, node, at + 1, node->len - at - 1);
+        memmove(&leaf->values[at], &leaf->values[at + 1], sizeof(void*) * (node->len - at - 1));
+        node->len--;
+
+        return LCOMMON_TRUE;
+    }
+
+    struct btree_inner_t *inner = BTREE_INNER(node);
+    unsigned at = btree_upper_bound(node, key);
+
+    if (!btree_node_remove(inner->children[at], key, value)) {
+        return LCOMMON_FALSE;
+    }
+
+    // a separator is the smallest key of the subtree on its right, if that was the removed
+    // key it has to go before rebalancing can move it around: string keys aren't copied
+    // so it may be freed as soon as the removal returns.
+    if (at > 0 && btree_compare(key, node, at - 1) == 0) {
+        struct btree_key_t first = btree_first_key(inner->children[at]);
+        btree_set_key(node, at - 1, &first);
+    }
+
+    if (inner->children[at]->len < BTREE_MIN_KEYS) {
+        btree_rebalance(inner, at);
+    }
+
+    return LCOMMON_TRUE;
+}
+
+static Optional btree_remove(BTree tree, const struct btree_key_t *key) {
+    void *value;
+
+    if (!btree_node_remove(tree->root, key, &value)) {
+        return Common_optional_none();
+    }
+
+    tree->len--;
+
+    // a root left with a single child is replaced by it, that's how the tree gets shorter.
+    if (!tree->root->leaf && tree->root->len == 0) {
+        struct btree_node_t *root = tree->root;
+        tree->root = BTREE_INNER(root)->children[0];
+        LCOMMON_FREE(root);
+    }
+
+    return Common_optional_with(value);
+}
+
+Optional Common_btree_remove_int(BTree tree, long long key) {
+    LCOMMON_ASSERT(!tree->string_keys, "tree should have integer keys");
+
+    struct btree_key_t k = btree_key_int(key);
+    return btree_remove(tree, &k);
+}
+
+Optional Common_btree_remove_str(BTree tree, const char *key) {
+    LCOMMON_ASSERT(tree->string_keys, "tree should have string keys");
+
+    struct btree_key_t k = btree_key_str(key);
+    return btree_remove(tree, &k);
+}
+
+// builds the levels above `nodes` (whose smallest keys are `keys`) until a single root is
+// left, every node gets the same amount of children give or take one.
+static struct btree_node_t *btree_build_levels(struct btree_node_t **nodes, struct btree_key_t *keys, size_t len) {
+    while (len > 1) {
+        size_t parents = (len + BTREE_MAX_KEYS) / (BTREE_MAX_KEYS + 1);
+        size_t at = 0;
+
+        for (size_t p = 0; p < parents; ++p) {
+            size_t children = len * (p + 1) / parents - len * p / parents;
+            struct btree_inner_t *inner = btree_inner_new();
+
+            for (size_t c = 0; c < children; ++c) {
+                inner->children[c] = nodes[at + c];
+                if (c > 0) {
+                    btree_set_key(&inner->node, (unsigned) c - 1, &keys[at + c]);
+                }
+            }
+
+            inner->node.len = (unsigned) children - 1;
+            nodes[p] = &inner->node;
+            keys[p] = keys[at];
+            at += children;
+        }
+
+        len = parents;
+    }
+
+    return nodes[0];
+}
+
+static BTree btree_from_sorted(const struct btree_key_t *sorted, void **values, size_t len, LCOMMON_BOOL string_keys) {
+    BTree tree = btree_new(string_keys);
+    if (len == 0) {
+        return tree;
+    }
+
+    LCOMMON_FREE(tree->first);
+
+    size_t leaves = (len + BTREE_MAX_KEYS - 1) / BTREE_MAX_KEYS;
+    struct btree_node_t **nodes = Common_smalloc(sizeof(struct btree_node_t*) * leaves);
+    struct btree_key_t *keys = Common_smalloc(sizeof(struct btree_key_t) * leaves);
+    struct btree_leaf_t *prev = NULL;
+    size_t at = 0;
+
+    for (size_t l = 0; l < leaves; ++l) {
+        size_t n = len * (l + 1) / leaves - len * l / leaves;
+        struct btree_leaf_t *leaf = btree_leaf_new();
+
+        for (size_t i = 0; i < n; ++i) {
+            btree_set_key(&leaf->node, (unsigned) i, &sorted[at + i]);
+            leaf->values[i] = values[at + i];
+        }
+
+        leaf->node.len = (unsigned) n;
+        leaf->prev = prev;
+        if (prev != NULL) {
+            prev->next = leaf;
+        } else {
+            tree->first = leaf;
+        }
+
+        nodes[l] = &leaf->node;
+        keys[l] = sorted[at];
+        prev = leaf;
+        at += n;
+    }
+
+    tree->root = btree_build_levels(nodes, keys, leaves);
+    tree->len = len;
+
+    LCOMMON_FREE(nodes);
+    LCOMMON_FREE(keys);
+
+    return tree;
+}
+
+BTree Common_btree_from_sorted_int(const long long *keys, const DynamicArray values) {
+    struct btree_key_t *sorted = Common_smalloc(sizeof(struct btree_key_t) * (values->len > 0 ? values->len : 1));
+
+    for (size_t i = 0; i < values->len; ++i) {
+        LCOMMON_ASSERT(i == 0 || keys[i - 1] < keys[i], "keys should be sorted and distinct");
+        sorted[i] = btree_key_int(keys[i]);
+    }
+
+    BTree tree = btree_from_sorted(sorted, values->elements, values->len, LCOMMON_FALSE);
+    LCOMMON_FREE(sorted);
+
+    return tree;
+}
+
+BTree Common_btree_from_sorted_str(const DynamicArray keys, const DynamicArray values) {
+    LCOMMON_ASSERT(values == NULL || values->len == keys->len, "every key needs a value");
+
+    struct btree_key_t *sorted = Common_smalloc(sizeof(struct btree_key_t) * (keys->len > 0 ? keys->len : 1));
+
+    for (size_t i = 0; i < keys->len; ++i) {
+        LCOMMON_ASSERT(i == 0 || strcmp(keys->elements[i - 1], keys->elements[i]) < 0, "keys should be sorted and distinct");
+        sorted[i] = btree_key_str(keys->elements[i]);
+    }
+
+    BTree tree = btree_from_sorted(sorted, (values != NULL ? values : keys)->elements, keys->len, LCOMMON_TRUE);
+    LCOMMON_FREE(sorted);
+
+    return tree;
+}
+
+BTreeIterator Common_btree_iter(const BTree tree) {
+    BTreeIterator iterator;
+    memset(&iterator, 0, sizeof(iterator));
+
+    iterator.leaf = tree->first;
+    iterator.string_keys = tree->string_keys;
+
+    return iterator;
+}
+
+static BTreeIterator btree_range(const BTree tree, const struct btree_key_t *from, const struct btree_key_t *to) {
+    BTreeIterator iterator = Common_btree_iter(tree);
+
+    if (from != NULL) {
+        struct btree_leaf_t *leaf = btree_find_leaf(tree, from);
+        iterator.leaf = leaf;
+        iterator.index = btree_lower_bound(&leaf->node, from);
+    }
+
+    if (to != NULL) {
+        iterator.bounded = LCOMMON_TRUE;
+        iterator.end_prefix = to->prefix;
+        iterator.end_str = to->str;
+    }
+
+    return iterator;
+}
+
+BTreeIterator Common_btree_range_int(const BTree tree, long long from, long long to) {
+    LCOMMON_ASSERT(!tree->string_keys, "tree should have integer keys");
+
+    struct btree_key_t f = btree_key_int(from);
+    struct btree_key_t t = btree_key_int(to);
+
+    return btree_range(tree, &f, &t);
+}
+
+BTreeIterator Common_btree_range_str(const BTree tree, const char *from, const char *to) {
+    LCOMMON_ASSERT(tree->string_keys, "tree should have string keys");
+
+    struct btree_key_t f = from != NULL ? btree_key_str(from) : btree_key_int(0);
+    struct btree_key_t t = to != NULL ? btree_key_str(to) : btree_key_int(0);
+
+    return btree_range(tree, from != NULL ? &f : NULL, to != NULL ? &t : NULL);
+}
+
+LCOMMON_BOOL Common_btree_next(BTreeIterator *iterator) {
+    struct btree_leaf_t *leaf = iterator->leaf;
+
+    while (leaf != NULL && iterator->index >= leaf->node.len) {
+        leaf = leaf->next;
+        iterator->index = 0;
+    }
+
+    iterator->leaf = leaf;
+    if (leaf == NULL) {
+        return LCOMMON_FALSE;
+    }
+
+    unsigned at = iterator->index;
+
+    if (iterator->bounded) {
+        struct btree_key_t end = { iterator->end_prefix, iterator->end_str };
+        if (btree_compare(&end, &leaf->node, at) <= 0) {
+            iterator->leaf = NULL;
+            return LCOMMON_FALSE;
+        }
+    }
+
+    if (iterator->string_keys) {
+        iterator->key_str = leaf->node.strs[at];
+    } else {
+        iterator->key = (long long) (leaf->node.prefixes[at] ^ (1ULL << 63));
+    }
+
+    iterator->value = leaf->values[at];
+    iterator->index++;
+
+    return LCOMMON_TRUE;
+}
+
+// lock-free queues
+
+#define QUEUE_CACHE_LINE 64
+// attempts before a blocking push or pop goes to sleep, handoffs usually arrive quickly.
+#define QUEUE_SPINS 128
+
+// lets threads sleep until the other side makes progress: a sleeper registers itself,
+// checks the queue once more and then sleeps only if `epoch` didn't move in between.
+struct queue_event_t {
+    uint32_t epoch;
+    uint32_t sleepers;
+} __attribute__((aligned(QUEUE_CACHE_LINE)));
+
+struct queue_slot_t {
+    size_t sequence;
+    void *element;
+} __attribute__((aligned(QUEUE_CACHE_LINE)));
+
+struct mpmc_queue_t {
+    size_t enqueue_at __attribute__((aligned(QUEUE_CACHE_LINE)));
+    size_t dequeue_at __attribute__((aligned(QUEUE_CACHE_LINE)));
+    struct queue_event_t not_empty;
+    struct queue_event_t not_full;
+    size_t mask __attribute__((aligned(QUEUE_CACHE_LINE)));
+    struct queue_slot_t *slots;
+};
+
+// each side keeps a copy of the other side's position and only reloads it when the copy
+// says the queue is full (or empty), so most operations touch no shared line but the slot.
+struct spsc_queue_t {
+    size_t tail __attribute__((aligned(QUEUE_CACHE_LINE)));
+    size_t cached_head;
+    size_t head __attribute__((aligned(QUEUE_CACHE_LINE)));
+    size_t cached_tail;
+    struct queue_event_t not_empty;
+    struct queue_event_t not_full;
+    size_t mask __attribute__((aligned(QUEUE_CACHE_LINE)));
+    void **elements;
+};
+
+static uint32_t queue_event_prepare(struct queue_event_t *event) {
+    __atomic_fetch_add(&event->sleepers, 1, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&event->epoch, __ATOMIC_SEQ_CST);
+}
+
+static void queue_event_cancel(struct queue_event_t *event) {
+    __atomic_fetch_sub(&event->sleepers, 1, __ATOMIC_RELAXED);
+}
+
+static void queue_event_wait(struct queue_event_t *event, uint32_t epoch) {
+#if LCOMMON_HAVE_FUTEX
+    syscall(SYS_futex, &event->epoch, FUTEX_WAIT_PRIVATE, epoch, NULL, NULL, 0);
+#else
+    if (__atomic_load_n(&event->epoch, __ATOMIC_ACQUIRE) == epoch) {
+        sched_yield();
+    }
+#endif
+
+    queue_event_cancel(event);
+}
+
+// called after publishing `n` elements (or freeing `n` slots), the fence orders the
+// publication before reading `sleepers` so a sleeper which missed it is always woken.
+static void queue_event_notify(struct queue_event_t *event, size_t n) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&event->sleepers, __ATOMIC_RELAXED) == 0) {
+        return;
+    }
+
+    __atomic_fetch_add(&event->epoch, 1, __ATOMIC_SEQ_CST);
+
+#if LCOMMON_HAVE_FUTEX
+    syscall(SYS_futex, &event->epoch, FUTEX_WAKE_PRIVATE, n < INT_MAX ? (int) n : INT_MAX, NULL, NULL, 0);
+#else
+    (void) n;
+#endif
+}
+
+static size_t queue_capacity(size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) {
+        cap *= 2;
+    }
+
+    return cap;
+}
+
+static void *queue_aligned_alloc(size_t size) {
+    void *ptr;
+    if (posix_memalign(&ptr, QUEUE_CACHE_LINE, size) != 0) {
+        die("posix_memalign");
+    }
+
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+MpmcQueue Common_mpmc_queue_init(size_t capacity) {
+    MpmcQueue queue = queue_aligned_alloc(sizeof(struct mpmc_queue_t));
+    size_t cap = queue_capacity(capacity);
+
+    queue->mask = cap - 1;
+    queue->slots = queue_aligned_alloc(sizeof(struct queue_slot_t) * cap);
+
+    // a slot is free for the producer at position P when its sequence is P, and holds an
+    // element for the consumer at position P once its sequence is P + 1.
+    for (size_t i = 0; i < cap; ++i) {
+        queue->slots[i].sequence = i;
+    }
+
+    return queue;
+}
+
+void Common_mpmc_queue_destroy(MpmcQueue queue) {
+    LCOMMON_FREE(queue->slots);
+    LCOMMON_FREE(queue);
+}
+
+size_t Common_mpmc_queue_capacity(const MpmcQueue queue) {
+    return queue->mask + 1;
+}
+
+// claims up to `n` consecutive slots whose sequence is their position plus `ready`, for
+// producers (`ready` 0) or consumers (`ready` 1). Returns how many and their first position.
+static size_t mpmc_queue_claim(MpmcQueue queue, size_t *counter, size_t ready, size_t n, size_t *from) {
+    size_t at = __atomic_load_n(counter, __ATOMIC_RELAXED);
+
+    for (;;) {
+        size_t claimed = 0;
+
+        while (claimed < n) {
+            struct queue_slot_t *slot = &queue->slots[(at + claimed) & queue->mask];
+            if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != at + claimed + ready) {
+                break;
+            }
+            claimed++;
+        }
+
+        if (claimed == 0) {
+            // a slot behind the one we read means the queue really is full (or empty),
+            // otherwise another thread moved the counter and we retry from its value.
+            size_t sequence = __atomic_load_n(&queue->slots[at & queue->mask].sequence, __ATOMIC_ACQUIRE);
+            if ((ptrdiff_t) (sequence - (at + ready)) < 0) {
+                return 0;
+            }
+
+            at = __atomic_load_n(counter, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(counter, &at, at + claimed, LCOMMON_TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            *from = at;
+            return claimed;
+        }
+    }
+}
+
+size_t Common_mpmc_queue_push_batch(MpmcQueue queue, void **elements, size_t n) {
+    size_t from;
+    size_t pushed = mpmc_queue_claim(queue, &queue->enqueue_at, 0, n, &from);
+
+    for (size_t i = 0; i < pushed; ++i) {
+        struct queue_slot_t *slot = &queue->slots[(from + i) & queue->mask];
+        slot->element = elements[i];
+        __atomic_store_n(&slot->sequence, from + i + 1, __ATOMIC_RELEASE);
+    }
+
+    if (pushed > 0) {
+        queue_event_notify(&queue->not_empty, pushed);
+    }
+
+    return pushed;
+}
+
+size_t Common_mpmc_queue_pop_batch(MpmcQueue queue, void **out, size_t n) {
+    size_t from;
+    size_t popped = mpmc_queue_claim(queue, &queue->dequeue_at, 1, n, &from);
+
+    for (size_t i = 0; i < popped; ++i) {
+        struct queue_slot_t *slot = &queue->slots[(from + i) & queue->mask];
+        out[i] = slot->element;
+        // the slot is free again for the producer one lap later.
+        __atomic_store_n(&slot->sequence, from + i + queue->mask + 1, __ATOMIC_RELEASE);
+    }
+
+    if (popped > 0) {
+        queue_event_notify(&queue->not_full, popped);
+    }
+
+    return popped;
+}
+
+LCOMMON_BOOL Common_mpmc_queue_push(MpmcQueue queue, void *element) {
+    return Common_mpmc_queue_push_batch(queue, &element, 1) == 1;
+}
+
+Optional Common_mpmc_queue_pop(MpmcQueue queue) {
+    void *element;
+    return Common_mpmc_queue_pop_batch(queue, &element, 1) == 1 ? Common_optional_with(element) : Common_optional_none();
+}
+
+// one non blocking push or pop of `*element`, used by `queue_wait()`.
+typedef LCOMMON_BOOL (*QueueAttempt)(void *queue, void **element);
+
+// retries `attempt` spinning a little first, then sleeping on `event` until the other side
+// notifies it.
+static void queue_wait(struct queue_event_t *event, QueueAttempt attempt, void *queue, void **element) {
+    for (size_t spin = 0; spin < QUEUE_SPINS; ++spin) {
+        if (attempt(queue, element)) {
+            return;
+        }
+    }
+
+    for (;;) {
+        uint32_t epoch = queue_event_prepare(event);
+        if (attempt(queue, element)) {
+            queue_event_cancel(event);
+            return;
+        }
+
+        queue_event_wait(event, epoch);
+    }
+}
+
+static LCOMMON_BOOL mpmc_queue_try_push(void *queue, void **element) {
+    return Common_mpmc_queue_push_batch(queue, element, 1) == 1;
+}
+
+static LCOMMON_BOOL mpmc_queue_try_pop(void *queue, void **element) {
+    return Common_mpmc_queue_pop_batch(queue, element, 1) == 1;
+}
+
+void Common_mpmc_queue_push_wait(MpmcQueue queue, void *element) {
+    queue_wait(&queue->not_full, mpmc_queue_try_push, queue, &element);
+}
+
+void *Common_mpmc_queue_pop_wait(MpmcQueue queue) {
+    void *element;
+    queue_wait(&queue->not_empty, mpmc_queue_try_pop, queue, &element);
+
+    return element;
+}
+
+SpscQueue Common_spsc_queue_init(size_t capacity) {
+    SpscQueue queue = queue_aligned_alloc(sizeof(struct spsc_queue_t));
+    size_t cap = queue_capacity(capacity);
+
+    queue->mask = cap - 1;
+    queue->elements = Common_smalloc(sizeof(void*) * cap);
+
+    return queue;
+}
+
+void Common_spsc_queue_destroy(SpscQueue queue) {
+    LCOMMON_FREE(queue->elements);
+    LCOMMON_FREE(queue);
+}
+
+size_t Common_spsc_queue_capacity(const SpscQueue queue) {
+    return queue->mask + 1;
+}
+
+size_t Common_spsc_queue_push_batch(SpscQueue queue, void **elements, size_t n) {
+    size_t tail = queue->tail;
+    size_t cap = queue->mask + 1;
+
+    if (cap - (tail - queue->cached_head) < n) {
+        queue->cached_head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    }
+
+    size_t free_slots = cap - (tail - queue->cached_head);
+    size_t pushed = n < free_slots ? n : free_slots;
+
+    for (size_t i = 0; i < pushed; ++i) {
+        queue->elements[(tail + i) & queue->mask] = elements[i];
+    }
+
+    if (pushed > 0) {
+        __atomic_store_n(&queue->tail, tail + pushed, __ATOMIC_RELEASE);
+        queue_event_notify(&queue->not_empty, 1);
+    }
+
+    return pushed;
+}
+
+size_t Common_spsc_queue_pop_batch(SpscQueue queue, void **out, size_t n) {
+    size_t head = queue->head;
+
+    if (queue->cached_tail - head < n) {
+        queue->cached_tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    }
+
+    size_t available = queue->cached_tail - head;
+    size_t popped = n < available ? n : available;
+
+    for (size_t i = 0; i < popped; ++i) {
+        out[i] = queue->elements[(head + i) & queue->mask];
+    }
+
+    if (popped > 0) {
+        __atomic_store_n(&queue->head, head + popped, __ATOMIC_RELEASE);
+        queue_event_notify(&queue->not_full, 1);
+    }
+
+    return popped;
+}
+
+LCOMMON_BOOL Common_spsc_queue_push(SpscQueue queue, void *element) {
+    return Common_spsc_queue_push_batch(queue, &element, 1) == 1;
+}
+
+Optional Common_spsc_queue_pop(SpscQueue queue) {
+    void *element;
+    return Common_spsc_queue_pop_batch(queue, &element, 1) == 1 ? Common_optional_with(element) : Common_optional_none();
+}
+
+static LCOMMON_BOOL spsc_queue_try_push(void *queue, void **element) {
+    return Common_spsc_queue_push_batch(queue, element, 1) == 1;
+}
+
+static LCOMMON_BOOL spsc_queue_try_pop(void *queue, void **element) {
+    return Common_spsc_queue_pop_batch(queue, element, 1) == 1;
+}
+
+void Common_spsc_queue_push_wait(SpscQueue queue, void *element) {
+    queue_wait(&queue->not_full, spsc_queue_try_push, queue, &element);
+}
+
+void *Common_spsc_queue_pop_wait(SpscQueue queue) {
+    void *element;
+    queue_wait(&queue->not_empty, spsc_queue_try_pop, queue, &element);
+
+    return element;
+}
+
+// string pools
+
+// every block owns a fixed range of offsets, so an offset is a block number and a
+// position inside it. Strings too big for a block get a block of their own.
+#define STRPOOL_BLOCK_SHIFT 20
+#define STRPOOL_BLOCK_SIZE ((size_t) 1 << STRPOOL_BLOCK_SHIFT)
+#define STRPOOL_INITIAL_CAP 64
+#define FROZEN_STRPOOL_BUCKET 16
+
+struct strpool_t {
+    char **blocks;
+    size_t blocks_len;
+    size_t blocks_cap;
+    // block being filled (big strings get blocks of their own after it) and its used bytes.
+    size_t current;
+    size_t used;
+    unsigned long long *offsets;
+    size_t len;
+    size_t cap;
+    size_t bytes;
+};
+
+struct frozen_strpool_t {
+    char *data;
+    size_t data_len;
+    size_t *buckets;
+    size_t len;
+};
+
+StrPool Common_strpool_init(void) {
+    StrPool pool = Common_smalloc(sizeof(struct strpool_t));
+
+    pool->blocks = NULL;
+    pool->blocks_len = 0;
+    pool->blocks_cap = 0;
+    pool->current = 0;
+    pool->used = STRPOOL_BLOCK_SIZE;
+    pool->len = 0;
+    pool->cap = STRPOOL_INITIAL_CAP;
+    pool->offsets = Common_smalloc(sizeof(unsigned long long) * pool->cap);
+    pool->bytes = 0;
+
+    return pool;
+}
+
+void Common_strpool_destroy(StrPool pool) {
+    for (size_t i = 0; i < pool->blocks_len; ++i) {
+        LCOMMON_FREE(pool->blocks[i]);
+    }
+
+    LCOMMON_FREE(pool->blocks);
+    LCOMMON_FREE(pool->offsets);
+    LCOMMON_FREE(pool);
+}
+
+static char *strpool_block_new(StrPool pool, size_t size) {
+    if (pool->blocks_len == pool->blocks_cap) {
+        pool->blocks_cap = pool->blocks_cap > 0 ? pool->blocks_cap * 2 : 8;
+        pool->blocks = Common_srealloc(pool->blocks, sizeof(char*) * pool->blocks_cap);
+    }
+
+    char *block = Common_smalloc(size);
+    pool->blocks[pool->blocks_len++] = block;
+    pool->bytes += size;
+
+    return block;
+}
+
+size_t Common_strpool_add_n(StrPool pool, const char *s, size_t len) {
+    char *at;
+    unsigned long long offset;
+
+    if (len + 1 > STRPOOL_BLOCK_SIZE) {
+        at = strpool_block_new(pool, len + 1);
+        offset = (unsigned long long) (pool->blocks_len - 1) << STRPOOL_BLOCK_SHIFT;
+    } else {
+        if (pool->used + len + 1 > STRPOOL_BLOCK_SIZE) {
+            strpool_block_new(pool, STRPOOL_BLOCK_SIZE);
+            pool->current = pool->blocks_len - 1;
+            pool->used = 0;
+        }
+
+        offset = ((unsigned long long) pool->current << STRPOOL_BLOCK_SHIFT) | pool->used;
+        at = pool->blocks[pool->current] + pool->used;
+        pool->used += len + 1;
+    }
+
+    memcpy(at, s, len);
+    at[len] = '\0';
+
+    if (pool->len == pool->cap) {
+        pool->cap *= 2;
+        pool->offsets = Common_srealloc(pool->offsets, sizeof(unsigned long long) * pool->cap);
+    }
+
+    pool->offsets[pool->len] = offset;
+
+    return pool->len++;
+}
+
+size_t Common_strpool_add(StrPool pool, const char *s) {
+    return Common_strpool_add_n(pool, s, strlen(s));
+}
+
+void Common_strpool_add_array(StrPool pool, const DynamicArray strings) {
+    Common_foreach(strings, const char, s, {
+        Common_strpool_add(pool, s);
+    });
+}
+
+size_t Common_strpool_len(const StrPool pool) {
+    return pool->len;
+}
+
+const char *Common_strpool_get(const StrPool pool, size_t index) {
+    LCOMMON_ASSERT(index < pool->len, "index should be inside the pool");
+
+    unsigned long long offset = pool->offsets[index];
+    return pool->blocks[offset >> STRPOOL_BLOCK_SHIFT] + (offset & (STRPOOL_BLOCK_SIZE - 1));
+}
+
+size_t Common_strpool_size(const StrPool pool) {
+    return sizeof(struct strpool_t) + pool->bytes + sizeof(char*) * pool->blocks_cap + sizeof(unsigned long long) * pool->cap;
+}
+
+DynamicArray Common_strpool_to_array(const StrPool pool) {
+    DynamicArray array = Common_dynamic_array_init();
+
+    for (size_t i = 0; i < pool->len; ++i) {
+        Common_dynamic_array_append(array, (void*) Common_strpool_get(pool, i));
+    }
+
+    return array;
+}
+
+static int strpool_compare(const void *a, const void *b) {
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+static size_t strpool_write_varint(char *out, size_t value) {
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        out[n++] = (char) (value | 0x80);
+        value >>= 7;
+    }
+
+    out[n++] = (char) value;
+    return n;
+}
+
+static const char *strpool_read_varint(const char *in, size_t *value) {
+    size_t result = 0;
+    unsigned shift = 0;
+
+    while ((unsigned char) *in & 0x80) {
+        result |= (size_t) ((unsigned char) *in++ & 0x7f) << shift;
+        shift += 7;
+    }
+
+    *value = result | (size_t) (unsigned char) *in++ << shift;
+    return in;
+}
+
+FrozenStrPool Common_strpool_freeze(const StrPool pool) {
+    const char **sorted = Common_smalloc(sizeof(char*) * (pool->len > 0 ? pool->len : 1));
+    for (size_t i = 0; i < pool->len; ++i) {
+        sorted[i] = Common_strpool_get(pool, i);
+    }
+
+    qsort(sorted, pool->len, sizeof(char*), strpool_compare);
+
+    size_t len = 0;
+    for (size_t i = 0; i < pool->len; ++i) {
+        if (len == 0 || strcmp(sorted[len - 1], sorted[i]) != 0) {
+            sorted[len++] = sorted[i];
+        }
+    }
+
+    FrozenStrPool frozen = Common_smalloc(sizeof(struct frozen_strpool_t));
+    frozen->len = len;
+    frozen->buckets = Common_smalloc(sizeof(size_t) * ((len + FROZEN_STRPOOL_BUCKET - 1) / FROZEN_STRPOOL_BUCKET + 1));
+
+    // worst case every entry is stored whole plus two varints.
+    size_t cap = 0;
+    for (size_t i = 0; i < len; ++i) {
+        cap += strlen(sorted[i]) + 1 + 2 * 10;
+    }
+
+    char *data = Common_smalloc(cap > 0 ? cap : 1);
+    size_t at = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        size_t s_len = strlen(sorted[i]);
+
+        if (i % FROZEN_STRPOOL_BUCKET == 0) {
+            frozen->buckets[i / FROZEN_STRPOOL_BUCKET] = at;
+            memcpy(data + at, sorted[i], s_len + 1);
+            at += s_len + 1;
+            continue;
+        }
+
+        size_t shared = 0;
+        while (sorted[i][shared] != '\0' && sorted[i][shared] == sorted[i - 1][shared]) {
+            shared++;
+        }
+
+        at += strpool_write_varint(data + at, shared);
+        at += strpool_write_varint(data + at, s_len - shared);
+        memcpy(data + at, sorted[i] + shared, s_len - shared);
+        at += s_len - shared;
+    }
+
+    frozen->data = Common_srealloc(data, at > 0 ? at : 1);
+    frozen->data_len = at;
+
+    LCOMMON_FREE(sorted);
+
+    return frozen;
+}
+
+void Common_frozen_strpool_destroy(FrozenStrPool frozen) {
+    LCOMMON_FREE(frozen->data);
+    LCOMMON_FREE(frozen->buckets);
+    LCOMMON_FREE(frozen);
+}
+
+size_t Common_frozen_strpool_len(const FrozenStrPool frozen) {
+    return frozen->len;
+}
+
+size_t Common_frozen_strpool_size(const FrozenStrPool frozen) {
+    return sizeof(struct frozen_strpool_t) + frozen->data_len
+        + sizeof(size_t) * ((frozen->len + FROZEN_STRPOOL_BUCKET - 1) / FROZEN_STRPOOL_BUCKET + 1);
+}
+
+// decodes the entry after the bucket's head at `in` on top of the previous string held in
+// `out`, returns where the next entry starts.
+static const char *frozen_strpool_decode(const char *in, StringBuilder out) {
+    size_t shared;
+    size_t suffix;
+
+    in = strpool_read_varint(in, &shared);
+    in = strpool_read_varint(in, &suffix);
+
+    out->len = shared;
+    Common_string_builder_append_n(out, in, suffix);
+
+    return in + suffix;
+}
+
+void Common_frozen_strpool_get(const FrozenStrPool frozen, size_t index, StringBuilder out) {
+    LCOMMON_ASSERT(index < frozen->len, "index should be inside the frozen pool");
+
+    const char *in = frozen->data + frozen->buckets[index / FROZEN_STRPOOL_BUCKET];
+
+    Common_string_builder_clear(out);
+    Common_string_builder_append(out, in);
+    in += out->len + 1;
+
+    for (size_t i = 0; i < index % FROZEN_STRPOOL_BUCKET; ++i) {
+        in = frozen_strpool_decode(in, out);
+    }
+}
+
+Common_optional_of(size_t) Common_frozen_strpool_find(const FrozenStrPool frozen, const char *s) {
+    size_t buckets = (frozen->len + FROZEN_STRPOOL_BUCKET - 1) / FROZEN_STRPOOL_BUCKET;
+    size_t low = 0;
+    size_t high = buckets;
+
+    // last bucket whose head is <= s, the heads are plain strings so no decoding is needed.
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (strcmp(frozen->data + frozen->buckets[mid], s) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low == 0) {
+        return Common_optional_size_t_none();
+    }
+
+    size_t bucket = low - 1;
+    size_t index = bucket * FROZEN_STRPOOL_BUCKET;
+    size_t end = index + FROZEN_STRPOOL_BUCKET < frozen->len ? index + FROZEN_STRPOOL_BUCKET : frozen->len;
+    const char *in = frozen->data + frozen->buckets[bucket];
+
+    // the entries are compared without decoding them: `matched` is how many bytes the
+    // current entry (which is < s) shares with s, an entry sharing fewer bytes with its
+    // previous one is already > s and one sharing more is still < s.
+    size_t matched = 0;
+    while (in[matched] != '\0' && in[matched] == s[matched]) {
+        matched++;
+    }
+
+    if (in[matched] == s[matched]) {
+        return Common_optional_size_t_with(index);
+    }
+
+    in += strlen(in) + 1;
+
+    while (++index < end) {
+        size_t shared;
+        size_t suffix;
+
+        in = strpool_read_varint(in, &shared);
+        in = strpool_read_varint(in, &suffix);
+
+        if (shared < matched) {
+            break;
+        }
+
+        if (shared == matched) {
+            size_t k = 0;
+            while (k < suffix && in[k] == s[matched + k]) {
+                k++;
+            }
+
+            matched += k;
+
+            if (k == suffix && s[matched] == '\0') {
+                return Common_optional_size_t_with(index);
+            }
+
+            if (k < suffix && (unsigned char) in[k] > (unsigned char) s[matched]) {
+                break;
+            }
+        }
+
+        in += suffix;
+    }
+
+    return Common_optional_size_t_none();
+}